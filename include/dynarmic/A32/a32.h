@@ -74,6 +74,15 @@ public:
     std::uint32_t Fpscr() const;
     void SetFpscr(std::uint32_t value);
 
+    /// Number of returns whose target was predicted by the return stack buffer since the last Reset.
+    /// This and the other counters below are only maintained if UserConfig::enable_statistics is set.
+    std::uint64_t GetRSBHitCount() const;
+    /// Number of returns whose target was mispredicted by the return stack buffer since the last Reset.
+    std::uint64_t GetRSBMissCount() const;
+    /// Number of stmxcsr and ldmxcsr instructions executed by emitted code since the last Reset.
+    /// These switch between the host and guest floating-point environments, and are only needed for floating-point code.
+    std::uint64_t GetMXCSRAccessCount() const;
+
     Context SaveContext() const;
     void SaveContext(Context&) const;
     void LoadContext(const Context&);
@@ -11,6 +11,10 @@
 #include <cstdint>
 #include <memory>
 
+namespace Dynarmic {
+class ExclusiveMonitor;
+} // namespace Dynarmic
+
 namespace Dynarmic {
 namespace A32 {
 
@@ -73,13 +77,70 @@ struct UserCallbacks {
 struct UserConfig {
     UserCallbacks* callbacks;
 
+    std::size_t processor_id = 0;
+    /// Tracks exclusive reservations across processors, which may be shared with A64 processors.
+    /// If nullptr, each processor only tracks its own reservation.
+    /// If page_table is also set, exclusive accesses to memory in page_table bypass the monitor:
+    /// a store-exclusive is performed as a host compare-and-swap against the value read when the
+    /// reservation was made. Every processor must then access such memory through the same page_table.
+    ExclusiveMonitor* global_monitor = nullptr;
+
     // Page Table
     // The page table is used for faster memory access. If an entry in the table is nullptr,
-    // the JIT will fallback to calling the MemoryRead*/MemoryWrite* callbacks.
+    // the JIT will fallback to calling the MemoryRead*/MemoryWrite* callbacks. Accesses that
+    // cross a page boundary also use the callbacks.
     static constexpr std::size_t PAGE_BITS = 12;
     static constexpr std::size_t NUM_PAGE_TABLE_ENTRIES = 1 << (32 - PAGE_BITS);
     std::array<std::uint8_t*, NUM_PAGE_TABLE_ENTRIES>* page_table = nullptr;
 
+    // Fastmem
+    // Pointer to the start of a host mapping of the guest's entire 4 GiB address space, followed by
+    // at least one inaccessible page. Guest address vaddr is then accessed directly at
+    // fastmem_pointer + vaddr. Any page that should instead be accessed through the memory callbacks
+    // must be inaccessible in this mapping: the resulting fault is caught and the faulting access is
+    // permanently rewritten to call the relevant MemoryRead*/MemoryWrite* callback.
+    // Takes precedence over page_table. Only supported on Linux, macOS and FreeBSD; elsewhere it is ignored.
+    // If fastmem_pointer is nullptr, fastmem is disabled.
+    void* fastmem_pointer = nullptr;
+
+    /// Number of entries in the return stack buffer, which predicts the targets of returns.
+    /// Valid values are powers of two between 1 and 64 inclusive.
+    std::size_t rsb_size = 8;
+
+    /// When set to true, emitted code maintains the counters returned by Jit::GetRSBHitCount and similar.
+    /// These cost a memory increment each time they are updated, so they are disabled by default and read as zero.
+    bool enable_statistics = false;
+
+    /// When set to true, translation continues across unconditional direct branches (B, BL),
+    /// so that a single compiled block may cover several disjoint ranges of guest code.
+    /// Forward conditional branches become side exits from the middle of the block and
+    /// translation continues along their fall-through path.
+    bool enable_superblocks = false;
+
+    /// Maximum number of guest instructions in a block after which translation no longer
+    /// continues across branches. Only used if enable_superblocks is true.
+    std::size_t superblock_max_instructions = 256;
+
+    /// Size in bytes of the region of the code cache holding the main body of emitted code.
+    /// Routines shared by all blocks (roughly 1 MiB for the A64 frontend) are also placed here.
+    std::size_t code_cache_near_size = 100 * 1024 * 1024;
+
+    /// Size in bytes of the region of the code cache holding rarely executed code. Must be at least 1 MiB.
+    std::size_t code_cache_far_size = 26 * 1024 * 1024;
+
+    /// Size in bytes of the pool of constants referenced by emitted code.
+    std::size_t code_cache_constant_pool_size = 2 * 1024 * 1024;
+
+    /// When set to true, address space for the code cache is reserved up front and memory is only
+    /// committed as it is used. This allows for a large cache without paying for it until it fills.
+    bool code_cache_lazy_commit = false;
+
+    /// Path of a file in which translated blocks are kept between runs, so that code which has been
+    /// seen before does not need to be translated again. Blocks are only reused if the guest code they
+    /// were translated from is unchanged. The file is created if it does not exist.
+    /// If nullptr, translated blocks are not persisted.
+    const char* translation_cache_path = nullptr;
+
     // Coprocessors
     std::array<std::shared_ptr<Coprocessor>, 16> coprocessors;
 };
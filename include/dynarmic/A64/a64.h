@@ -43,6 +43,22 @@ public:
      */
     void InvalidateCacheRange(std::uint64_t start_address, std::size_t length);
 
+    /**
+     * Discards all software TLB entries (See: UserConfig::enable_tlb).
+     * Must be called whenever the result of UserCallbacks::TranslatePage for a page changes, including
+     * when a page for which it returned nullptr gains host memory.
+     * Can be called at any time, including from within a callback.
+     */
+    void InvalidateTLB();
+
+    /**
+     * Waits until the worker thread has finished every queued translation (See: UserConfig::compilation_mode).
+     * The worker calls UserCallbacks::MemoryReadCode, so this must be called before modifying guest code while
+     * Jit::Run is not executing. Does nothing in the synchronous compilation mode.
+     * Cannot be called from a callback.
+     */
+    void WaitForBackgroundTranslation();
+
     /**
      * Reset CPU state to state at startup. Does not clear code cache.
      * Cannot be called from a callback.
@@ -51,7 +67,11 @@ public:
 
     /**
      * Stops execution in Jit::Run.
-     * Can only be called from a callback.
+     * May be called from a callback or from any other thread, e.g. to preempt execution from a timer thread.
+     * Emitted code checks for a halt on every back-edge, every jump to a linked block and every return to
+     * the dispatcher, so Jit::Run returns after at most a few more blocks have executed, however long the
+     * guest loops. A request is only discarded when Jit::Run returns after it, so if Jit::Run is not executing,
+     * or has already passed the point where it discards requests, the next call to Jit::Run returns promptly.
      */
     void HaltExecution();
 
@@ -100,6 +120,21 @@ public:
     /// Modify PSTATE
     void SetPstate(std::uint32_t value);
 
+    /// Number of returns whose target was predicted by the return stack buffer since the last Reset.
+    /// This and the other counters below are only maintained if UserConfig::enable_statistics is set.
+    std::uint64_t GetRSBHitCount() const;
+    /// Number of returns whose target was mispredicted by the return stack buffer since the last Reset.
+    std::uint64_t GetRSBMissCount() const;
+    /// Number of indirect branches and mispredicted returns whose target was found in the fast dispatch table since the last Reset.
+    std::uint64_t GetFastDispatchHitCount() const;
+    /// Number of indirect branches and mispredicted returns that probed the fast dispatch table and fell back to the dispatcher's lookup.
+    std::uint64_t GetFastDispatchMissCount() const;
+    /// Number of stmxcsr and ldmxcsr instructions executed by emitted code since the last Reset.
+    /// These switch between the host and guest floating-point environments, and are only needed for floating-point code.
+    std::uint64_t GetMXCSRAccessCount() const;
+    /// Number of blocks recompiled with full optimisation by tiered compilation since the last Reset.
+    std::uint64_t GetTierUpCount() const;
+
     /// Clears exclusive state for this core.
     void ClearExclusiveState();
 
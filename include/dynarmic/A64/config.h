@@ -11,6 +11,10 @@
 #include <cstdint>
 #include <memory>
 
+namespace Dynarmic {
+class ExclusiveMonitor;
+} // namespace Dynarmic
+
 namespace Dynarmic {
 namespace A64 {
 
@@ -88,6 +92,11 @@ struct UserCallbacks {
     // A conservative implementation that always returns false is safe.
     virtual bool IsReadOnlyMemory(VAddr /* vaddr */) { return false; }
 
+    // Only used if UserConfig::enable_tlb is true. Returns a host pointer to the 4 KiB page at vaddr
+    // (which is page aligned), or nullptr if accesses to that page must go through the MemoryRead*
+    // and MemoryWrite* callbacks. Results, including nullptr, are cached until Jit::InvalidateTLB is called.
+    virtual std::uint8_t* TranslatePage(VAddr /* vaddr */) { return nullptr; }
+
     /// The intrepreter must execute exactly num_instructions starting from PC.
     virtual void InterpreterFallback(VAddr pc, size_t num_instructions) = 0;
 
@@ -106,12 +115,14 @@ struct UserCallbacks {
     virtual std::uint64_t GetCNTPCT() = 0;
 };
 
-class ExclusiveMonitor;
-
 struct UserConfig {
     UserCallbacks* callbacks;
 
     size_t processor_id = 0;
+    /// Tracks exclusive reservations across processors. If page_table is also set, exclusive
+    /// accesses of up to 64 bits to memory in page_table bypass the monitor: a store-exclusive is
+    /// performed as a host compare-and-swap against the value read when the reservation was made.
+    /// Every processor must then access such memory through the same page_table.
     ExclusiveMonitor* global_monitor = nullptr;
 
     /// When set to true, UserCallbacks::DataCacheOperationRaised will be called when any
@@ -147,6 +158,16 @@ struct UserConfig {
     /// Determines the size of page_table. Valid values are between 12 and 64 inclusive.
     /// This is only used if page_table is not nullptr.
     size_t page_table_address_space_bits = 36;
+    /// Number of levels in page_table. Valid values are between 1 and 4 inclusive, and no more than
+    /// page_table_address_space_bits - 12.
+    /// With a single level, page_table is indexed by the page number (vaddr >> 12). With more, the
+    /// page number is split into page_table_levels fields: every level but the first is indexed by
+    /// (page_table_address_space_bits - 12) / page_table_levels bits (rounded down) and the first
+    /// level by the remaining top bits. Entries of every level but the last point to the table of
+    /// the next level; a null entry at any level means the relevant memory callback will be called.
+    /// For example, a 48-bit address space with 3 levels uses tables of 4096 entries each.
+    /// This is only used if page_table is not nullptr.
+    size_t page_table_levels = 1;
     /// Determines what happens if the guest accesses an entry that is off the end of the
     /// page table. If true, Dynarmic will silently mirror page_table's address space. If
     /// false, accessing memory outside of page_table bounds will result in a call to the
@@ -154,6 +175,126 @@ struct UserConfig {
     /// This is only used if page_table is not nullptr.
     bool silently_mirror_page_table = true;
 
+    /// When set to true, memory accesses are translated through a small direct-mapped TLB held in
+    /// the JIT state and probed by emitted code. On a miss, UserCallbacks::TranslatePage is called to
+    /// fill the entry. Pages without host memory are cached too, so their accesses go straight to the
+    /// memory callbacks. This gives inline memory accesses for address spaces too large or sparse for
+    /// page_table. An access crossing a page boundary always uses the memory callbacks.
+    /// This is only used if page_table and fastmem_pointer are nullptr.
+    bool enable_tlb = false;
+
+    /// Pointer to the start of a host mapping of the guest's entire address space (fastmem).
+    /// Guest address vaddr is then accessed directly at fastmem_pointer + vaddr. Any page that should
+    /// instead be accessed through the memory callbacks must be inaccessible in this mapping: the
+    /// resulting fault is caught and the faulting access is permanently rewritten to call the relevant
+    /// memory callback. Exclusive accesses always use the memory callbacks.
+    /// Takes precedence over page_table. Only supported on Linux, macOS and FreeBSD; elsewhere it is ignored.
+    /// If fastmem_pointer is nullptr, fastmem is disabled.
+    void* fastmem_pointer = nullptr;
+    /// Declares how many valid address bits are there in virtual addresses when fastmem is enabled.
+    /// The mapping at fastmem_pointer must cover 2^fastmem_address_space_bits bytes followed by at least
+    /// one inaccessible page. Accesses to addresses outside this range use the memory callbacks.
+    /// Valid values are between 12 and 64 inclusive. This is only used if fastmem_pointer is not nullptr.
+    size_t fastmem_address_space_bits = 36;
+    /// Set to true if the guest never accesses memory at or above 2^fastmem_address_space_bits, for example
+    /// because its own address translation never produces such addresses. The range check made before each
+    /// fastmem access is then omitted, so that each access is a single host instruction. An access outside
+    /// the range is then made at fastmem_pointer + vaddr regardless, and is undefined behaviour.
+    /// This is only used if fastmem_pointer is not nullptr.
+    bool fastmem_omit_range_check = false;
+
+    /// When set to true, host pages backing guest code are write-protected before the code is read for
+    /// compilation. A write to such a page, whether by the guest or the host, invalidates the compiled code
+    /// of every guest page it backs, so self-modifying code does not require calls to InvalidateCacheRange.
+    /// The invalidation is made when execution next returns to the dispatcher, so as with
+    /// InvalidateCacheRange, execution halts if such a write is made during Run. Until then, the block
+    /// making the write and blocks it is linked to may still run the old code.
+    /// Only applies to guest code accessed through fastmem_pointer or page_table; pages that are not writable
+    /// are not protected, and the others are given back their original protection when written to.
+    /// Writes made by the kernel are not detected: host system calls such as read or recv that write into
+    /// a protected page fail with EFAULT. Such data must be read into a host buffer and then copied into
+    /// guest memory, which is detected as any other write.
+    /// The protection of guest memory is cached when it is protected. If guest memory is remapped or its
+    /// protection is changed, ClearCache must be called first.
+    /// Only supported on Linux, macOS and FreeBSD; elsewhere it is ignored.
+    bool protect_code_pages = false;
+
+    /// Number of entries in the return stack buffer, which predicts the targets of returns.
+    /// Valid values are powers of two between 1 and 64 inclusive.
+    size_t rsb_size = 8;
+
+    /// When set to true, emitted code maintains the counters returned by Jit::GetRSBHitCount and similar.
+    /// These cost a memory increment each time they are updated, so they are disabled by default and read as zero.
+    bool enable_statistics = false;
+
+    /// When set to true, indirect branches (BR, BLR and RET return stack buffer misses) look up
+    /// their target in a hash table probed directly by emitted code, only calling into the
+    /// dispatcher on a table miss.
+    /// When set to false, all such branches return to the dispatcher.
+    bool enable_fast_dispatch = true;
+
+    /// When set to true, translation continues across unconditional direct branches (B, BL),
+    /// so that a single compiled block may cover several disjoint ranges of guest code.
+    /// Forward conditional branches become side exits from the middle of the block and
+    /// translation continues along their fall-through path.
+    bool enable_superblocks = false;
+
+    /// Maximum number of guest instructions in a block after which translation no longer
+    /// continues across branches. Only used if enable_superblocks is true.
+    size_t superblock_max_instructions = 256;
+
+    /// When set to true, blocks are first compiled quickly with minimal optimisation and carry
+    /// an execution counter. Once a block has been entered tier_up_threshold times it is
+    /// recompiled with superblocks and additional optimisation passes enabled, and its old
+    /// entrypoint is redirected to the new code.
+    bool enable_tiered_compilation = false;
+
+    /// Number of times a block is entered before it is recompiled.
+    /// Only used if enable_tiered_compilation is true.
+    std::uint32_t tier_up_threshold = 4096;
+
+    /// Number of levels of statically known successors (branch targets and superblock side exits) that
+    /// are translated and emitted as soon as a block is compiled, so that the block's links to them are
+    /// patched before it first runs. Prefetched blocks that are never executed waste translation time
+    /// and code cache space. 0 disables prefetching.
+    /// In the background compilation modes prefetching happens on the worker thread and at least one
+    /// level of successors is always prefetched.
+    size_t prefetch_depth = 0;
+
+    /// Determines where blocks are translated and optimised before being emitted.
+    /// In the background modes UserCallbacks::MemoryReadCode is also called from a worker thread,
+    /// concurrently with the thread calling Jit::Run.
+    enum class CompilationMode {
+        /// Blocks are translated on the thread running the guest when they are first needed.
+        Synchronous,
+        /// Blocks are translated on a worker thread. If the guest needs a block the worker is
+        /// still translating, it waits for that translation to finish.
+        BackgroundWait,
+        /// Blocks are translated on a worker thread. Until the block the guest needs is ready,
+        /// the guest executes one instruction at a time through UserCallbacks::InterpreterFallback.
+        BackgroundInterpret,
+    } compilation_mode = CompilationMode::Synchronous;
+
+    /// Size in bytes of the region of the code cache holding the main body of emitted code.
+    /// Routines shared by all blocks (roughly 1 MiB for the A64 frontend) are also placed here.
+    size_t code_cache_near_size = 100 * 1024 * 1024;
+
+    /// Size in bytes of the region of the code cache holding rarely executed code. Must be at least 1 MiB.
+    size_t code_cache_far_size = 26 * 1024 * 1024;
+
+    /// Size in bytes of the pool of constants referenced by emitted code.
+    size_t code_cache_constant_pool_size = 2 * 1024 * 1024;
+
+    /// When set to true, address space for the code cache is reserved up front and memory is only
+    /// committed as it is used. This allows for a large cache without paying for it until it fills.
+    bool code_cache_lazy_commit = false;
+
+    /// Path of a file in which translated blocks are kept between runs, so that code which has been
+    /// seen before does not need to be translated again. Blocks are only reused if the guest code they
+    /// were translated from is unchanged. The file is created if it does not exist.
+    /// If nullptr, translated blocks are not persisted.
+    const char* translation_cache_path = nullptr;
+
     // The below options relate to accuracy of floating-point emulation.
 
     /// Determines how accurate NaN handling is.
@@ -168,7 +309,9 @@ struct UserConfig {
 
     // Determines whether AddTicks and GetTicksRemaining are called.
     // If false, execution will continue until soon after Jit::HaltExecution is called.
-    // bool enable_ticks = true; // TODO
+    // Emitted code then does not count cycles, and only checks for a halt request on
+    // back-edges and when jumping to a linked block.
+    bool enable_ticks = true;
 };
 
 } // namespace A64
@@ -0,0 +1,80 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Dynarmic {
+
+/**
+ * Tracks the exclusive reservations of several processors.
+ * Shared by the A32 and A64 frontends: A32 addresses are zero-extended to 64 bits.
+ *
+ * Reservations are held in per-processor slots and are marked and cleared without locking.
+ * Exclusive operations made through DoExclusiveOperation are not lock-free: those on the same
+ * reservation granule are serialised by one of a set of locks selected by address. There are
+ * several locks per processor, so that operations on unrelated addresses rarely contend.
+ * Only exclusive accesses that a Jit makes with host atomics on page table memory avoid the locks.
+ */
+class ExclusiveMonitor {
+public:
+    /// @param processor_count Maximum number of processors using this global
+    ///                        exclusive monitor. Each processor must have a
+    ///                        unique id.
+    explicit ExclusiveMonitor(size_t processor_count);
+
+    size_t GetProcessorCount() const;
+
+    /// Marks a region containing [address, address+size) to be exclusive to
+    /// processor processor_id.
+    void Mark(size_t processor_id, std::uint64_t address, size_t size);
+
+    /// Checks to see if processor processor_id has exclusive access to the
+    /// specified region. If it does, executes the operation then clears
+    /// the exclusive state for processors if their exclusive region(s)
+    /// contain [address, address+size).
+    template <typename Function>
+    bool DoExclusiveOperation(size_t processor_id, std::uint64_t address, size_t size, Function op) {
+        if (!CheckAndLock(processor_id, address, size)) {
+            return false;
+        }
+
+        op();
+
+        ClearAndUnlock(address);
+        return true;
+    }
+
+    /// Unmark everything.
+    void Clear();
+
+private:
+    bool CheckAndLock(size_t processor_id, std::uint64_t address, size_t size);
+    void ClearAndUnlock(std::uint64_t address);
+
+    static constexpr std::uint64_t RESERVATION_GRANULE_MASK = 0xFFFF'FFFF'FFFF'FFF0ull;
+    static constexpr std::uint64_t INVALID_EXCLUSIVE_ADDRESS = 0xDEAD'DEAD'DEAD'DEADull;
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+    static constexpr size_t LOCKS_PER_PROCESSOR = 4;
+
+    struct alignas(CACHE_LINE_SIZE) Reservation {
+        std::atomic<std::uint64_t> address{INVALID_EXCLUSIVE_ADDRESS};
+    };
+    struct alignas(CACHE_LINE_SIZE) GranuleLock {
+        std::atomic<bool> is_locked{false};
+    };
+
+    std::atomic<bool>& LockFor(std::uint64_t masked_address);
+
+    std::vector<Reservation> reservations;
+    std::vector<GranuleLock> locks; // Size is a power of 2.
+};
+
+} // namespace Dynarmic
@@ -4,6 +4,7 @@
  * General Public License version 2 or any later version.
  */
 
+#include <initializer_list>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
@@ -11,6 +12,7 @@
 #include <fmt/ostream.h>
 
 #include <dynarmic/A32/coprocessor.h>
+#include <dynarmic/exclusive_monitor.h>
 
 #include "backend/x64/a32_emit_x64.h"
 #include "backend/x64/a32_jitstate.h"
@@ -77,17 +79,35 @@ bool A32EmitContext::FPSCR_DN() const {
 
 A32EmitX64::A32EmitX64(BlockOfCode& code, A32::UserConfig config, A32::Jit* jit_interface)
     : EmitX64(code), config(std::move(config)), jit_interface(jit_interface)
+    , fastmem_enabled(this->config.fastmem_pointer && code.SupportsFastmem())
 {
-    GenMemoryAccessors();
+    GenFastmemFallbacks();
+    GenInlineCacheMissHandler();
     code.PreludeComplete();
+
+    if (fastmem_enabled) {
+        code.SetFastmemCallback([](void* arg, u64 rip) { return static_cast<A32EmitX64*>(arg)->BackpatchFastmem(rip); }, this);
+    }
 }
 
-A32EmitX64::~A32EmitX64() = default;
+A32EmitX64::~A32EmitX64() {
+    if (fastmem_enabled) {
+        code.SetFastmemCallback(nullptr, nullptr);
+    }
+}
 
 A32EmitX64::BlockDescriptor A32EmitX64::Emit(IR::Block& block) {
     code.align();
     const u8* const entrypoint = code.getCurr();
 
+    EmitMxcsrPrelude(block);
+
+    Xbyak::Label loop_head_label;
+    if (IsSelfLoop(block)) {
+        code.L(loop_head_label);
+        loop_head = &loop_head_label;
+    }
+
     // Start emitting.
     EmitCondPrelude(block);
 
@@ -128,15 +148,20 @@ A32EmitX64::BlockDescriptor A32EmitX64::Emit(IR::Block& block) {
     EmitX64::EmitTerminal(block.GetTerminal(), block.Location());
     code.int3();
 
+    loop_head = nullptr;
+
     const A32::LocationDescriptor descriptor{block.Location()};
     Patch(descriptor, entrypoint);
 
     const size_t size = static_cast<size_t>(code.getCurr() - entrypoint);
-    const A32::LocationDescriptor end_location{block.EndLocation()};
-    const auto range = boost::icl::discrete_interval<u32>::closed(descriptor.PC(), end_location.PC() - 1);
     A32EmitX64::BlockDescriptor block_desc{entrypoint, size};
     block_descriptors.emplace(descriptor.UniqueHash(), block_desc);
-    block_ranges.AddRange(range, descriptor);
+    for (const auto& [begin, end] : block.TranslatedRanges()) {
+        const A32::LocationDescriptor begin_location{begin};
+        const A32::LocationDescriptor end_location{end};
+        const auto range = boost::icl::discrete_interval<u32>::closed(begin_location.PC(), end_location.PC() - 1);
+        block_ranges.AddRange(range, descriptor);
+    }
 
     return block_desc;
 }
@@ -146,66 +171,83 @@ void A32EmitX64::ClearCache() {
     block_ranges.ClearCache();
 }
 
+std::vector<IR::LocationDescriptor> A32EmitX64::AdvanceCodeSegment() {
+    const auto locations = EmitX64::AdvanceCodeSegment();
+    for (const auto& location : locations) {
+        block_ranges.RemoveLocation(location);
+    }
+    return locations;
+}
+
 void A32EmitX64::InvalidateCacheRanges(const boost::icl::interval_set<u32>& ranges) {
     InvalidateBasicBlocks(block_ranges.InvalidateRanges(ranges));
 }
 
-void A32EmitX64::GenMemoryAccessors() {
-    code.align();
-    read_memory_8 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryRead8>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
-
-    code.align();
-    read_memory_16 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryRead16>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
-
-    code.align();
-    read_memory_32 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryRead32>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
-
-    code.align();
-    read_memory_64 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryRead64>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
-
-    code.align();
-    write_memory_8 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryWrite8>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
-
-    code.align();
-    write_memory_16 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryWrite16>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
-
-    code.align();
-    write_memory_32 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryWrite32>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
+void A32EmitX64::GenFastmemFallbacks() {
+    const std::initializer_list<int> idxes{0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+    const std::vector<std::tuple<size_t, ArgCallback>> read_callbacks {
+        {8, Devirtualize<&A32::UserCallbacks::MemoryRead8>(config.callbacks)},
+        {16, Devirtualize<&A32::UserCallbacks::MemoryRead16>(config.callbacks)},
+        {32, Devirtualize<&A32::UserCallbacks::MemoryRead32>(config.callbacks)},
+        {64, Devirtualize<&A32::UserCallbacks::MemoryRead64>(config.callbacks)},
+    };
+    const std::vector<std::tuple<size_t, ArgCallback>> write_callbacks {
+        {8, Devirtualize<&A32::UserCallbacks::MemoryWrite8>(config.callbacks)},
+        {16, Devirtualize<&A32::UserCallbacks::MemoryWrite16>(config.callbacks)},
+        {32, Devirtualize<&A32::UserCallbacks::MemoryWrite32>(config.callbacks)},
+        {64, Devirtualize<&A32::UserCallbacks::MemoryWrite64>(config.callbacks)},
+    };
+
+    for (int vaddr_idx : idxes) {
+        if (vaddr_idx == 4 || vaddr_idx == 15) {
+            continue;
+        }
 
-    code.align();
-    write_memory_64 = code.getCurr<const void*>();
-    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    Devirtualize<&A32::UserCallbacks::MemoryWrite64>(config.callbacks).EmitCall(code);
-    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, ABI_RETURN);
-    code.ret();
+        for (int value_idx : idxes) {
+            if (value_idx == 4 || value_idx == 15) {
+                continue;
+            }
+
+            for (auto& [bitsize, callback] : read_callbacks) {
+                code.align();
+                read_fallbacks[std::make_tuple(bitsize, vaddr_idx, value_idx)] = code.getCurr<void(*)()>();
+                ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, HostLocRegIdx(value_idx));
+                if (vaddr_idx != code.ABI_PARAM2.getIdx()) {
+                    code.mov(code.ABI_PARAM2, Xbyak::Reg64{vaddr_idx});
+                }
+                callback.EmitCall(code);
+                if (value_idx != code.ABI_RETURN.getIdx()) {
+                    code.mov(Xbyak::Reg64{value_idx}, code.ABI_RETURN);
+                }
+                ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, HostLocRegIdx(value_idx));
+                code.ret();
+            }
+
+            for (auto& [bitsize, callback] : write_callbacks) {
+                code.align();
+                write_fallbacks[std::make_tuple(bitsize, vaddr_idx, value_idx)] = code.getCurr<void(*)()>();
+                ABI_PushCallerSaveRegistersAndAdjustStack(code);
+                if (vaddr_idx == code.ABI_PARAM3.getIdx() && value_idx == code.ABI_PARAM2.getIdx()) {
+                    code.xchg(code.ABI_PARAM2, code.ABI_PARAM3);
+                } else if (vaddr_idx == code.ABI_PARAM3.getIdx()) {
+                    code.mov(code.ABI_PARAM2, Xbyak::Reg64{vaddr_idx});
+                    if (value_idx != code.ABI_PARAM3.getIdx()) {
+                        code.mov(code.ABI_PARAM3, Xbyak::Reg64{value_idx});
+                    }
+                } else {
+                    if (value_idx != code.ABI_PARAM3.getIdx()) {
+                        code.mov(code.ABI_PARAM3, Xbyak::Reg64{value_idx});
+                    }
+                    if (vaddr_idx != code.ABI_PARAM2.getIdx()) {
+                        code.mov(code.ABI_PARAM2, Xbyak::Reg64{vaddr_idx});
+                    }
+                }
+                callback.EmitCall(code);
+                ABI_PopCallerSaveRegistersAndAdjustStack(code);
+                code.ret();
+            }
+        }
+    }
 }
 
 void A32EmitX64::EmitA32GetRegister(A32EmitContext& ctx, IR::Inst* inst) {
@@ -636,7 +678,7 @@ void A32EmitX64::EmitA32GetFpscr(A32EmitContext& ctx, IR::Inst* inst) {
     ctx.reg_alloc.HostCall(inst);
     code.mov(code.ABI_PARAM1, code.r15);
 
-    code.stmxcsr(code.dword[code.r15 + offsetof(A32JitState, guest_MXCSR)]);
+    code.StoreGuestMxcsr();
     code.CallFunction(&GetFpscrImpl);
 }
 
@@ -650,7 +692,7 @@ void A32EmitX64::EmitA32SetFpscr(A32EmitContext& ctx, IR::Inst* inst) {
     code.mov(code.ABI_PARAM2, code.r15);
 
     code.CallFunction(&SetFpscrImpl);
-    code.ldmxcsr(code.dword[code.r15 + offsetof(A32JitState, guest_MXCSR)]);
+    code.LoadGuestMxcsr();
 }
 
 void A32EmitX64::EmitA32GetFpscrNZCV(A32EmitContext& ctx, IR::Inst* inst) {
@@ -675,156 +717,400 @@ void A32EmitX64::EmitA32ClearExclusive(A32EmitContext&, IR::Inst*) {
     code.mov(code.byte[r15 + offsetof(A32JitState, exclusive_state)], u8(0));
 }
 
-void A32EmitX64::EmitA32SetExclusive(A32EmitContext& ctx, IR::Inst* inst) {
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ASSERT(args[1].IsImmediate());
-    Xbyak::Reg32 address = ctx.reg_alloc.UseGpr(args[0]).cvt32();
-
-    code.mov(code.byte[r15 + offsetof(A32JitState, exclusive_state)], u8(1));
-    code.mov(dword[r15 + offsetof(A32JitState, exclusive_address)], address);
-}
-
-template <typename T, T (A32::UserCallbacks::*raw_fn)(A32::VAddr)>
-static void ReadMemory(BlockOfCode& code, RegAlloc& reg_alloc, IR::Inst* inst, const A32::UserConfig& config, const CodePtr wrapped_fn) {
-    constexpr size_t bit_size = Common::BitSize<T>();
-    auto args = reg_alloc.GetArgumentInfo(inst);
-
-    if (!config.page_table) {
-        reg_alloc.HostCall(inst, {}, args[0]);
-        Devirtualize<raw_fn>(config.callbacks).EmitCall(code);
-        return;
+/// Code emitter: Returns the host address of the `bitsize`-bit access at vaddr through the page table.
+/// Jumps to abort if the page is not in the page table or the access crosses into the next page,
+/// whose host memory need not follow the first page's.
+static Xbyak::RegExp EmitVAddrLookup(BlockOfCode& code, A32EmitContext& ctx, const A32::UserConfig& config, Xbyak::Label& abort, Xbyak::Reg64 vaddr, size_t bitsize, boost::optional<Xbyak::Reg64> arg_scratch = {}) {
+    constexpr size_t PAGE_SIZE = 1 << A32::UserConfig::PAGE_BITS;
+    constexpr size_t PAGE_MASK = PAGE_SIZE - 1;
+
+    Xbyak::Reg64 page_table = arg_scratch.value_or_eval([&]{ return ctx.reg_alloc.ScratchGpr(); });
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+    if (bitsize > 8) {
+        code.mov(tmp.cvt32(), vaddr.cvt32());
+        code.and_(tmp.cvt32(), static_cast<u32>(PAGE_MASK));
+        code.cmp(tmp.cvt32(), static_cast<u32>(PAGE_SIZE - bitsize / 8));
+        code.ja(abort, code.T_NEAR);
     }
-
-    reg_alloc.UseScratch(args[0], ABI_PARAM2);
-
-    Xbyak::Reg64 result = reg_alloc.ScratchGpr({ABI_RETURN});
-    Xbyak::Reg32 vaddr = code.ABI_PARAM2.cvt32();
-    Xbyak::Reg64 page_index = reg_alloc.ScratchGpr();
-    Xbyak::Reg64 page_offset = reg_alloc.ScratchGpr();
-
-    Xbyak::Label abort, end;
-
-    code.mov(result, reinterpret_cast<u64>(config.page_table));
-    code.mov(page_index.cvt32(), vaddr);
-    code.shr(page_index.cvt32(), 12);
-    code.mov(result, qword[result + page_index * 8]);
-    code.test(result, result);
-    code.jz(abort);
-    code.mov(page_offset.cvt32(), vaddr);
-    code.and_(page_offset.cvt32(), 4095);
-    switch (bit_size) {
+    code.mov(page_table, reinterpret_cast<u64>(config.page_table));
+    code.mov(tmp.cvt32(), vaddr.cvt32());
+    code.shr(tmp.cvt32(), int(A32::UserConfig::PAGE_BITS));
+    code.mov(page_table, qword[page_table + tmp * sizeof(void*)]);
+    code.test(page_table, page_table);
+    code.jz(abort, code.T_NEAR);
+    code.mov(tmp.cvt32(), vaddr.cvt32());
+    code.and_(tmp.cvt32(), static_cast<u32>(PAGE_MASK));
+    return page_table + tmp;
+}
+
+/// Code emitter: Returns the host address of vaddr within the fastmem mapping.
+/// No page-crossing check is needed: guest pages are contiguous in the mapping, and an access that touches an
+/// inaccessible page faults before any part of it is performed, so it is rewritten to use the callbacks.
+static Xbyak::RegExp EmitFastmemVAddr(BlockOfCode& code, A32EmitContext& ctx, const A32::UserConfig& config, Xbyak::Reg64 vaddr, boost::optional<Xbyak::Reg64> arg_scratch = {}) {
+    Xbyak::Reg64 offset = arg_scratch.value_or_eval([&]{ return ctx.reg_alloc.ScratchGpr(); });
+    Xbyak::Reg64 fastmem_base = ctx.reg_alloc.ScratchGpr();
+    // Zero-extends the 32-bit address.
+    code.mov(offset.cvt32(), vaddr.cvt32());
+    code.mov(fastmem_base, reinterpret_cast<u64>(config.fastmem_pointer));
+    return fastmem_base + offset;
+}
+
+template <typename RegExp>
+static void EmitLoad(BlockOfCode& code, Xbyak::Reg64 value, const RegExp& src_ptr, size_t bitsize) {
+    switch (bitsize) {
     case 8:
-        code.movzx(result, code.byte[result + page_offset]);
+        code.movzx(value.cvt32(), code.byte[src_ptr]);
         break;
     case 16:
-        code.movzx(result, word[result + page_offset]);
+        code.movzx(value.cvt32(), word[src_ptr]);
         break;
     case 32:
-        code.mov(result.cvt32(), dword[result + page_offset]);
+        code.mov(value.cvt32(), dword[src_ptr]);
         break;
     case 64:
-        code.mov(result.cvt64(), qword[result + page_offset]);
+        code.mov(value, qword[src_ptr]);
         break;
     default:
-        ASSERT_MSG(false, "Invalid bit_size");
+        ASSERT_MSG(false, "Invalid bitsize");
         break;
     }
-    code.jmp(end);
-    code.L(abort);
-    code.call(wrapped_fn);
-    code.L(end);
-
-    reg_alloc.DefineValue(inst, result);
 }
 
-template <typename T, void (A32::UserCallbacks::*raw_fn)(A32::VAddr, T)>
-static void WriteMemory(BlockOfCode& code, RegAlloc& reg_alloc, IR::Inst* inst, const A32::UserConfig& config, const CodePtr wrapped_fn) {
-    constexpr size_t bit_size = Common::BitSize<T>();
-    auto args = reg_alloc.GetArgumentInfo(inst);
-
-    if (!config.page_table) {
-        reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
-        Devirtualize<raw_fn>(config.callbacks).EmitCall(code);
-        return;
-    }
-
-    reg_alloc.ScratchGpr({ABI_RETURN});
-    reg_alloc.UseScratch(args[0], ABI_PARAM2);
-    reg_alloc.UseScratch(args[1], ABI_PARAM3);
-
-    Xbyak::Reg32 vaddr = code.ABI_PARAM2.cvt32();
-    Xbyak::Reg64 value = code.ABI_PARAM3;
-    Xbyak::Reg64 page_index = reg_alloc.ScratchGpr();
-    Xbyak::Reg64 page_offset = reg_alloc.ScratchGpr();
-
-    Xbyak::Label abort, end;
-
-    code.mov(rax, reinterpret_cast<u64>(config.page_table));
-    code.mov(page_index.cvt32(), vaddr);
-    code.shr(page_index.cvt32(), 12);
-    code.mov(rax, qword[rax + page_index * 8]);
-    code.test(rax, rax);
-    code.jz(abort);
-    code.mov(page_offset.cvt32(), vaddr);
-    code.and_(page_offset.cvt32(), 4095);
-    switch (bit_size) {
+template <typename RegExp>
+static void EmitStore(BlockOfCode& code, const RegExp& dest_ptr, Xbyak::Reg64 value, size_t bitsize) {
+    switch (bitsize) {
     case 8:
-        code.mov(code.byte[rax + page_offset], value.cvt8());
+        code.mov(code.byte[dest_ptr], value.cvt8());
         break;
     case 16:
-        code.mov(word[rax + page_offset], value.cvt16());
+        code.mov(word[dest_ptr], value.cvt16());
         break;
     case 32:
-        code.mov(dword[rax + page_offset], value.cvt32());
+        code.mov(dword[dest_ptr], value.cvt32());
         break;
     case 64:
-        code.mov(qword[rax + page_offset], value.cvt64());
+        code.mov(qword[dest_ptr], value);
         break;
     default:
-        ASSERT_MSG(false, "Invalid bit_size");
+        ASSERT_MSG(false, "Invalid bitsize");
         break;
     }
-    code.jmp(end);
+}
+
+void A32EmitX64::EmitDirectPageTableMemoryRead(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    Xbyak::Label abort, end;
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.ScratchGpr();
+
+    auto src_ptr = EmitVAddrLookup(code, ctx, config, abort, vaddr, bitsize, value);
+    EmitLoad(code, value, src_ptr, bitsize);
+    code.L(end);
+
+    code.SwitchToFarCode();
     code.L(abort);
-    code.call(wrapped_fn);
+    code.call(read_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())]);
+    code.jmp(end, code.T_NEAR);
+    code.SwitchToNearCode();
+
+    ctx.reg_alloc.DefineValue(inst, value);
+}
+
+void A32EmitX64::EmitDirectPageTableMemoryWrite(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    Xbyak::Label abort, end;
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.UseGpr(args[1]);
+
+    auto dest_ptr = EmitVAddrLookup(code, ctx, config, abort, vaddr, bitsize);
+    EmitStore(code, dest_ptr, value, bitsize);
     code.L(end);
+
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(write_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())]);
+    code.jmp(end, code.T_NEAR);
+    code.SwitchToNearCode();
+}
+
+void A32EmitX64::EmitFastmemRead(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.ScratchGpr();
+
+    auto src_ptr = EmitFastmemVAddr(code, ctx, config, vaddr, value);
+    const CodePtr access = code.getCurr();
+    EmitLoad(code, value, src_ptr, bitsize);
+    RegisterFastmemAccess(access, read_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())]);
+
+    ctx.reg_alloc.DefineValue(inst, value);
+}
+
+void A32EmitX64::EmitFastmemWrite(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.UseGpr(args[1]);
+
+    auto dest_ptr = EmitFastmemVAddr(code, ctx, config, vaddr);
+    const CodePtr access = code.getCurr();
+    EmitStore(code, dest_ptr, value, bitsize);
+    RegisterFastmemAccess(access, write_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())]);
 }
 
 void A32EmitX64::EmitA32ReadMemory8(A32EmitContext& ctx, IR::Inst* inst) {
-    ReadMemory<u8, &A32::UserCallbacks::MemoryRead8>(code, ctx.reg_alloc, inst, config, read_memory_8);
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 8);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 8);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A32::UserCallbacks::MemoryRead8>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32ReadMemory16(A32EmitContext& ctx, IR::Inst* inst) {
-    ReadMemory<u16, &A32::UserCallbacks::MemoryRead16>(code, ctx.reg_alloc, inst, config, read_memory_16);
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 16);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 16);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A32::UserCallbacks::MemoryRead16>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32ReadMemory32(A32EmitContext& ctx, IR::Inst* inst) {
-    ReadMemory<u32, &A32::UserCallbacks::MemoryRead32>(code, ctx.reg_alloc, inst, config, read_memory_32);
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 32);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 32);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A32::UserCallbacks::MemoryRead32>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32ReadMemory64(A32EmitContext& ctx, IR::Inst* inst) {
-    ReadMemory<u64, &A32::UserCallbacks::MemoryRead64>(code, ctx.reg_alloc, inst, config, read_memory_64);
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 64);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 64);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A32::UserCallbacks::MemoryRead64>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32WriteMemory8(A32EmitContext& ctx, IR::Inst* inst) {
-    WriteMemory<u8, &A32::UserCallbacks::MemoryWrite8>(code, ctx.reg_alloc, inst, config, write_memory_8);
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 8);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 8);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A32::UserCallbacks::MemoryWrite8>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32WriteMemory16(A32EmitContext& ctx, IR::Inst* inst) {
-    WriteMemory<u16, &A32::UserCallbacks::MemoryWrite16>(code, ctx.reg_alloc, inst, config, write_memory_16);
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 16);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 16);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A32::UserCallbacks::MemoryWrite16>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32WriteMemory32(A32EmitContext& ctx, IR::Inst* inst) {
-    WriteMemory<u32, &A32::UserCallbacks::MemoryWrite32>(code, ctx.reg_alloc, inst, config, write_memory_32);
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 32);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 32);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A32::UserCallbacks::MemoryWrite32>(config.callbacks).EmitCall(code);
 }
 
 void A32EmitX64::EmitA32WriteMemory64(A32EmitContext& ctx, IR::Inst* inst) {
-    WriteMemory<u64, &A32::UserCallbacks::MemoryWrite64>(code, ctx.reg_alloc, inst, config, write_memory_64);
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 64);
+        return;
+    }
+    if (config.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 64);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A32::UserCallbacks::MemoryWrite64>(config.callbacks).EmitCall(code);
+}
+
+/// Exclusive accesses to page table memory with the global monitor are performed as host atomics.
+void A32EmitX64::EmitPageTableSetExclusive(A32EmitContext& ctx, IR::Inst* inst) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ASSERT(args[1].IsImmediate());
+    const size_t size = args[1].GetImmediateU8();
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.ScratchGpr();
+
+    const auto lookup = [&](Xbyak::Label& abort, Xbyak::Reg64 vaddr, Xbyak::Reg64 scratch) {
+        return EmitVAddrLookup(code, ctx, config, abort, vaddr, size * 8, scratch);
+    };
+    EmitX64::EmitPageTableSetExclusive(vaddr, value, size * 8, lookup, [&](Xbyak::Reg64 vaddr) {
+        code.mov(code.ABI_PARAM2.cvt32(), vaddr.cvt32());
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&config));
+        code.mov(code.ABI_PARAM3, size);
+        code.CallFunction(static_cast<void(*)(const A32::UserConfig&, A32::VAddr, u8)>(
+            [](const A32::UserConfig& config, A32::VAddr vaddr, u8 size) {
+                config.global_monitor->Mark(config.processor_id, vaddr, size);
+            }
+        ));
+    });
+}
+
+void A32EmitX64::EmitA32SetExclusive(A32EmitContext& ctx, IR::Inst* inst) {
+    if (config.global_monitor && config.page_table) {
+        EmitPageTableSetExclusive(ctx, inst);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ASSERT(args[1].IsImmediate());
+
+    if (config.global_monitor) {
+        ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+
+        code.mov(code.byte[r15 + offsetof(A32JitState, exclusive_state)], u8(1));
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&config));
+        code.CallFunction(static_cast<void(*)(const A32::UserConfig&, A32::VAddr, u8)>(
+            [](const A32::UserConfig& config, A32::VAddr vaddr, u8 size) {
+                config.global_monitor->Mark(config.processor_id, vaddr, size);
+            }
+        ));
+        return;
+    }
+
+    Xbyak::Reg32 address = ctx.reg_alloc.UseGpr(args[0]).cvt32();
+
+    code.mov(code.byte[r15 + offsetof(A32JitState, exclusive_state)], u8(1));
+    code.mov(dword[r15 + offsetof(A32JitState, exclusive_address)], address);
+}
+
+/// Returns 0 if the write was performed, 1 if processor config.processor_id did not hold the reservation.
+template <typename T, void (A32::UserCallbacks::*fn)(A32::VAddr, T)>
+static u32 GlobalMonitorExclusiveWrite(const A32::UserConfig& config, A32::VAddr vaddr, T value) {
+    return config.global_monitor->DoExclusiveOperation(config.processor_id, vaddr, sizeof(T), [&]{
+        (config.callbacks->*fn)(vaddr, value);
+    }) ? 0 : 1;
+}
+
+void A32EmitX64::EmitPageTableExclusiveWrite(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.ScratchGpr({HostLoc::RAX});
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value;
+    if (bitsize == 64) {
+        value = ctx.reg_alloc.UseScratchGpr(args[1]);
+        Xbyak::Reg64 value_hi = ctx.reg_alloc.UseScratchGpr(args[2]);
+        code.mov(value.cvt32(), value.cvt32()); // zero extend to 64-bits
+        code.shl(value_hi, 32);
+        code.or_(value, value_hi);
+    } else {
+        value = ctx.reg_alloc.UseGpr(args[1]);
+    }
+    Xbyak::Reg32 passed = ctx.reg_alloc.ScratchGpr().cvt32();
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+
+    const auto lookup = [&](Xbyak::Label& abort, Xbyak::Reg64 vaddr, Xbyak::Reg64 scratch) {
+        return EmitVAddrLookup(code, ctx, config, abort, vaddr, bitsize, scratch);
+    };
+    EmitX64::EmitPageTableExclusiveWrite(vaddr, value, passed, tmp, bitsize, lookup, [&](Xbyak::Reg64 vaddr, Xbyak::Reg64 value) {
+        code.mov(code.ABI_PARAM2.cvt32(), vaddr.cvt32());
+        code.mov(code.ABI_PARAM3, value);
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&config));
+        switch (bitsize) {
+        case 8:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u8, &A32::UserCallbacks::MemoryWrite8>);
+            break;
+        case 16:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u16, &A32::UserCallbacks::MemoryWrite16>);
+            break;
+        case 32:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u32, &A32::UserCallbacks::MemoryWrite32>);
+            break;
+        case 64:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u64, &A32::UserCallbacks::MemoryWrite64>);
+            break;
+        }
+    });
+
+    ctx.reg_alloc.DefineValue(inst, passed);
 }
 
 template <typename T, void (A32::UserCallbacks::*fn)(A32::VAddr, T)>
-static void ExclusiveWrite(BlockOfCode& code, RegAlloc& reg_alloc, IR::Inst* inst, const A32::UserConfig& config, bool prepend_high_word) {
+static void ExclusiveWrite(BlockOfCode& code, A32EmitContext& ctx, IR::Inst* inst, const A32::UserConfig& config, bool prepend_high_word) {
+    RegAlloc& reg_alloc = ctx.reg_alloc;
     auto args = reg_alloc.GetArgumentInfo(inst);
+
+    if (config.global_monitor) {
+        if (prepend_high_word) {
+            reg_alloc.HostCall(inst, {}, args[0], args[1], args[2]);
+        } else {
+            reg_alloc.HostCall(inst, {}, args[0], args[1]);
+        }
+
+        Xbyak::Label end;
+
+        code.mov(code.ABI_RETURN, u32(1));
+        code.cmp(code.byte[r15 + offsetof(A32JitState, exclusive_state)], u8(0));
+        code.je(end);
+        code.mov(code.byte[r15 + offsetof(A32JitState, exclusive_state)], u8(0));
+        if (prepend_high_word) {
+            code.mov(code.ABI_PARAM3.cvt32(), code.ABI_PARAM3.cvt32()); // zero extend to 64-bits
+            code.shl(code.ABI_PARAM4, 32);
+            code.or_(code.ABI_PARAM3, code.ABI_PARAM4);
+        }
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&config));
+        code.CallFunction(&GlobalMonitorExclusiveWrite<T, fn>);
+        code.L(end);
+
+        return;
+    }
+
     if (prepend_high_word) {
         reg_alloc.HostCall(nullptr, {}, args[0], args[1], args[2]);
     } else {
@@ -856,19 +1142,35 @@ static void ExclusiveWrite(BlockOfCode& code, RegAlloc& reg_alloc, IR::Inst* ins
 }
 
 void A32EmitX64::EmitA32ExclusiveWriteMemory8(A32EmitContext& ctx, IR::Inst* inst) {
-    ExclusiveWrite<u8, &A32::UserCallbacks::MemoryWrite8>(code, ctx.reg_alloc, inst, config, false);
+    if (config.global_monitor && config.page_table) {
+        EmitPageTableExclusiveWrite(ctx, inst, 8);
+        return;
+    }
+    ExclusiveWrite<u8, &A32::UserCallbacks::MemoryWrite8>(code, ctx, inst, config, false);
 }
 
 void A32EmitX64::EmitA32ExclusiveWriteMemory16(A32EmitContext& ctx, IR::Inst* inst) {
-    ExclusiveWrite<u16, &A32::UserCallbacks::MemoryWrite16>(code, ctx.reg_alloc, inst, config, false);
+    if (config.global_monitor && config.page_table) {
+        EmitPageTableExclusiveWrite(ctx, inst, 16);
+        return;
+    }
+    ExclusiveWrite<u16, &A32::UserCallbacks::MemoryWrite16>(code, ctx, inst, config, false);
 }
 
 void A32EmitX64::EmitA32ExclusiveWriteMemory32(A32EmitContext& ctx, IR::Inst* inst) {
-    ExclusiveWrite<u32, &A32::UserCallbacks::MemoryWrite32>(code, ctx.reg_alloc, inst, config, false);
+    if (config.global_monitor && config.page_table) {
+        EmitPageTableExclusiveWrite(ctx, inst, 32);
+        return;
+    }
+    ExclusiveWrite<u32, &A32::UserCallbacks::MemoryWrite32>(code, ctx, inst, config, false);
 }
 
 void A32EmitX64::EmitA32ExclusiveWriteMemory64(A32EmitContext& ctx, IR::Inst* inst) {
-    ExclusiveWrite<u64, &A32::UserCallbacks::MemoryWrite64>(code, ctx.reg_alloc, inst, config, true);
+    if (config.global_monitor && config.page_table) {
+        EmitPageTableExclusiveWrite(ctx, inst, 64);
+        return;
+    }
+    ExclusiveWrite<u64, &A32::UserCallbacks::MemoryWrite64>(code, ctx, inst, config, true);
 }
 
 static void EmitCoprocessorException() {
@@ -1172,15 +1474,26 @@ void A32EmitX64::EmitTerminalImpl(IR::Term::LinkBlock terminal, IR::LocationDesc
     } else {
         EmitPatchJg(terminal.next);
     }
+
+    const auto emit_return = [&] {
+        code.mov(MJitStateReg(A32::Reg::PC), A32::LocationDescriptor{terminal.next}.PC());
+        PushRSBHelper(rax, rbx, terminal.next);
+        code.ForceReturnFromRunCode();
+    };
+
+    if (code.IsInFarCode()) {
+        // Already out of line (e.g. a side exit), so the return path can follow directly.
+        emit_return();
+        return;
+    }
+
     Xbyak::Label dest;
     code.jmp(dest, Xbyak::CodeGenerator::T_NEAR);
 
     code.SwitchToFarCode();
     code.align(16);
     code.L(dest);
-    code.mov(MJitStateReg(A32::Reg::PC), A32::LocationDescriptor{terminal.next}.PC());
-    PushRSBHelper(rax, rbx, terminal.next);
-    code.ForceReturnFromRunCode();
+    emit_return();
     code.SwitchToNearCode();
 }
 
@@ -1206,18 +1519,35 @@ void A32EmitX64::EmitTerminalImpl(IR::Term::PopRSBHint, IR::LocationDescriptor)
     code.or_(ebx, dword[r15 + offsetof(A32JitState, CPSR_et)]);
     code.or_(rbx, rcx);
 
+    Xbyak::Label rsb_cache_miss;
     code.mov(eax, dword[r15 + offsetof(A32JitState, rsb_ptr)]);
-    code.sub(eax, 1);
-    code.and_(eax, u32(A32JitState::RSBPtrMask));
+    code.sub(eax, u32(sizeof(A32JitState::RSBEntry)));
+    code.and_(eax, u32(code.GetJitStateInfo().rsb_ptr_mask));
     code.mov(dword[r15 + offsetof(A32JitState, rsb_ptr)], eax);
-    code.cmp(rbx, qword[r15 + offsetof(A32JitState, rsb_location_descriptors) + rax * sizeof(u64)]);
-    code.jne(code.GetReturnFromRunCodeAddress());
-    code.mov(rax, qword[r15 + offsetof(A32JitState, rsb_codeptrs) + rax * sizeof(u64)]);
-    code.jmp(rax);
+    code.cmp(rbx, qword[r15 + rax + offsetof(A32JitState, rsb) + offsetof(A32JitState::RSBEntry, location_descriptor)]);
+    code.jne(rsb_cache_miss);
+    code.UpdateStatistic(offsetof(A32JitState, rsb_hits));
+    code.jmp(qword[r15 + rax + offsetof(A32JitState, rsb) + offsetof(A32JitState::RSBEntry, code_ptr)]);
+    code.L(rsb_cache_miss);
+    code.UpdateStatistic(offsetof(A32JitState, rsb_misses));
+    code.ReturnFromRunCode();
+}
+
+void A32EmitX64::EmitTerminalImpl(IR::Term::FastDispatchHint, IR::LocationDescriptor initial_location) {
+    // This calculation has to match up with A32::LocationDescriptor::UniqueHash
+    code.mov(ecx, MJitStateReg(A32::Reg::PC));
+    code.shl(rcx, 32);
+    code.mov(ebx, dword[r15 + offsetof(A32JitState, FPSCR_mode)]);
+    code.or_(ebx, dword[r15 + offsetof(A32JitState, CPSR_et)]);
+    code.or_(rbx, rcx);
+
+    code.cmp(qword[r15 + offsetof(A32JitState, cycles_remaining)], 0);
+    code.jng(code.GetForceReturnFromRunCodeAddress());
+    EmitInlineCache(code.GetReturnFromRunCodeAddress(), initial_location);
 }
 
 void A32EmitX64::EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor initial_location) {
-    Xbyak::Label pass = EmitCond(terminal.if_);
+    Xbyak::Label pass = EmitCond(terminal.if_, Xbyak::CodeGenerator::T_NEAR);
     EmitTerminal(terminal.else_, initial_location);
     code.L(pass);
     EmitTerminal(terminal.then_, initial_location);
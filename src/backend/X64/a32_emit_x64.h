@@ -6,6 +6,9 @@
 
 #pragma once
 
+#include <map>
+#include <tuple>
+
 #include <boost/optional.hpp>
 
 #include "backend/x64/a32_jitstate.h"
@@ -42,6 +45,8 @@ public:
 
     void ClearCache() override;
 
+    std::vector<IR::LocationDescriptor> AdvanceCodeSegment() override;
+
     void InvalidateCacheRanges(const boost::icl::interval_set<u32>& ranges);
 
 protected:
@@ -49,15 +54,19 @@ protected:
     A32::Jit* jit_interface;
     BlockRangeInformation<u32> block_ranges;
 
-    const void* read_memory_8;
-    const void* read_memory_16;
-    const void* read_memory_32;
-    const void* read_memory_64;
-    const void* write_memory_8;
-    const void* write_memory_16;
-    const void* write_memory_32;
-    const void* write_memory_64;
-    void GenMemoryAccessors();
+    std::map<std::tuple<size_t, int, int>, void(*)()> read_fallbacks;
+    std::map<std::tuple<size_t, int, int>, void(*)()> write_fallbacks;
+    void GenFastmemFallbacks();
+
+    void EmitDirectPageTableMemoryRead(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitDirectPageTableMemoryWrite(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitPageTableSetExclusive(A32EmitContext& ctx, IR::Inst* inst);
+    void EmitPageTableExclusiveWrite(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+
+    /// True if config.fastmem_pointer is set and faults in emitted code can be handled.
+    const bool fastmem_enabled;
+    void EmitFastmemRead(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitFastmemWrite(A32EmitContext& ctx, IR::Inst* inst, size_t bitsize);
 
     // Microinstruction emitters
 #define OPCODE(...)
@@ -74,6 +83,7 @@ protected:
     void EmitTerminalImpl(IR::Term::LinkBlock terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::LinkBlockFast terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::PopRSBHint terminal, IR::LocationDescriptor initial_location) override;
+    void EmitTerminalImpl(IR::Term::FastDispatchHint terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::CheckBit terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::CheckHalt terminal, IR::LocationDescriptor initial_location) override;
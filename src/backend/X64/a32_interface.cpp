@@ -15,7 +15,9 @@
 #include "backend/x64/callback.h"
 #include "backend/x64/devirtualize.h"
 #include "backend/x64/jitstate_info.h"
+#include "backend/x64/translation_cache.h"
 #include "common/assert.h"
+#include "common/bit_util.h"
 #include "common/common_types.h"
 #include "common/llvm_disassemble.h"
 #include "common/scope_exit.h"
@@ -35,22 +37,33 @@ static RunCodeCallbacks GenRunCodeCallbacks(A32::UserCallbacks* cb, CodePtr (*Lo
         std::make_unique<ArgCallback>(LookupBlock, reinterpret_cast<u64>(arg)),
         std::make_unique<ArgCallback>(Devirtualize<&A32::UserCallbacks::AddTicks>(cb)),
         std::make_unique<ArgCallback>(Devirtualize<&A32::UserCallbacks::GetTicksRemaining>(cb)),
+        nullptr,
     };
 }
 
 struct Jit::Impl {
     Impl(Jit* jit, A32::UserConfig config)
-            : block_of_code(GenRunCodeCallbacks(config.callbacks, &GetCurrentBlock, this), JitStateInfo{jit_state})
+            : block_of_code(GenRunCodeCallbacks(config.callbacks, &GetCurrentBlock, this), JitStateInfo{jit_state, config.rsb_size}, CodeCacheConfig{config.code_cache_near_size, config.code_cache_far_size, config.code_cache_constant_pool_size, config.code_cache_lazy_commit}, config.enable_statistics, nullptr)
             , emitter(block_of_code, config, jit)
             , config(config)
             , jit_interface(jit)
-    {}
+    {
+        ASSERT(config.rsb_size >= 1 && config.rsb_size <= A32JitState::RSBMaxSize && Common::BitCount(config.rsb_size) == 1);
+
+        if (config.translation_cache_path) {
+            translation_cache = std::make_unique<TranslationCache>(config.translation_cache_path, std::initializer_list<u64>{
+                config.enable_superblocks,
+                config.superblock_max_instructions,
+            });
+        }
+    }
 
     A32JitState jit_state;
     BlockOfCode block_of_code;
     A32EmitX64 emitter;
 
     const A32::UserConfig config;
+    std::unique_ptr<TranslationCache> translation_cache;
 
     // Requests made during execution to invalidate the cache are queued up here.
     size_t invalid_cache_generation = 0;
@@ -58,10 +71,11 @@ struct Jit::Impl {
     bool invalidate_entire_cache = false;
 
     void Execute() {
-        const u32 new_rsb_ptr = (jit_state.rsb_ptr - 1) & A32JitState::RSBPtrMask;
-        if (jit_state.GetUniqueHash() == jit_state.rsb_location_descriptors[new_rsb_ptr]) {
+        const u32 new_rsb_ptr = (jit_state.rsb_ptr - sizeof(A32JitState::RSBEntry)) & block_of_code.GetJitStateInfo().rsb_ptr_mask;
+        const auto& rsb_entry = jit_state.rsb[new_rsb_ptr / sizeof(A32JitState::RSBEntry)];
+        if (jit_state.GetUniqueHash() == rsb_entry.location_descriptor) {
             jit_state.rsb_ptr = new_rsb_ptr;
-            block_of_code.RunCodeFrom(&jit_state, reinterpret_cast<CodePtr>(jit_state.rsb_codeptrs[new_rsb_ptr]));
+            block_of_code.RunCodeFrom(&jit_state, reinterpret_cast<CodePtr>(rsb_entry.code_ptr));
         } else {
             block_of_code.RunCode(&jit_state);
         }
@@ -125,21 +139,48 @@ private:
         if (block)
             return *block;
 
-        constexpr size_t MINIMUM_REMAINING_CODESIZE = 1 * 1024 * 1024;
-        if (block_of_code.SpaceRemaining() < MINIMUM_REMAINING_CODESIZE) {
-            invalidate_entire_cache = true;
-            PerformCacheInvalidation();
+        if (!block_of_code.EnsureBlockSpace()) {
+            // Evict the oldest segment of the cache
+            jit_state.ResetRSB();
+            emitter.AdvanceCodeSegment();
         }
 
-        IR::Block ir_block = A32::Translate(A32::LocationDescriptor{descriptor}, [this](u32 vaddr) { return config.callbacks->MemoryReadCode(vaddr); });
-        Optimization::A32GetSetElimination(ir_block);
-        Optimization::DeadCodeElimination(ir_block);
+        IR::Block ir_block = TranslateCached(descriptor);
+        // Folded memory reads are not covered by validation of the translation cache, so are done after it.
         Optimization::A32ConstantMemoryReads(ir_block, config.callbacks);
         Optimization::ConstantPropagation(ir_block);
         Optimization::DeadCodeElimination(ir_block);
         Optimization::VerificationPass(ir_block);
         return emitter.Emit(ir_block);
     }
+
+    /// Translates a block and removes redundant register accesses, reusing the result from the translation cache if possible.
+    IR::Block TranslateCached(IR::LocationDescriptor descriptor) {
+        const A32::TranslationOptions options{config.enable_superblocks, config.superblock_max_instructions};
+        const auto read_code = [this](u64 vaddr) { return config.callbacks->MemoryReadCode(static_cast<u32>(vaddr)); };
+
+        if (translation_cache) {
+            if (auto cached = translation_cache->Load(descriptor, 0, read_code)) {
+                return std::move(*cached);
+            }
+        }
+
+        TranslationCache::CodeReads code_reads;
+        IR::Block ir_block = A32::Translate(A32::LocationDescriptor{descriptor}, [&](u32 vaddr) {
+            const u32 instruction = read_code(vaddr);
+            if (translation_cache) {
+                code_reads.emplace_back(vaddr, instruction);
+            }
+            return instruction;
+        }, options);
+        Optimization::A32GetSetElimination(ir_block);
+        Optimization::DeadCodeElimination(ir_block);
+
+        if (translation_cache) {
+            translation_cache->Store(ir_block, 0, code_reads);
+        }
+        return ir_block;
+    }
 };
 
 Jit::Jit(UserConfig config) : impl(std::make_unique<Impl>(this, config)) {}
@@ -177,6 +218,18 @@ void Jit::HaltExecution() {
     impl->jit_state.halt_requested = true;
 }
 
+std::uint64_t Jit::GetRSBHitCount() const {
+    return impl->jit_state.rsb_hits;
+}
+
+std::uint64_t Jit::GetRSBMissCount() const {
+    return impl->jit_state.rsb_misses;
+}
+
+std::uint64_t Jit::GetMXCSRAccessCount() const {
+    return impl->jit_state.mxcsr_accesses;
+}
+
 std::array<u32, 16>& Jit::Regs() {
     return impl->jit_state.Reg;
 }
@@ -278,8 +331,7 @@ void TransferJitState(A32JitState& dest, const A32JitState& src, bool reset_rsb)
         dest.ResetRSB();
     } else {
         dest.rsb_ptr = src.rsb_ptr;
-        dest.rsb_location_descriptors = src.rsb_location_descriptors;
-        dest.rsb_codeptrs = src.rsb_codeptrs;
+        dest.rsb = src.rsb;
     }
 }
 
@@ -89,8 +89,7 @@ void A32JitState::SetCpsr(u32 cpsr) {
 }
 
 void A32JitState::ResetRSB() {
-    rsb_location_descriptors.fill(0xFFFFFFFFFFFFFFFFull);
-    rsb_codeptrs.fill(0);
+    rsb.fill(RSBEntry{0xFFFFFFFFFFFFFFFFull, 0});
 }
 
 /**
@@ -50,6 +50,7 @@ struct A32JitState {
     // For internal use (See: BlockOfCode::RunCode)
     u32 guest_MXCSR = 0x00001f80;
     u32 save_host_MXCSR = 0;
+    bool guest_MXCSR_live = false; // Switched to lazily, see BlockOfCode::SwitchMxcsrOnEntry.
     s64 cycles_to_run = 0;
     s64 cycles_remaining = 0;
     bool halt_requested = false;
@@ -58,12 +59,21 @@ struct A32JitState {
     static constexpr u32 RESERVATION_GRANULE_MASK = 0xFFFFFFF8;
     u32 exclusive_state = 0;
     u32 exclusive_address = 0;
-
-    static constexpr size_t RSBSize = 8; // MUST be a power of 2.
-    static constexpr size_t RSBPtrMask = RSBSize - 1;
+    /// Value read when the reservation was made, for exclusive accesses performed as host atomics.
+    u64 exclusive_value = 0;
+
+    // The size of the RSB in use is configured by UserConfig::rsb_size.
+    // rsb_ptr is a byte offset into rsb.
+    static constexpr size_t RSBMaxSize = 64; // MUST be a power of 2.
+    struct RSBEntry {
+        u64 location_descriptor;
+        u64 code_ptr;
+    };
     u32 rsb_ptr = 0;
-    std::array<u64, RSBSize> rsb_location_descriptors;
-    std::array<u64, RSBSize> rsb_codeptrs;
+    std::array<RSBEntry, RSBMaxSize> rsb;
+    u64 rsb_hits = 0;
+    u64 rsb_misses = 0;
+    u64 mxcsr_accesses = 0; // stmxcsr and ldmxcsr instructions executed
     void ResetRSB();
 
     u32 fpsr_exc = 0;
@@ -4,8 +4,12 @@
  * General Public License version 2 or any later version.
  */
 
+#include <algorithm>
 #include <initializer_list>
+#include <numeric>
+#include <type_traits>
 
+#include <boost/optional.hpp>
 #include <dynarmic/A64/exclusive_monitor.h>
 #include <fmt/ostream.h>
 
@@ -61,24 +65,80 @@ bool A64EmitContext::AccurateNaN() const {
 }
 
 A64EmitX64::A64EmitX64(BlockOfCode& code, A64::UserConfig conf)
-    : EmitX64(code), conf(conf)
+    : EmitX64(code), conf(conf), fastmem_enabled(conf.fastmem_pointer && code.SupportsFastmem())
 {
     GenMemory128Accessors();
     GenFastmemFallbacks();
+    GenTLBFillThunks();
+    GenInterpretSingleInstruction();
+    GenTerminalHandlers();
+    GenInlineCacheMissHandler();
     code.PreludeComplete();
+    ClearFastDispatchTable();
+
+    if (fastmem_enabled) {
+        code.SetFastmemCallback([](void* arg, u64 rip) { return static_cast<A64EmitX64*>(arg)->BackpatchFastmem(rip); }, this);
+    }
 }
 
-A64EmitX64::~A64EmitX64() = default;
+A64EmitX64::~A64EmitX64() {
+    if (fastmem_enabled) {
+        code.SetFastmemCallback(nullptr, nullptr);
+    }
+}
 
 A64EmitX64::BlockDescriptor A64EmitX64::Emit(IR::Block& block) {
+    return EmitBlock(block, conf.enable_tiered_compilation);
+}
+
+A64EmitX64::BlockDescriptor A64EmitX64::EmitOptimized(IR::Block& block) {
+    const auto iter = block_descriptors.find(block.Location());
+    ASSERT(iter != block_descriptors.end());
+    const CodePtr old_entrypoint = iter->second.entrypoint;
+    block_descriptors.erase(iter);
+    // Only the entrypoint of the old code remains reachable.
+    ReleaseInlineCaches(block.Location());
+
+    // Links to this block are patched to point at the new code.
+    const BlockDescriptor block_desc = EmitBlock(block, false);
+
+    // Anything else still holding the old entrypoint (e.g. the RSB) is redirected to the new code.
+    const CodePtr save_code_ptr = code.getCurr();
+    code.SetCodePtr(old_entrypoint);
+    code.jmp(block_desc.entrypoint);
+    code.SetCodePtr(save_code_ptr);
+
+    auto& entry = fast_dispatch_table[FastDispatchTableIndex(block.Location().Value())];
+    if (entry.location_descriptor == block.Location().Value()) {
+        entry.code_ptr = block_desc.entrypoint;
+    }
+
+    return block_desc;
+}
+
+A64EmitX64::BlockDescriptor A64EmitX64::EmitBlock(IR::Block& block, bool count_executions) {
     code.align();
     const u8* const entrypoint = code.getCurr();
 
     // Start emitting.
+    if (count_executions) {
+        EmitTierUpCounter(block.Location(), conf.tier_up_threshold);
+    }
+    EmitMxcsrPrelude(block);
     EmitCondPrelude(block);
 
     RegAlloc reg_alloc{code, A64JitState::SpillCount, SpillToOpArg<A64JitState>};
     A64EmitContext ctx{conf, reg_alloc, block};
+    if (fastmem_enabled) {
+        reg_alloc.ReserveGpr(HostLocRegIdx(BlockOfCode::FASTMEM_BASE.getIdx()));
+    }
+
+    Xbyak::Label loop_head_label;
+    if (IsSelfLoop(block)) {
+        PinLoopRegisters(block, reg_alloc);
+        code.L(loop_head_label);
+        loop_head = &loop_head_label;
+    }
 
     for (auto iter = block.begin(); iter != block.end(); ++iter) {
         IR::Inst* inst = &*iter;
@@ -114,15 +174,21 @@ A64EmitX64::BlockDescriptor A64EmitX64::Emit(IR::Block& block) {
     EmitX64::EmitTerminal(block.GetTerminal(), block.Location());
     code.int3();
 
+    loop_head = nullptr;
+    pinned_registers = {};
+
     const A64::LocationDescriptor descriptor{block.Location()};
     Patch(descriptor, entrypoint);
 
     const size_t size = static_cast<size_t>(code.getCurr() - entrypoint);
-    const A64::LocationDescriptor end_location{block.EndLocation()};
-    const auto range = boost::icl::discrete_interval<u64>::closed(descriptor.PC(), end_location.PC() - 1);
     A64EmitX64::BlockDescriptor block_desc{entrypoint, size};
     block_descriptors.emplace(descriptor.UniqueHash(), block_desc);
-    block_ranges.AddRange(range, descriptor);
+    for (const auto& [begin, end] : block.TranslatedRanges()) {
+        const A64::LocationDescriptor begin_location{begin};
+        const A64::LocationDescriptor end_location{end};
+        const auto range = boost::icl::discrete_interval<u64>::closed(begin_location.PC(), end_location.PC() - 1);
+        block_ranges.AddRange(range, descriptor);
+    }
 
     return block_desc;
 }
@@ -130,10 +196,228 @@ A64EmitX64::BlockDescriptor A64EmitX64::Emit(IR::Block& block) {
 void A64EmitX64::ClearCache() {
     EmitX64::ClearCache();
     block_ranges.ClearCache();
+    ClearFastDispatchTable();
+}
+
+std::vector<IR::LocationDescriptor> A64EmitX64::AdvanceCodeSegment() {
+    const auto locations = EmitX64::AdvanceCodeSegment();
+
+    for (const auto& location : locations) {
+        block_ranges.RemoveLocation(location);
+
+        auto& entry = fast_dispatch_table[FastDispatchTableIndex(location.Value())];
+        if (entry.location_descriptor == location.Value()) {
+            entry = FastDispatchEntry{0xFFFF'FFFF'FFFF'FFFFull, nullptr};
+        }
+    }
+
+    return locations;
 }
 
 void A64EmitX64::InvalidateCacheRanges(const boost::icl::interval_set<u64>& ranges) {
-    InvalidateBasicBlocks(block_ranges.InvalidateRanges(ranges));
+    const auto& locations = block_ranges.InvalidateRanges(ranges);
+    InvalidateBasicBlocks(locations);
+
+    for (const auto& location : locations) {
+        auto& entry = fast_dispatch_table[FastDispatchTableIndex(location.Value())];
+        if (entry.location_descriptor == location.Value()) {
+            entry = FastDispatchEntry{0xFFFF'FFFF'FFFF'FFFFull, nullptr};
+        }
+    }
+}
+
+size_t A64EmitX64::FastDispatchTableIndex(u64 location_descriptor) {
+    // This calculation has to match up with GenTerminalHandlers
+    return static_cast<size_t>((location_descriptor << 2) & fast_dispatch_table_mask) / sizeof(FastDispatchEntry);
+}
+
+void A64EmitX64::ClearFastDispatchTable() {
+    fast_dispatch_table.fill(FastDispatchEntry{0xFFFF'FFFF'FFFF'FFFFull, nullptr});
+}
+
+void A64EmitX64::PinLoopRegisters(const IR::Block& block, RegAlloc& reg_alloc) {
+    // Guest registers can only be kept in host registers if nothing outside of this block observes them.
+    const bool can_pin = std::none_of(block.begin(), block.end(), [](const IR::Inst& inst) {
+        return inst.CausesCPUException() || inst.GetOpcode() == IR::Opcode::A64DataCacheOperationRaised;
+    });
+    if (!can_pin) {
+        return;
+    }
+
+    std::array<size_t, 31> access_count{};
+    std::array<bool, 31> written{};
+    for (const auto& inst : block) {
+        switch (inst.GetOpcode()) {
+        case IR::Opcode::A64GetW:
+        case IR::Opcode::A64GetX:
+            access_count[static_cast<size_t>(inst.GetArg(0).GetA64RegRef())]++;
+            break;
+        case IR::Opcode::A64SetW:
+        case IR::Opcode::A64SetX:
+            access_count[static_cast<size_t>(inst.GetArg(0).GetA64RegRef())]++;
+            written[static_cast<size_t>(inst.GetArg(0).GetA64RegRef())] = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    std::array<size_t, 31> order;
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return access_count[a] > access_count[b]; });
+
+    // Callee-saved registers which are not otherwise used within the body of a block.
+    std::vector<HostLoc> pinnable_locations{HostLoc::RBP, HostLoc::R12, HostLoc::R13, HostLoc::R14};
+    if (fastmem_enabled) {
+        pinnable_locations.erase(std::find(pinnable_locations.begin(), pinnable_locations.end(), HostLocRegIdx(BlockOfCode::FASTMEM_BASE.getIdx())));
+    }
+    for (size_t i = 0; i < pinnable_locations.size() && access_count[order[i]] > 0; i++) {
+        const size_t index = order[i];
+        const Xbyak::Reg64 host_reg = HostLocToReg64(pinnable_locations[i]);
+
+        reg_alloc.ReserveGpr(pinnable_locations[i]);
+        code.mov(host_reg, qword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * index]);
+        pinned_registers[index] = host_reg;
+        pinned_register_written[index] = written[index];
+    }
+}
+
+void A64EmitX64::EmitBlockExit() {
+    for (size_t index = 0; index < pinned_registers.size(); index++) {
+        if (pinned_registers[index] && pinned_register_written[index]) {
+            code.mov(qword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * index], *pinned_registers[index]);
+        }
+    }
+}
+
+void A64EmitX64::EmitLocationDescriptorCalculation() {
+    // Location descriptor ends up in rbx
+    // This calculation has to match up with A64::LocationDescriptor::UniqueHash
+    // TODO: Optimization is available here based on known state of FPCR.
+    code.mov(rcx, A64::LocationDescriptor::PC_MASK);
+    code.and_(rcx, qword[r15 + offsetof(A64JitState, pc)]);
+    code.mov(ebx, dword[r15 + offsetof(A64JitState, fpcr)]);
+    code.and_(ebx, A64::LocationDescriptor::FPCR_MASK);
+    code.shl(rbx, 37);
+    code.or_(rbx, rcx);
+}
+
+void A64EmitX64::GenTerminalHandlers() {
+    Xbyak::Label fast_dispatch_cache_miss, rsb_cache_miss, rsb_cache_miss_count;
+
+    code.align();
+    terminal_handler_pop_rsb_hint = code.getCurr<const void*>();
+    EmitLocationDescriptorCalculation();
+    code.mov(eax, dword[r15 + offsetof(A64JitState, rsb_ptr)]);
+    code.sub(eax, u32(sizeof(A64JitState::RSBEntry)));
+    code.and_(eax, u32(code.GetJitStateInfo().rsb_ptr_mask));
+    code.mov(dword[r15 + offsetof(A64JitState, rsb_ptr)], eax);
+    code.cmp(rbx, qword[r15 + rax + offsetof(A64JitState, rsb) + offsetof(A64JitState::RSBEntry, location_descriptor)]);
+    code.jne(rsb_cache_miss_count);
+    code.UpdateStatistic(offsetof(A64JitState, rsb_hits));
+    code.jmp(qword[r15 + rax + offsetof(A64JitState, rsb) + offsetof(A64JitState::RSBEntry, code_ptr)]);
+    code.L(rsb_cache_miss_count);
+    code.UpdateStatistic(offsetof(A64JitState, rsb_misses));
+    if (conf.enable_fast_dispatch) {
+        code.jmp(rsb_cache_miss);
+    } else {
+        code.jmp(code.GetReturnFromRunCodeAddress());
+    }
+
+    if (!conf.enable_fast_dispatch) {
+        return;
+    }
+
+    // Probes the fast dispatch table with the location descriptor in rbx.
+    // On a table miss the dispatcher's lookup is called and the entry is updated with the result.
+    // This has the same cycle check as returning to the dispatcher.
+    code.align();
+    terminal_handler_fast_dispatch_hint = code.getCurr<const void*>();
+    EmitLocationDescriptorCalculation();
+    code.L(rsb_cache_miss);
+    code.JumpIfHaltRequested(code.GetForceReturnFromRunCodeAddress());
+    code.cmp(qword[r15 + offsetof(A64JitState, cycles_remaining)], 0);
+    code.jng(code.GetForceReturnFromRunCodeAddress());
+    // This calculation has to match up with FastDispatchTableIndex
+    code.mov(rbp, rbx);
+    code.shl(ebp, 2);
+    code.and_(ebp, u32(fast_dispatch_table_mask));
+    code.mov(rax, reinterpret_cast<u64>(fast_dispatch_table.data()));
+    code.add(rbp, rax);
+    code.cmp(rbx, qword[rbp + offsetof(FastDispatchEntry, location_descriptor)]);
+    code.jne(fast_dispatch_cache_miss);
+    code.UpdateStatistic(offsetof(A64JitState, fast_dispatch_hits));
+    code.jmp(qword[rbp + offsetof(FastDispatchEntry, code_ptr)]);
+    code.L(fast_dispatch_cache_miss);
+    code.UpdateStatistic(offsetof(A64JitState, fast_dispatch_misses));
+    code.LookupBlock();
+    if (interpret_single_instruction) {
+        // Blocks still being translated must not be cached.
+        Xbyak::Label cacheable;
+        code.mov(rcx, reinterpret_cast<u64>(interpret_single_instruction));
+        code.cmp(rax, rcx);
+        code.jne(cacheable);
+        code.jmp(rax);
+        code.L(cacheable);
+    }
+    code.mov(qword[rbp + offsetof(FastDispatchEntry, location_descriptor)], rbx);
+    code.mov(qword[rbp + offsetof(FastDispatchEntry, code_ptr)], rax);
+    code.jmp(rax);
+}
+
+static void FillTLB(A64JitState& jit_state, u64 vaddr, A64::UserCallbacks* callbacks) {
+    const u64 page = vaddr >> A64JitState::TLB_PAGE_BITS;
+    const u64 page_vaddr = page << A64JitState::TLB_PAGE_BITS;
+    u8* const host_page = callbacks->TranslatePage(page_vaddr);
+
+    const size_t index = page & (A64JitState::TLB_SIZE - 1);
+    if (!host_page) {
+        jit_state.tlb_tags[index] = page | A64JitState::TLB_TAG_NO_HOST_MEMORY;
+        return;
+    }
+    jit_state.tlb_tags[index] = page;
+    jit_state.tlb_offsets[index] = reinterpret_cast<u64>(host_page) - page_vaddr;
+}
+
+void A64EmitX64::GenTLBFillThunks() {
+    if (!conf.enable_tlb) {
+        return;
+    }
+
+    for (int vaddr_idx = 0; vaddr_idx < 16; vaddr_idx++) {
+        if (vaddr_idx == 4 || vaddr_idx == 15) {
+            continue;
+        }
+
+        code.align();
+        tlb_fill_thunks[vaddr_idx] = code.getCurr<void(*)()>();
+        ABI_PushCallerSaveRegistersAndAdjustStack(code);
+        if (vaddr_idx != code.ABI_PARAM2.getIdx()) {
+            code.mov(code.ABI_PARAM2, Xbyak::Reg64{vaddr_idx});
+        }
+        code.mov(code.ABI_PARAM1, r15);
+        code.mov(code.ABI_PARAM3, reinterpret_cast<u64>(conf.callbacks));
+        code.CallFunction(&FillTLB);
+        ABI_PopCallerSaveRegistersAndAdjustStack(code);
+        code.ret();
+    }
+}
+
+void A64EmitX64::GenInterpretSingleInstruction() {
+    if (conf.compilation_mode != A64::UserConfig::CompilationMode::BackgroundInterpret) {
+        return;
+    }
+
+    code.align();
+    interpret_single_instruction = code.getCurr<CodePtr>();
+    EmitAddCycles(1);
+    code.SwitchMxcsrOnExit();
+    Devirtualize<&A64::UserCallbacks::InterpreterFallback>(conf.callbacks).EmitCall(code,
+        [&](RegList param) {
+            code.mov(param[0], qword[r15 + offsetof(A64JitState, pc)]);
+            code.mov(param[1].cvt32(), 1);
+        });
+    code.ReturnFromRunCode(true);
 }
 
 void A64EmitX64::GenMemory128Accessors() {
@@ -308,7 +592,11 @@ void A64EmitX64::EmitA64GetW(A64EmitContext& ctx, IR::Inst* inst) {
     A64::Reg reg = inst->GetArg(0).GetA64RegRef();
 
     Xbyak::Reg32 result = ctx.reg_alloc.ScratchGpr().cvt32();
-    code.mov(result, dword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * static_cast<size_t>(reg)]);
+    if (const auto& pinned = pinned_registers[static_cast<size_t>(reg)]) {
+        code.mov(result, pinned->cvt32());
+    } else {
+        code.mov(result, dword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * static_cast<size_t>(reg)]);
+    }
     ctx.reg_alloc.DefineValue(inst, result);
 }
 
@@ -316,7 +604,11 @@ void A64EmitX64::EmitA64GetX(A64EmitContext& ctx, IR::Inst* inst) {
     A64::Reg reg = inst->GetArg(0).GetA64RegRef();
 
     Xbyak::Reg64 result = ctx.reg_alloc.ScratchGpr();
-    code.mov(result, qword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * static_cast<size_t>(reg)]);
+    if (const auto& pinned = pinned_registers[static_cast<size_t>(reg)]) {
+        code.mov(result, *pinned);
+    } else {
+        code.mov(result, qword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * static_cast<size_t>(reg)]);
+    }
     ctx.reg_alloc.DefineValue(inst, result);
 }
 
@@ -366,7 +658,7 @@ static u32 GetFPSRImpl(A64JitState* jit_state) {
 void A64EmitX64::EmitA64GetFPSR(A64EmitContext& ctx, IR::Inst* inst) {
     ctx.reg_alloc.HostCall(inst);
     code.mov(code.ABI_PARAM1, code.r15);
-    code.stmxcsr(code.dword[code.r15 + offsetof(A64JitState, guest_MXCSR)]);
+    code.StoreGuestMxcsr();
     code.CallFunction(GetFPSRImpl);
 }
 
@@ -374,7 +666,13 @@ void A64EmitX64::EmitA64SetW(A64EmitContext& ctx, IR::Inst* inst) {
     auto args = ctx.reg_alloc.GetArgumentInfo(inst);
     A64::Reg reg = inst->GetArg(0).GetA64RegRef();
     auto addr = qword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * static_cast<size_t>(reg)];
-    if (args[1].FitsInImmediateS32()) {
+    if (const auto& pinned = pinned_registers[static_cast<size_t>(reg)]) {
+        if (args[1].IsImmediate()) {
+            code.mov(pinned->cvt32(), args[1].GetImmediateU32());
+        } else {
+            code.mov(pinned->cvt32(), ctx.reg_alloc.UseGpr(args[1]).cvt32());
+        }
+    } else if (args[1].FitsInImmediateS32()) {
         code.mov(addr, args[1].GetImmediateS32());
     } else {
         // TODO: zext tracking, xmm variant
@@ -388,7 +686,15 @@ void A64EmitX64::EmitA64SetX(A64EmitContext& ctx, IR::Inst* inst) {
     auto args = ctx.reg_alloc.GetArgumentInfo(inst);
     A64::Reg reg = inst->GetArg(0).GetA64RegRef();
     auto addr = qword[r15 + offsetof(A64JitState, reg) + sizeof(u64) * static_cast<size_t>(reg)];
-    if (args[1].FitsInImmediateS32()) {
+    if (const auto& pinned = pinned_registers[static_cast<size_t>(reg)]) {
+        if (args[1].IsImmediate()) {
+            code.mov(*pinned, args[1].GetImmediateU64());
+        } else if (args[1].IsInXmm()) {
+            code.movq(*pinned, ctx.reg_alloc.UseXmm(args[1]));
+        } else {
+            code.mov(*pinned, ctx.reg_alloc.UseGpr(args[1]));
+        }
+    } else if (args[1].FitsInImmediateS32()) {
         code.mov(addr, args[1].GetImmediateS32());
     } else if (args[1].IsInXmm()) {
         Xbyak::Xmm to_store = ctx.reg_alloc.UseXmm(args[1]);
@@ -454,7 +760,7 @@ void A64EmitX64::EmitA64SetFPCR(A64EmitContext& ctx, IR::Inst* inst) {
     ctx.reg_alloc.HostCall(nullptr, {}, args[0]);
     code.mov(code.ABI_PARAM1, code.r15);
     code.CallFunction(SetFPCRImpl);
-    code.ldmxcsr(code.dword[code.r15 + offsetof(A64JitState, guest_MXCSR)]);
+    code.LoadGuestMxcsr();
 }
 
 static void SetFPSRImpl(A64JitState* jit_state, u32 value) {
@@ -466,7 +772,7 @@ void A64EmitX64::EmitA64SetFPSR(A64EmitContext& ctx, IR::Inst* inst) {
     ctx.reg_alloc.HostCall(nullptr, {}, args[0]);
     code.mov(code.ABI_PARAM1, code.r15);
     code.CallFunction(SetFPSRImpl);
-    code.ldmxcsr(code.dword[code.r15 + offsetof(A64JitState, guest_MXCSR)]);
+    code.LoadGuestMxcsr();
 }
 
 void A64EmitX64::EmitA64OrQC(A64EmitContext& ctx, IR::Inst* inst) {
@@ -593,6 +899,11 @@ void A64EmitX64::EmitA64ClearExclusive(A64EmitContext&, IR::Inst*) {
 }
 
 void A64EmitX64::EmitA64SetExclusive(A64EmitContext& ctx, IR::Inst* inst) {
+    if (conf.global_monitor && conf.page_table && inst->GetArg(1).GetU8() <= 8) {
+        EmitPageTableSetExclusive(ctx, inst);
+        return;
+    }
+
     if (conf.global_monitor) {
         auto args = ctx.reg_alloc.GetArgumentInfo(inst);
         ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
@@ -616,7 +927,50 @@ void A64EmitX64::EmitA64SetExclusive(A64EmitContext& ctx, IR::Inst* inst) {
     code.mov(qword[r15 + offsetof(A64JitState, exclusive_address)], address);
 }
 
+static Xbyak::RegExp EmitMultiLevelVAddrLookup(BlockOfCode& code, A64EmitContext& ctx, Xbyak::Label& abort, Xbyak::Reg64 vaddr, boost::optional<Xbyak::Reg64> arg_scratch) {
+    constexpr size_t PAGE_BITS = 12;
+    constexpr size_t PAGE_SIZE = 1 << PAGE_BITS;
+    const size_t levels = ctx.conf.page_table_levels;
+    const size_t valid_page_index_bits = ctx.conf.page_table_address_space_bits - PAGE_BITS;
+    const size_t level_bits = valid_page_index_bits / levels;
+    const size_t lower_levels_bits = level_bits * (levels - 1);
+    const size_t first_level_bits = valid_page_index_bits - lower_levels_bits;
+    const size_t unused_top_bits = 64 - ctx.conf.page_table_address_space_bits;
+
+    Xbyak::Reg64 page_table = arg_scratch.value_or_eval([&]{ return ctx.reg_alloc.ScratchGpr(); });
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+    code.mov(page_table, reinterpret_cast<u64>(ctx.conf.page_table));
+    code.mov(tmp, vaddr);
+    code.shr(tmp, int(PAGE_BITS + lower_levels_bits));
+    if (unused_top_bits != 0) {
+        if (ctx.conf.silently_mirror_page_table) {
+            code.and_(tmp.cvt32(), u32((1 << first_level_bits) - 1));
+        } else {
+            code.test(tmp, u32(-(1 << first_level_bits)));
+            code.jnz(abort, code.T_NEAR);
+        }
+    }
+
+    for (size_t level = 0; level < levels; level++) {
+        if (level != 0) {
+            code.mov(tmp, vaddr);
+            code.shr(tmp, int(PAGE_BITS + level_bits * (levels - 1 - level)));
+            code.and_(tmp.cvt32(), u32((1 << level_bits) - 1));
+        }
+        code.mov(page_table, qword[page_table + tmp * sizeof(void*)]);
+        code.test(page_table, page_table);
+        code.jz(abort, code.T_NEAR);
+    }
+    code.mov(tmp, vaddr);
+    code.and_(tmp, static_cast<u32>(PAGE_SIZE - 1));
+    return page_table + tmp;
+}
+
 static Xbyak::RegExp EmitVAddrLookup(BlockOfCode& code, A64EmitContext& ctx, Xbyak::Label& abort, Xbyak::Reg64 vaddr, boost::optional<Xbyak::Reg64> arg_scratch = {}) {
+    if (ctx.conf.page_table_levels > 1) {
+        return EmitMultiLevelVAddrLookup(code, ctx, abort, vaddr, arg_scratch);
+    }
+
     constexpr size_t PAGE_BITS = 12;
     constexpr size_t PAGE_SIZE = 1 << PAGE_BITS;
     const size_t valid_page_index_bits = ctx.conf.page_table_address_space_bits - PAGE_BITS;
@@ -714,65 +1068,37 @@ void A64EmitX64::EmitDirectPageTableMemoryWrite(A64EmitContext& ctx, IR::Inst* i
     code.SwitchToNearCode();
 }
 
-void A64EmitX64::EmitA64ReadMemory8(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryRead(ctx, inst, 8);
-        return;
-    }
-
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(inst, {}, args[0]);
-    Devirtualize<&A64::UserCallbacks::MemoryRead8>(conf.callbacks).EmitCall(code);
-}
-
-void A64EmitX64::EmitA64ReadMemory16(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryRead(ctx, inst, 16);
-        return;
-    }
-
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(inst, {}, args[0]);
-    Devirtualize<&A64::UserCallbacks::MemoryRead16>(conf.callbacks).EmitCall(code);
-}
-
-void A64EmitX64::EmitA64ReadMemory32(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryRead(ctx, inst, 32);
-        return;
+/// Code emitter: Returns the host address of vaddr within the fastmem mapping, jumping to abort if vaddr is out of range.
+/// The fastmem base is kept in BlockOfCode::FASTMEM_BASE, so without a range check no code is emitted.
+static Xbyak::RegExp EmitFastmemVAddr(BlockOfCode& code, A64EmitContext& ctx, Xbyak::Label& abort, Xbyak::Reg64 vaddr, boost::optional<Xbyak::Reg64> arg_scratch = {}) {
+    if (ctx.conf.fastmem_address_space_bits < 64 && !ctx.conf.fastmem_omit_range_check) {
+        Xbyak::Reg64 tmp = arg_scratch.value_or_eval([&]{ return ctx.reg_alloc.ScratchGpr(); });
+        code.mov(tmp, vaddr);
+        code.shr(tmp, int(ctx.conf.fastmem_address_space_bits));
+        code.jnz(abort, code.T_NEAR);
     }
-
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(inst, {}, args[0]);
-    Devirtualize<&A64::UserCallbacks::MemoryRead32>(conf.callbacks).EmitCall(code);
+    return BlockOfCode::FASTMEM_BASE + vaddr;
 }
 
-void A64EmitX64::EmitA64ReadMemory64(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryRead(ctx, inst, 64);
-        return;
-    }
+void A64EmitX64::EmitFastmemRead(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    Xbyak::Label abort, end;
 
     auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(inst, {}, args[0]);
-    Devirtualize<&A64::UserCallbacks::MemoryRead64>(conf.callbacks).EmitCall(code);
-}
-
-void A64EmitX64::EmitA64ReadMemory128(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        Xbyak::Label abort, end;
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
 
-        auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-        Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    if (bitsize == 128) {
         Xbyak::Xmm value = ctx.reg_alloc.ScratchXmm();
+        const auto fallback = read_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
 
-        auto src_ptr = EmitVAddrLookup(code, ctx, abort, vaddr);
+        auto src_ptr = EmitFastmemVAddr(code, ctx, abort, vaddr);
+        const CodePtr access = code.getCurr();
         code.movups(value, xword[src_ptr]);
+        RegisterFastmemAccess(access, fallback);
         code.L(end);
 
         code.SwitchToFarCode();
         code.L(abort);
-        code.call(read_fallbacks[std::make_tuple(128, vaddr.getIdx(), value.getIdx())]);
+        code.call(fallback);
         code.jmp(end, code.T_NEAR);
         code.SwitchToNearCode();
 
@@ -780,65 +1106,409 @@ void A64EmitX64::EmitA64ReadMemory128(A64EmitContext& ctx, IR::Inst* inst) {
         return;
     }
 
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(nullptr, {}, args[0]);
-    code.CallFunction(memory_read_128);
-    ctx.reg_alloc.DefineValue(inst, xmm1);
-}
-
-void A64EmitX64::EmitA64WriteMemory8(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryWrite(ctx, inst, 8);
-        return;
-    }
-
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
-    Devirtualize<&A64::UserCallbacks::MemoryWrite8>(conf.callbacks).EmitCall(code);
-}
+    Xbyak::Reg64 value = ctx.reg_alloc.ScratchGpr();
+    const auto fallback = read_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
 
-void A64EmitX64::EmitA64WriteMemory16(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryWrite(ctx, inst, 16);
-        return;
+    auto src_ptr = EmitFastmemVAddr(code, ctx, abort, vaddr, value);
+    const CodePtr access = code.getCurr();
+    switch (bitsize) {
+    case 8:
+        code.movzx(value.cvt32(), code.byte[src_ptr]);
+        break;
+    case 16:
+        code.movzx(value.cvt32(), word[src_ptr]);
+        break;
+    case 32:
+        code.mov(value.cvt32(), dword[src_ptr]);
+        break;
+    case 64:
+        code.mov(value, qword[src_ptr]);
+        break;
     }
+    RegisterFastmemAccess(access, fallback);
+    code.L(end);
 
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
-    Devirtualize<&A64::UserCallbacks::MemoryWrite16>(conf.callbacks).EmitCall(code);
-}
-
-void A64EmitX64::EmitA64WriteMemory32(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryWrite(ctx, inst, 32);
-        return;
-    }
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(fallback);
+    code.jmp(end, code.T_NEAR);
+    code.SwitchToNearCode();
 
-    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
-    Devirtualize<&A64::UserCallbacks::MemoryWrite32>(conf.callbacks).EmitCall(code);
+    ctx.reg_alloc.DefineValue(inst, value);
 }
 
-void A64EmitX64::EmitA64WriteMemory64(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        EmitDirectPageTableMemoryWrite(ctx, inst, 64);
-        return;
-    }
+void A64EmitX64::EmitFastmemWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    Xbyak::Label abort, end;
 
     auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
-    Devirtualize<&A64::UserCallbacks::MemoryWrite64>(conf.callbacks).EmitCall(code);
-}
-
-void A64EmitX64::EmitA64WriteMemory128(A64EmitContext& ctx, IR::Inst* inst) {
-    if (conf.page_table) {
-        Xbyak::Label abort, end;
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
 
-        auto args = ctx.reg_alloc.GetArgumentInfo(inst);
-        Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    if (bitsize == 128) {
         Xbyak::Xmm value = ctx.reg_alloc.UseXmm(args[1]);
+        const auto fallback = write_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
 
-        auto dest_ptr = EmitVAddrLookup(code, ctx, abort, vaddr);
+        auto dest_ptr = EmitFastmemVAddr(code, ctx, abort, vaddr);
+        const CodePtr access = code.getCurr();
+        code.movups(xword[dest_ptr], value);
+        RegisterFastmemAccess(access, fallback);
+        code.L(end);
+
+        code.SwitchToFarCode();
+        code.L(abort);
+        code.call(fallback);
+        code.jmp(end, code.T_NEAR);
+        code.SwitchToNearCode();
+        return;
+    }
+
+    Xbyak::Reg64 value = ctx.reg_alloc.UseGpr(args[1]);
+    const auto fallback = write_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
+
+    auto dest_ptr = EmitFastmemVAddr(code, ctx, abort, vaddr);
+    const CodePtr access = code.getCurr();
+    switch (bitsize) {
+    case 8:
+        code.mov(code.byte[dest_ptr], value.cvt8());
+        break;
+    case 16:
+        code.mov(word[dest_ptr], value.cvt16());
+        break;
+    case 32:
+        code.mov(dword[dest_ptr], value.cvt32());
+        break;
+    case 64:
+        code.mov(qword[dest_ptr], value);
+        break;
+    }
+    RegisterFastmemAccess(access, fallback);
+    code.L(end);
+
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(fallback);
+    code.jmp(end, code.T_NEAR);
+    code.SwitchToNearCode();
+}
+
+/// Code emitter: Accesses the `bitsize`-bit value at vaddr through the software TLB. emit_access is given the host address to access.
+/// The entry for the page of the first byte is compared against the page of the last byte, so an access crossing into the next
+/// page misses. On a miss the TLB entry is filled unless it is already present. fallback is called instead if the access crosses
+/// a page boundary or the page has no host memory.
+template <typename EmitAccess>
+static void EmitTLBAccess(BlockOfCode& code, A64EmitContext& ctx, Xbyak::Reg64 vaddr, size_t bitsize, void (*fill_thunk)(), void (*fallback)(), EmitAccess emit_access) {
+    Xbyak::Label miss, hit, use_fallback, end;
+
+    Xbyak::Reg64 page = ctx.reg_alloc.ScratchGpr();
+    Xbyak::Reg64 index = ctx.reg_alloc.ScratchGpr();
+    const auto tag = qword[r15 + offsetof(A64JitState, tlb_tags) + index * sizeof(u64)];
+    const auto emit_last_page = [&] {
+        code.lea(page, ptr[vaddr + bitsize / 8 - 1]);
+        code.shr(page, int(A64JitState::TLB_PAGE_BITS));
+    };
+
+    emit_last_page();
+    code.mov(index.cvt32(), vaddr.cvt32());
+    code.shr(index.cvt32(), int(A64JitState::TLB_PAGE_BITS));
+    code.and_(index.cvt32(), u32(A64JitState::TLB_SIZE - 1));
+    code.cmp(page, tag);
+    code.jne(miss, code.T_NEAR);
+    code.L(hit);
+    code.mov(page, qword[r15 + offsetof(A64JitState, tlb_offsets) + index * sizeof(u64)]);
+    emit_access(page + vaddr);
+    code.L(end);
+
+    code.SwitchToFarCode();
+    code.L(miss);
+    // If the entry for the first page is present, either the access crosses a page boundary or the page has no host memory.
+    code.mov(page, vaddr);
+    code.shr(page, int(A64JitState::TLB_PAGE_BITS));
+    code.cmp(page, tag);
+    code.je(use_fallback, code.T_NEAR);
+    static_assert(A64JitState::TLB_TAG_NO_HOST_MEMORY == u64(1) << 63);
+    code.bts(page, 63);
+    code.cmp(page, tag);
+    code.je(use_fallback, code.T_NEAR);
+    code.call(fill_thunk);
+    emit_last_page();
+    code.cmp(page, tag);
+    code.je(hit, code.T_NEAR);
+    code.L(use_fallback);
+    code.call(fallback);
+    code.jmp(end, code.T_NEAR);
+    code.SwitchToNearCode();
+}
+
+void A64EmitX64::EmitTLBMemoryRead(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    const auto fill_thunk = tlb_fill_thunks[vaddr.getIdx()];
+
+    if (bitsize == 128) {
+        Xbyak::Xmm value = ctx.reg_alloc.ScratchXmm();
+        const auto fallback = read_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
+        EmitTLBAccess(code, ctx, vaddr, bitsize, fill_thunk, fallback, [&](const Xbyak::RegExp& src_ptr) {
+            code.movups(value, xword[src_ptr]);
+        });
+        ctx.reg_alloc.DefineValue(inst, value);
+        return;
+    }
+
+    Xbyak::Reg64 value = ctx.reg_alloc.ScratchGpr();
+    const auto fallback = read_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
+    EmitTLBAccess(code, ctx, vaddr, bitsize, fill_thunk, fallback, [&](const Xbyak::RegExp& src_ptr) {
+        switch (bitsize) {
+        case 8:
+            code.movzx(value.cvt32(), code.byte[src_ptr]);
+            break;
+        case 16:
+            code.movzx(value.cvt32(), word[src_ptr]);
+            break;
+        case 32:
+            code.mov(value.cvt32(), dword[src_ptr]);
+            break;
+        case 64:
+            code.mov(value, qword[src_ptr]);
+            break;
+        }
+    });
+    ctx.reg_alloc.DefineValue(inst, value);
+}
+
+void A64EmitX64::EmitTLBMemoryWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    const auto fill_thunk = tlb_fill_thunks[vaddr.getIdx()];
+
+    if (bitsize == 128) {
+        Xbyak::Xmm value = ctx.reg_alloc.UseXmm(args[1]);
+        const auto fallback = write_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
+        EmitTLBAccess(code, ctx, vaddr, bitsize, fill_thunk, fallback, [&](const Xbyak::RegExp& dest_ptr) {
+            code.movups(xword[dest_ptr], value);
+        });
+        return;
+    }
+
+    Xbyak::Reg64 value = ctx.reg_alloc.UseGpr(args[1]);
+    const auto fallback = write_fallbacks[std::make_tuple(bitsize, vaddr.getIdx(), value.getIdx())];
+    EmitTLBAccess(code, ctx, vaddr, bitsize, fill_thunk, fallback, [&](const Xbyak::RegExp& dest_ptr) {
+        switch (bitsize) {
+        case 8:
+            code.mov(code.byte[dest_ptr], value.cvt8());
+            break;
+        case 16:
+            code.mov(word[dest_ptr], value.cvt16());
+            break;
+        case 32:
+            code.mov(dword[dest_ptr], value.cvt32());
+            break;
+        case 64:
+            code.mov(qword[dest_ptr], value);
+            break;
+        }
+    });
+}
+
+void A64EmitX64::EmitA64ReadMemory8(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 8);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 8);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryRead(ctx, inst, 8);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A64::UserCallbacks::MemoryRead8>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64ReadMemory16(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 16);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 16);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryRead(ctx, inst, 16);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A64::UserCallbacks::MemoryRead16>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64ReadMemory32(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 32);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 32);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryRead(ctx, inst, 32);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A64::UserCallbacks::MemoryRead32>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64ReadMemory64(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 64);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryRead(ctx, inst, 64);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryRead(ctx, inst, 64);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0]);
+    Devirtualize<&A64::UserCallbacks::MemoryRead64>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64ReadMemory128(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemRead(ctx, inst, 128);
+        return;
+    }
+    if (conf.page_table) {
+        Xbyak::Label abort, end;
+
+        auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+        Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+        Xbyak::Xmm value = ctx.reg_alloc.ScratchXmm();
+
+        auto src_ptr = EmitVAddrLookup(code, ctx, abort, vaddr);
+        code.movups(value, xword[src_ptr]);
+        code.L(end);
+
+        code.SwitchToFarCode();
+        code.L(abort);
+        code.call(read_fallbacks[std::make_tuple(128, vaddr.getIdx(), value.getIdx())]);
+        code.jmp(end, code.T_NEAR);
+        code.SwitchToNearCode();
+
+        ctx.reg_alloc.DefineValue(inst, value);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryRead(ctx, inst, 128);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0]);
+    code.CallFunction(memory_read_128);
+    ctx.reg_alloc.DefineValue(inst, xmm1);
+}
+
+void A64EmitX64::EmitA64WriteMemory8(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 8);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 8);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryWrite(ctx, inst, 8);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A64::UserCallbacks::MemoryWrite8>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64WriteMemory16(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 16);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 16);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryWrite(ctx, inst, 16);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A64::UserCallbacks::MemoryWrite16>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64WriteMemory32(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 32);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 32);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryWrite(ctx, inst, 32);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A64::UserCallbacks::MemoryWrite32>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64WriteMemory64(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 64);
+        return;
+    }
+    if (conf.page_table) {
+        EmitDirectPageTableMemoryWrite(ctx, inst, 64);
+        return;
+    }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryWrite(ctx, inst, 64);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(nullptr, {}, args[0], args[1]);
+    Devirtualize<&A64::UserCallbacks::MemoryWrite64>(conf.callbacks).EmitCall(code);
+}
+
+void A64EmitX64::EmitA64WriteMemory128(A64EmitContext& ctx, IR::Inst* inst) {
+    if (fastmem_enabled) {
+        EmitFastmemWrite(ctx, inst, 128);
+        return;
+    }
+    if (conf.page_table) {
+        Xbyak::Label abort, end;
+
+        auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+        Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+        Xbyak::Xmm value = ctx.reg_alloc.UseXmm(args[1]);
+
+        auto dest_ptr = EmitVAddrLookup(code, ctx, abort, vaddr);
         code.movups(xword[dest_ptr], value);
         code.L(end);
 
@@ -849,6 +1519,10 @@ void A64EmitX64::EmitA64WriteMemory128(A64EmitContext& ctx, IR::Inst* inst) {
         code.SwitchToNearCode();
         return;
     }
+    if (conf.enable_tlb) {
+        EmitTLBMemoryWrite(ctx, inst, 128);
+        return;
+    }
 
     auto args = ctx.reg_alloc.GetArgumentInfo(inst);
     ctx.reg_alloc.Use(args[0], ABI_PARAM2);
@@ -858,7 +1532,75 @@ void A64EmitX64::EmitA64WriteMemory128(A64EmitContext& ctx, IR::Inst* inst) {
     code.CallFunction(memory_write_128);
 }
 
+/// Returns 0 if the write was performed, 1 if processor conf.processor_id did not hold the reservation.
+template <typename T, void (A64::UserCallbacks::*write)(u64, T)>
+static u32 GlobalMonitorExclusiveWrite(A64::UserConfig& conf, u64 vaddr, T value) {
+    return conf.global_monitor->DoExclusiveOperation(conf.processor_id, vaddr, sizeof(T), [&]{
+        (conf.callbacks->*write)(vaddr, value);
+    }) ? 0 : 1;
+}
+
+void A64EmitX64::EmitPageTableSetExclusive(A64EmitContext& ctx, IR::Inst* inst) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    const size_t size = args[1].GetImmediateU8();
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.ScratchGpr();
+
+    const auto lookup = [&](Xbyak::Label& abort, Xbyak::Reg64 vaddr, Xbyak::Reg64 scratch) {
+        return EmitVAddrLookup(code, ctx, abort, vaddr, scratch);
+    };
+    EmitX64::EmitPageTableSetExclusive(vaddr, value, size * 8, lookup, [&](Xbyak::Reg64 vaddr) {
+        code.mov(code.ABI_PARAM2, vaddr);
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+        code.mov(code.ABI_PARAM3, size);
+        code.CallFunction(static_cast<void(*)(A64::UserConfig&, u64, u8)>(
+            [](A64::UserConfig& conf, u64 vaddr, u8 size) {
+                conf.global_monitor->Mark(conf.processor_id, vaddr, size);
+            }
+        ));
+    });
+}
+
+void A64EmitX64::EmitPageTableExclusiveWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.ScratchGpr({HostLoc::RAX});
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.UseGpr(args[1]);
+    Xbyak::Reg32 passed = ctx.reg_alloc.ScratchGpr().cvt32();
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+
+    const auto lookup = [&](Xbyak::Label& abort, Xbyak::Reg64 vaddr, Xbyak::Reg64 scratch) {
+        return EmitVAddrLookup(code, ctx, abort, vaddr, scratch);
+    };
+    EmitX64::EmitPageTableExclusiveWrite(vaddr, value, passed, tmp, bitsize, lookup, [&](Xbyak::Reg64 vaddr, Xbyak::Reg64 value) {
+        code.mov(code.ABI_PARAM2, vaddr);
+        code.mov(code.ABI_PARAM3, value);
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+        switch (bitsize) {
+        case 8:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u8, &A64::UserCallbacks::MemoryWrite8>);
+            break;
+        case 16:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u16, &A64::UserCallbacks::MemoryWrite16>);
+            break;
+        case 32:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u32, &A64::UserCallbacks::MemoryWrite32>);
+            break;
+        case 64:
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u64, &A64::UserCallbacks::MemoryWrite64>);
+            break;
+        }
+    });
+
+    ctx.reg_alloc.DefineValue(inst, passed);
+}
+
 void A64EmitX64::EmitExclusiveWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    if (conf.global_monitor && conf.page_table && bitsize != 128) {
+        EmitPageTableExclusiveWrite(ctx, inst, bitsize);
+        return;
+    }
+
     if (conf.global_monitor) {
         auto args = ctx.reg_alloc.GetArgumentInfo(inst);
 
@@ -879,40 +1621,16 @@ void A64EmitX64::EmitExclusiveWrite(A64EmitContext& ctx, IR::Inst* inst, size_t
         code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
         switch (bitsize) {
         case 8:
-            code.CallFunction(static_cast<u32(*)(A64::UserConfig&, u64, u8)>(
-                [](A64::UserConfig& conf, u64 vaddr, u8 value) -> u32 {
-                    return conf.global_monitor->DoExclusiveOperation(conf.processor_id, vaddr, 1, [&]{
-                        conf.callbacks->MemoryWrite8(vaddr, value);
-                    }) ? 0 : 1;
-                }
-            ));
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u8, &A64::UserCallbacks::MemoryWrite8>);
             break;
         case 16:
-            code.CallFunction(static_cast<u32(*)(A64::UserConfig&, u64, u16)>(
-                [](A64::UserConfig& conf, u64 vaddr, u16 value) -> u32 {
-                    return conf.global_monitor->DoExclusiveOperation(conf.processor_id, vaddr, 2, [&]{
-                        conf.callbacks->MemoryWrite16(vaddr, value);
-                    }) ? 0 : 1;
-                }
-            ));
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u16, &A64::UserCallbacks::MemoryWrite16>);
             break;
         case 32:
-            code.CallFunction(static_cast<u32(*)(A64::UserConfig&, u64, u32)>(
-                [](A64::UserConfig& conf, u64 vaddr, u32 value) -> u32 {
-                    return conf.global_monitor->DoExclusiveOperation(conf.processor_id, vaddr, 4, [&]{
-                        conf.callbacks->MemoryWrite32(vaddr, value);
-                    }) ? 0 : 1;
-                }
-            ));
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u32, &A64::UserCallbacks::MemoryWrite32>);
             break;
         case 64:
-            code.CallFunction(static_cast<u32(*)(A64::UserConfig&, u64, u64)>(
-                [](A64::UserConfig& conf, u64 vaddr, u64 value) -> u32 {
-                    return conf.global_monitor->DoExclusiveOperation(conf.processor_id, vaddr, 8, [&]{
-                        conf.callbacks->MemoryWrite64(vaddr, value);
-                    }) ? 0 : 1;
-                }
-            ));
+            code.CallFunction(&GlobalMonitorExclusiveWrite<u64, &A64::UserCallbacks::MemoryWrite64>);
             break;
         case 128:
             code.sub(rsp, 16 + ABI_SHADOW_SPACE);
@@ -980,6 +1698,469 @@ void A64EmitX64::EmitA64ExclusiveWriteMemory128(A64EmitContext& ctx, IR::Inst* i
     EmitExclusiveWrite(ctx, inst, 128);
 }
 
+template <typename T>
+static T ApplyAtomicOp(T memory, T value, A64::AtomicOp op) {
+    using S = std::make_signed_t<T>;
+    switch (op) {
+    case A64::AtomicOp::Add:
+        return static_cast<T>(memory + value);
+    case A64::AtomicOp::Clear:
+        return static_cast<T>(memory & ~value);
+    case A64::AtomicOp::Eor:
+        return static_cast<T>(memory ^ value);
+    case A64::AtomicOp::Set:
+        return static_cast<T>(memory | value);
+    case A64::AtomicOp::SMax:
+        return static_cast<S>(memory) > static_cast<S>(value) ? memory : value;
+    case A64::AtomicOp::SMin:
+        return static_cast<S>(memory) < static_cast<S>(value) ? memory : value;
+    case A64::AtomicOp::UMax:
+        return std::max(memory, value);
+    case A64::AtomicOp::UMin:
+        return std::min(memory, value);
+    case A64::AtomicOp::Swap:
+        return value;
+    }
+    UNREACHABLE();
+    return {};
+}
+
+/// Reads memory at vaddr and writes back the value returned by modify, if any. Returns the value read.
+/// With a global monitor the write is only made if no other processor has written to vaddr in between.
+template <typename T, T (A64::UserCallbacks::*read)(u64), void (A64::UserCallbacks::*write)(u64, T), typename Modify>
+static T CallbackReadModifyWrite(A64::UserConfig& conf, u64 vaddr, Modify modify) {
+    if (!conf.global_monitor) {
+        const T memory = (conf.callbacks->*read)(vaddr);
+        if (const boost::optional<T> result = modify(memory)) {
+            (conf.callbacks->*write)(vaddr, *result);
+        }
+        return memory;
+    }
+
+    while (true) {
+        conf.global_monitor->Mark(conf.processor_id, vaddr, sizeof(T));
+        const T memory = (conf.callbacks->*read)(vaddr);
+        const boost::optional<T> result = modify(memory);
+        if (!result) {
+            return memory;
+        }
+        const bool written = conf.global_monitor->DoExclusiveOperation(conf.processor_id, vaddr, sizeof(T), [&]{
+            (conf.callbacks->*write)(vaddr, *result);
+        });
+        if (written) {
+            return memory;
+        }
+    }
+}
+
+template <typename T, T (A64::UserCallbacks::*read)(u64), void (A64::UserCallbacks::*write)(u64, T)>
+static T CallbackAtomicMemoryOp(A64::UserConfig& conf, u64 vaddr, u64 value, u64 op) {
+    return CallbackReadModifyWrite<T, read, write>(conf, vaddr, [&](T memory) -> boost::optional<T> {
+        return ApplyAtomicOp<T>(memory, static_cast<T>(value), static_cast<A64::AtomicOp>(op));
+    });
+}
+
+template <typename T, T (A64::UserCallbacks::*read)(u64), void (A64::UserCallbacks::*write)(u64, T)>
+static T CallbackCompareAndSwap(A64::UserConfig& conf, u64 vaddr, u64 expected, u64 desired) {
+    return CallbackReadModifyWrite<T, read, write>(conf, vaddr, [&](T memory) -> boost::optional<T> {
+        if (memory != static_cast<T>(expected)) {
+            return boost::none;
+        }
+        return static_cast<T>(desired);
+    });
+}
+
+/// The value in memory is returned in expected.
+static void CallbackCompareAndSwap128(A64::UserConfig& conf, u64 vaddr, A64::Vector& expected, const A64::Vector& desired) {
+    expected = CallbackReadModifyWrite<A64::Vector, &A64::UserCallbacks::MemoryRead128, &A64::UserCallbacks::MemoryWrite128>(conf, vaddr, [&](const A64::Vector& memory) -> boost::optional<A64::Vector> {
+        if (memory != expected) {
+            return boost::none;
+        }
+        return desired;
+    });
+}
+
+static void EmitCallAtomicMemoryOpFallback(BlockOfCode& code, size_t bitsize) {
+    switch (bitsize) {
+    case 8:
+        code.CallFunction(&CallbackAtomicMemoryOp<u8, &A64::UserCallbacks::MemoryRead8, &A64::UserCallbacks::MemoryWrite8>);
+        break;
+    case 16:
+        code.CallFunction(&CallbackAtomicMemoryOp<u16, &A64::UserCallbacks::MemoryRead16, &A64::UserCallbacks::MemoryWrite16>);
+        break;
+    case 32:
+        code.CallFunction(&CallbackAtomicMemoryOp<u32, &A64::UserCallbacks::MemoryRead32, &A64::UserCallbacks::MemoryWrite32>);
+        break;
+    case 64:
+        code.CallFunction(&CallbackAtomicMemoryOp<u64, &A64::UserCallbacks::MemoryRead64, &A64::UserCallbacks::MemoryWrite64>);
+        break;
+    default:
+        UNREACHABLE();
+    }
+}
+
+static void EmitCallCompareAndSwapFallback(BlockOfCode& code, size_t bitsize) {
+    switch (bitsize) {
+    case 8:
+        code.CallFunction(&CallbackCompareAndSwap<u8, &A64::UserCallbacks::MemoryRead8, &A64::UserCallbacks::MemoryWrite8>);
+        break;
+    case 16:
+        code.CallFunction(&CallbackCompareAndSwap<u16, &A64::UserCallbacks::MemoryRead16, &A64::UserCallbacks::MemoryWrite16>);
+        break;
+    case 32:
+        code.CallFunction(&CallbackCompareAndSwap<u32, &A64::UserCallbacks::MemoryRead32, &A64::UserCallbacks::MemoryWrite32>);
+        break;
+    case 64:
+        code.CallFunction(&CallbackCompareAndSwap<u64, &A64::UserCallbacks::MemoryRead64, &A64::UserCallbacks::MemoryWrite64>);
+        break;
+    default:
+        UNREACHABLE();
+    }
+}
+
+static Xbyak::Address SizedPtr(BlockOfCode& code, size_t bitsize, const Xbyak::RegExp& ptr) {
+    switch (bitsize) {
+    case 8:
+        return code.byte[ptr];
+    case 16:
+        return code.word[ptr];
+    case 32:
+        return code.dword[ptr];
+    case 64:
+        return code.qword[ptr];
+    default:
+        UNREACHABLE();
+        return code.qword[ptr];
+    }
+}
+
+static Xbyak::Reg SizedReg(Xbyak::Reg64 reg, size_t bitsize) {
+    switch (bitsize) {
+    case 8:
+        return reg.cvt8();
+    case 16:
+        return reg.cvt16();
+    case 32:
+        return reg.cvt32();
+    case 64:
+        return reg;
+    default:
+        UNREACHABLE();
+        return reg;
+    }
+}
+
+/// Zero-extends the bitsize-bit value in reg, as the host atomics and fallbacks leave the upper bits undefined.
+static void EmitZeroExtendResult(BlockOfCode& code, Xbyak::Reg64 reg, size_t bitsize) {
+    switch (bitsize) {
+    case 8:
+        code.movzx(reg.cvt32(), reg.cvt8());
+        break;
+    case 16:
+        code.movzx(reg.cvt32(), reg.cvt16());
+        break;
+    case 32:
+        code.mov(reg.cvt32(), reg.cvt32());
+        break;
+    }
+}
+
+/// Unaligned atomics may span two pages which are not adjacent in host memory, so they are left to the fallback.
+static void EmitAtomicAlignmentCheck(BlockOfCode& code, Xbyak::Reg64 vaddr, size_t bitsize, Xbyak::Label& abort) {
+    if (bitsize == 8) {
+        return;
+    }
+    code.test(vaddr.cvt32(), u32(bitsize / 8 - 1));
+    code.jnz(abort, code.T_NEAR);
+}
+
+void A64EmitX64::EmitPageTableAtomicMemoryOp(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    const auto op = static_cast<A64::AtomicOp>(args[2].GetImmediateU8());
+    Xbyak::Reg64 result = ctx.reg_alloc.ScratchGpr({HostLoc::RAX});
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 value = ctx.reg_alloc.UseGpr(args[1]);
+    Xbyak::Reg64 new_value = ctx.reg_alloc.ScratchGpr();
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+
+    Xbyak::Label abort, end;
+
+    EmitAtomicAlignmentCheck(code, vaddr, bitsize, abort);
+    const auto memory = SizedPtr(code, bitsize, EmitVAddrLookup(code, ctx, abort, vaddr, tmp));
+    switch (op) {
+    case A64::AtomicOp::Add:
+        code.mov(result, value);
+        code.lock();
+        code.xadd(memory, SizedReg(result, bitsize));
+        break;
+    case A64::AtomicOp::Swap:
+        code.mov(result, value);
+        code.xchg(memory, SizedReg(result, bitsize));
+        break;
+    default: {
+        Xbyak::Label retry;
+        code.mov(SizedReg(result, bitsize), memory);
+        code.L(retry);
+        switch (op) {
+        case A64::AtomicOp::Clear:
+            code.mov(new_value, value);
+            code.not_(new_value);
+            code.and_(new_value, result);
+            break;
+        case A64::AtomicOp::Eor:
+            code.mov(new_value, result);
+            code.xor_(new_value, value);
+            break;
+        case A64::AtomicOp::Set:
+            code.mov(new_value, result);
+            code.or_(new_value, value);
+            break;
+        case A64::AtomicOp::SMax:
+            code.mov(new_value, result);
+            code.cmp(SizedReg(result, bitsize), SizedReg(value, bitsize));
+            code.cmovl(new_value, value);
+            break;
+        case A64::AtomicOp::SMin:
+            code.mov(new_value, result);
+            code.cmp(SizedReg(result, bitsize), SizedReg(value, bitsize));
+            code.cmovg(new_value, value);
+            break;
+        case A64::AtomicOp::UMax:
+            code.mov(new_value, result);
+            code.cmp(SizedReg(result, bitsize), SizedReg(value, bitsize));
+            code.cmovb(new_value, value);
+            break;
+        case A64::AtomicOp::UMin:
+            code.mov(new_value, result);
+            code.cmp(SizedReg(result, bitsize), SizedReg(value, bitsize));
+            code.cmova(new_value, value);
+            break;
+        default:
+            UNREACHABLE();
+        }
+        // On failure cmpxchg reloads result with the current value in memory.
+        code.lock();
+        code.cmpxchg(memory, SizedReg(new_value, bitsize));
+        code.jne(retry);
+        break;
+    }
+    }
+    code.L(end);
+    EmitZeroExtendResult(code, result, bitsize);
+
+    Xbyak::Label fallback;
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(fallback);
+    code.jmp(end, code.T_NEAR);
+    code.L(fallback);
+    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, HostLoc::RAX);
+    code.push(vaddr);
+    code.push(value);
+    code.pop(code.ABI_PARAM3);
+    code.pop(code.ABI_PARAM2);
+    code.mov(code.ABI_PARAM4, static_cast<u64>(op));
+    code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+    EmitCallAtomicMemoryOpFallback(code, bitsize);
+    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, HostLoc::RAX);
+    code.ret();
+    code.SwitchToNearCode();
+
+    ctx.reg_alloc.DefineValue(inst, result);
+}
+
+void A64EmitX64::EmitPageTableCompareAndSwap(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    Xbyak::Reg64 result = ctx.reg_alloc.ScratchGpr({HostLoc::RAX});
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Reg64 expected = ctx.reg_alloc.UseGpr(args[1]);
+    Xbyak::Reg64 desired = ctx.reg_alloc.UseGpr(args[2]);
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+
+    Xbyak::Label abort, end;
+
+    EmitAtomicAlignmentCheck(code, vaddr, bitsize, abort);
+    const auto memory = SizedPtr(code, bitsize, EmitVAddrLookup(code, ctx, abort, vaddr, tmp));
+    code.mov(result, expected);
+    code.lock();
+    code.cmpxchg(memory, SizedReg(desired, bitsize));
+    code.L(end);
+    EmitZeroExtendResult(code, result, bitsize);
+
+    Xbyak::Label fallback;
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(fallback);
+    code.jmp(end, code.T_NEAR);
+    code.L(fallback);
+    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, HostLoc::RAX);
+    code.push(vaddr);
+    code.push(expected);
+    code.push(desired);
+    code.pop(code.ABI_PARAM4);
+    code.pop(code.ABI_PARAM3);
+    code.pop(code.ABI_PARAM2);
+    code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+    EmitCallCompareAndSwapFallback(code, bitsize);
+    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, HostLoc::RAX);
+    code.ret();
+    code.SwitchToNearCode();
+
+    ctx.reg_alloc.DefineValue(inst, result);
+}
+
+void A64EmitX64::EmitPageTableCompareAndSwap128(A64EmitContext& ctx, IR::Inst* inst) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    // cmpxchg16b compares against rdx:rax and stores rcx:rbx.
+    ctx.reg_alloc.ScratchGpr({HostLoc::RAX});
+    ctx.reg_alloc.ScratchGpr({HostLoc::RDX});
+    ctx.reg_alloc.ScratchGpr({HostLoc::RBX});
+    ctx.reg_alloc.ScratchGpr({HostLoc::RCX});
+    Xbyak::Reg64 vaddr = ctx.reg_alloc.UseGpr(args[0]);
+    Xbyak::Xmm expected = ctx.reg_alloc.UseXmm(args[1]);
+    Xbyak::Xmm desired = ctx.reg_alloc.UseXmm(args[2]);
+    Xbyak::Xmm result = ctx.reg_alloc.ScratchXmm();
+    Xbyak::Reg64 tmp = ctx.reg_alloc.ScratchGpr();
+
+    Xbyak::Label abort, end;
+
+    EmitAtomicAlignmentCheck(code, vaddr, 128, abort);
+    const auto dest_ptr = EmitVAddrLookup(code, ctx, abort, vaddr, tmp);
+    if (code.DoesCpuSupport(Xbyak::util::Cpu::tSSE41)) {
+        code.movq(rax, expected);
+        code.pextrq(rdx, expected, 1);
+        code.movq(rbx, desired);
+        code.pextrq(rcx, desired, 1);
+        code.lock();
+        code.cmpxchg16b(xword[dest_ptr]);
+        code.movq(result, rax);
+        code.pinsrq(result, rdx, 1);
+    } else {
+        Xbyak::Xmm xmm_tmp = ctx.reg_alloc.ScratchXmm();
+        code.movq(rax, expected);
+        code.movdqa(xmm_tmp, expected);
+        code.punpckhqdq(xmm_tmp, xmm_tmp);
+        code.movq(rdx, xmm_tmp);
+        code.movq(rbx, desired);
+        code.movdqa(xmm_tmp, desired);
+        code.punpckhqdq(xmm_tmp, xmm_tmp);
+        code.movq(rcx, xmm_tmp);
+        code.lock();
+        code.cmpxchg16b(xword[dest_ptr]);
+        code.movq(result, rax);
+        code.movq(xmm_tmp, rdx);
+        code.punpcklqdq(result, xmm_tmp);
+    }
+    code.L(end);
+
+    Xbyak::Label fallback;
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(fallback);
+    code.jmp(end, code.T_NEAR);
+    code.L(fallback);
+    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, HostLocXmmIdx(result.getIdx()));
+    code.sub(rsp, 32 + ABI_SHADOW_SPACE);
+    code.movaps(xword[rsp + ABI_SHADOW_SPACE], expected);
+    code.movaps(xword[rsp + ABI_SHADOW_SPACE + 16], desired);
+    code.mov(code.ABI_PARAM2, vaddr);
+    code.lea(code.ABI_PARAM3, ptr[rsp + ABI_SHADOW_SPACE]);
+    code.lea(code.ABI_PARAM4, ptr[rsp + ABI_SHADOW_SPACE + 16]);
+    code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+    code.CallFunction(&CallbackCompareAndSwap128);
+    code.movaps(result, xword[rsp + ABI_SHADOW_SPACE]);
+    code.add(rsp, 32 + ABI_SHADOW_SPACE);
+    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, HostLocXmmIdx(result.getIdx()));
+    code.ret();
+    code.SwitchToNearCode();
+
+    ctx.reg_alloc.DefineValue(inst, result);
+}
+
+void A64EmitX64::EmitAtomicMemoryOp(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    if (conf.page_table) {
+        EmitPageTableAtomicMemoryOp(ctx, inst, bitsize);
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    ctx.reg_alloc.HostCall(inst, {}, args[0], args[1], args[2]);
+    code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+    EmitCallAtomicMemoryOpFallback(code, bitsize);
+}
+
+void A64EmitX64::EmitCompareAndSwap(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize) {
+    if (conf.page_table) {
+        if (bitsize == 128) {
+            EmitPageTableCompareAndSwap128(ctx, inst);
+        } else {
+            EmitPageTableCompareAndSwap(ctx, inst, bitsize);
+        }
+        return;
+    }
+
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+
+    if (bitsize != 128) {
+        ctx.reg_alloc.HostCall(inst, {}, args[0], args[1], args[2]);
+        code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+        EmitCallCompareAndSwapFallback(code, bitsize);
+        return;
+    }
+
+    ctx.reg_alloc.Use(args[0], ABI_PARAM2);
+    ctx.reg_alloc.Use(args[1], HostLoc::XMM1);
+    ctx.reg_alloc.Use(args[2], HostLoc::XMM2);
+    ctx.reg_alloc.EndOfAllocScope();
+    ctx.reg_alloc.HostCall(nullptr);
+    code.sub(rsp, 32 + ABI_SHADOW_SPACE);
+    code.movaps(xword[rsp + ABI_SHADOW_SPACE], xmm1);
+    code.movaps(xword[rsp + ABI_SHADOW_SPACE + 16], xmm2);
+    code.lea(code.ABI_PARAM3, ptr[rsp + ABI_SHADOW_SPACE]);
+    code.lea(code.ABI_PARAM4, ptr[rsp + ABI_SHADOW_SPACE + 16]);
+    code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(&conf));
+    code.CallFunction(&CallbackCompareAndSwap128);
+    code.movaps(xmm1, xword[rsp + ABI_SHADOW_SPACE]);
+    code.add(rsp, 32 + ABI_SHADOW_SPACE);
+    ctx.reg_alloc.DefineValue(inst, xmm1);
+}
+
+void A64EmitX64::EmitA64AtomicMemoryOp8(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitAtomicMemoryOp(ctx, inst, 8);
+}
+
+void A64EmitX64::EmitA64AtomicMemoryOp16(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitAtomicMemoryOp(ctx, inst, 16);
+}
+
+void A64EmitX64::EmitA64AtomicMemoryOp32(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitAtomicMemoryOp(ctx, inst, 32);
+}
+
+void A64EmitX64::EmitA64AtomicMemoryOp64(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitAtomicMemoryOp(ctx, inst, 64);
+}
+
+void A64EmitX64::EmitA64CompareAndSwapMemory8(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitCompareAndSwap(ctx, inst, 8);
+}
+
+void A64EmitX64::EmitA64CompareAndSwapMemory16(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitCompareAndSwap(ctx, inst, 16);
+}
+
+void A64EmitX64::EmitA64CompareAndSwapMemory32(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitCompareAndSwap(ctx, inst, 32);
+}
+
+void A64EmitX64::EmitA64CompareAndSwapMemory64(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitCompareAndSwap(ctx, inst, 64);
+}
+
+void A64EmitX64::EmitA64CompareAndSwapMemory128(A64EmitContext& ctx, IR::Inst* inst) {
+    EmitCompareAndSwap(ctx, inst, 128);
+}
+
 void A64EmitX64::EmitTerminalImpl(IR::Term::Interpret terminal, IR::LocationDescriptor) {
     code.SwitchMxcsrOnExit();
     Devirtualize<&A64::UserCallbacks::InterpreterFallback>(conf.callbacks).EmitCall(code,
@@ -996,6 +2177,8 @@ void A64EmitX64::EmitTerminalImpl(IR::Term::ReturnToDispatch, IR::LocationDescri
 }
 
 void A64EmitX64::EmitTerminalImpl(IR::Term::LinkBlock terminal, IR::LocationDescriptor) {
+    Xbyak::Label halt;
+    code.JumpIfHaltRequested(halt);
     code.cmp(qword[r15 + offsetof(A64JitState, cycles_remaining)], 0);
 
     patch_information[terminal.next].jg.emplace_back(code.getCurr());
@@ -1004,6 +2187,7 @@ void A64EmitX64::EmitTerminalImpl(IR::Term::LinkBlock terminal, IR::LocationDesc
     } else {
         EmitPatchJg(terminal.next);
     }
+    code.L(halt);
     code.mov(rax, A64::LocationDescriptor{terminal.next}.PC());
     code.mov(qword[r15 + offsetof(A64JitState, pc)], rax);
     code.ForceReturnFromRunCode();
@@ -1019,23 +2203,19 @@ void A64EmitX64::EmitTerminalImpl(IR::Term::LinkBlockFast terminal, IR::Location
 }
 
 void A64EmitX64::EmitTerminalImpl(IR::Term::PopRSBHint, IR::LocationDescriptor) {
-    // This calculation has to match up with A64::LocationDescriptor::UniqueHash
-    // TODO: Optimization is available here based on known state of FPSCR_mode and CPSR_et.
-    code.mov(rcx, A64::LocationDescriptor::PC_MASK);
-    code.and_(rcx, qword[r15 + offsetof(A64JitState, pc)]);
-    code.mov(ebx, dword[r15 + offsetof(A64JitState, fpcr)]);
-    code.and_(ebx, A64::LocationDescriptor::FPCR_MASK);
-    code.shl(ebx, 37);
-    code.or_(rbx, rcx);
+    code.jmp(terminal_handler_pop_rsb_hint);
+}
 
-    code.mov(eax, dword[r15 + offsetof(A64JitState, rsb_ptr)]);
-    code.sub(eax, 1);
-    code.and_(eax, u32(A64JitState::RSBPtrMask));
-    code.mov(dword[r15 + offsetof(A64JitState, rsb_ptr)], eax);
-    code.cmp(rbx, qword[r15 + offsetof(A64JitState, rsb_location_descriptors) + rax * sizeof(u64)]);
-    code.jne(code.GetReturnFromRunCodeAddress());
-    code.mov(rax, qword[r15 + offsetof(A64JitState, rsb_codeptrs) + rax * sizeof(u64)]);
-    code.jmp(rax);
+void A64EmitX64::EmitTerminalImpl(IR::Term::FastDispatchHint, IR::LocationDescriptor initial_location) {
+    EmitLocationDescriptorCalculation();
+    code.JumpIfHaltRequested(code.GetForceReturnFromRunCodeAddress());
+    code.cmp(qword[r15 + offsetof(A64JitState, cycles_remaining)], 0);
+    code.jng(code.GetForceReturnFromRunCodeAddress());
+    if (conf.enable_fast_dispatch) {
+        EmitInlineCache(terminal_handler_fast_dispatch_hint, initial_location);
+    } else {
+        EmitInlineCache(code.GetReturnFromRunCodeAddress(), initial_location);
+    }
 }
 
 void A64EmitX64::EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor initial_location) {
@@ -1045,7 +2225,7 @@ void A64EmitX64::EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor
         EmitTerminal(terminal.then_, initial_location);
         break;
     default:
-        Xbyak::Label pass = EmitCond(terminal.if_);
+        Xbyak::Label pass = EmitCond(terminal.if_, Xbyak::CodeGenerator::T_NEAR);
         EmitTerminal(terminal.else_, initial_location);
         code.L(pass);
         EmitTerminal(terminal.then_, initial_location);
@@ -1056,7 +2236,7 @@ void A64EmitX64::EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor
 void A64EmitX64::EmitTerminalImpl(IR::Term::CheckBit terminal, IR::LocationDescriptor initial_location) {
     Xbyak::Label fail;
     code.cmp(code.byte[r15 + offsetof(A64JitState, check_bit)], u8(0));
-    code.jz(fail);
+    code.jz(fail, Xbyak::CodeGenerator::T_NEAR);
     EmitTerminal(terminal.then_, initial_location);
     code.L(fail);
     EmitTerminal(terminal.else_, initial_location);
@@ -6,9 +6,12 @@
 
 #pragma once
 
+#include <array>
 #include <map>
 #include <tuple>
 
+#include <boost/optional.hpp>
+
 #include "backend/x64/a64_jitstate.h"
 #include "backend/x64/block_range_information.h"
 #include "backend/x64/emit_x64.h"
@@ -43,14 +46,57 @@ public:
      */
     BlockDescriptor Emit(IR::Block& ir);
 
+    /**
+     * Emit host machine code for a re-optimised version of an already emitted block,
+     * replacing the existing code for that block.
+     * @note ir is modified.
+     */
+    BlockDescriptor EmitOptimized(IR::Block& ir);
+
     void ClearCache() override;
 
+    std::vector<IR::LocationDescriptor> AdvanceCodeSegment() override;
+
     void InvalidateCacheRanges(const boost::icl::interval_set<u64>& ranges);
 
+    /// Code which executes the instruction at the current PC through InterpreterFallback and returns to the dispatcher.
+    /// Only available if conf.compilation_mode is BackgroundInterpret.
+    CodePtr GetInterpretSingleInstruction() const {
+        return interpret_single_instruction;
+    }
+
 protected:
+    BlockDescriptor EmitBlock(IR::Block& ir, bool count_executions);
+
     const A64::UserConfig conf;
     BlockRangeInformation<u64> block_ranges;
 
+    struct FastDispatchEntry {
+        u64 location_descriptor;
+        CodePtr code_ptr;
+    };
+    static_assert(sizeof(FastDispatchEntry) == 0x10);
+    static constexpr size_t fast_dispatch_table_size = 0x10000;
+    static constexpr u64 fast_dispatch_table_mask = (fast_dispatch_table_size - 1) * sizeof(FastDispatchEntry);
+    alignas(64) std::array<FastDispatchEntry, fast_dispatch_table_size> fast_dispatch_table;
+    static size_t FastDispatchTableIndex(u64 location_descriptor);
+    void ClearFastDispatchTable();
+
+    // Self-loops
+    /// Keeps the most used guest GPRs of a self-looping block in host registers for the duration of the loop.
+    void PinLoopRegisters(const IR::Block& block, RegAlloc& reg_alloc);
+    void EmitBlockExit() override;
+    std::array<boost::optional<Xbyak::Reg64>, 31> pinned_registers;
+    std::array<bool, 31> pinned_register_written;
+
+    CodePtr interpret_single_instruction = nullptr;
+    void GenInterpretSingleInstruction();
+
+    void EmitLocationDescriptorCalculation();
+    const void* terminal_handler_pop_rsb_hint;
+    const void* terminal_handler_fast_dispatch_hint = nullptr;
+    void GenTerminalHandlers();
+
     void (*memory_read_128)();
     void (*memory_write_128)();
     void GenMemory128Accessors();
@@ -61,7 +107,27 @@ protected:
 
     void EmitDirectPageTableMemoryRead(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
     void EmitDirectPageTableMemoryWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+
+    /// True if conf.fastmem_pointer is set and faults in emitted code can be handled.
+    const bool fastmem_enabled;
+    void EmitFastmemRead(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitFastmemWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+
+    /// Indexed by the host register holding the address. Fills the software TLB entry for that address.
+    std::array<void(*)(), 16> tlb_fill_thunks{};
+    void GenTLBFillThunks();
+    void EmitTLBMemoryRead(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitTLBMemoryWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
     void EmitExclusiveWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    /// Exclusive accesses to page table memory with the global monitor, performed as host atomics.
+    void EmitPageTableSetExclusive(A64EmitContext& ctx, IR::Inst* inst);
+    void EmitPageTableExclusiveWrite(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    /// Atomic read-modify-writes, performed as host atomics on page table memory and through the memory callbacks otherwise.
+    void EmitAtomicMemoryOp(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitCompareAndSwap(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitPageTableAtomicMemoryOp(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitPageTableCompareAndSwap(A64EmitContext& ctx, IR::Inst* inst, size_t bitsize);
+    void EmitPageTableCompareAndSwap128(A64EmitContext& ctx, IR::Inst* inst);
 
     // Microinstruction emitters
 #define OPCODE(...)
@@ -78,6 +144,7 @@ protected:
     void EmitTerminalImpl(IR::Term::LinkBlock terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::LinkBlockFast terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::PopRSBHint terminal, IR::LocationDescriptor initial_location) override;
+    void EmitTerminalImpl(IR::Term::FastDispatchHint terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::CheckBit terminal, IR::LocationDescriptor initial_location) override;
     void EmitTerminalImpl(IR::Term::CheckHalt terminal, IR::LocationDescriptor initial_location) override;
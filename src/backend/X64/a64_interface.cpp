@@ -4,19 +4,32 @@
  * General Public License version 2 or any later version.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <memory>
+#include <new>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include <boost/icl/interval_set.hpp>
+#include <boost/optional.hpp>
 
 #include "backend/x64/a64_emit_x64.h"
 #include "backend/x64/a64_jitstate.h"
+#include "backend/x64/background_translator.h"
 #include "backend/x64/block_of_code.h"
 #include "backend/x64/devirtualize.h"
 #include "backend/x64/jitstate_info.h"
+#include "backend/x64/translation_cache.h"
+#include "backend/x64/write_watcher.h"
 #include "common/assert.h"
+#include "common/bit_util.h"
 #include "common/llvm_disassemble.h"
 #include "common/scope_exit.h"
+#include "common/variant_util.h"
 #include "dynarmic/A64/a64.h"
 #include "frontend/A64/translate/translate.h"
 #include "frontend/ir/basic_block.h"
@@ -26,22 +39,48 @@ namespace Dynarmic::A64 {
 
 using namespace BackendX64;
 
-static RunCodeCallbacks GenRunCodeCallbacks(A64::UserCallbacks* cb, CodePtr (*LookupBlock)(void* lookup_block_arg), void* arg) {
-    return RunCodeCallbacks{
+static RunCodeCallbacks GenRunCodeCallbacks(const A64::UserConfig& conf, CodePtr (*LookupBlock)(void* lookup_block_arg), CodePtr (*TierUpBlock)(void* tier_up_block_arg, u64 location_descriptor), void* arg) {
+    RunCodeCallbacks cb{
         std::make_unique<ArgCallback>(LookupBlock, reinterpret_cast<u64>(arg)),
-        std::make_unique<ArgCallback>(Devirtualize<&A64::UserCallbacks::AddTicks>(cb)),
-        std::make_unique<ArgCallback>(Devirtualize<&A64::UserCallbacks::GetTicksRemaining>(cb)),
+        nullptr,
+        nullptr,
+        std::make_unique<ArgCallback>(TierUpBlock, reinterpret_cast<u64>(arg)),
     };
+    if (conf.enable_ticks) {
+        cb.AddTicks = std::make_unique<ArgCallback>(Devirtualize<&A64::UserCallbacks::AddTicks>(conf.callbacks));
+        cb.GetTicksRemaining = std::make_unique<ArgCallback>(Devirtualize<&A64::UserCallbacks::GetTicksRemaining>(conf.callbacks));
+    }
+    return cb;
 }
 
 struct Jit::Impl final {
 public:
     explicit Impl(UserConfig conf)
         : conf(conf) 
-        , block_of_code(GenRunCodeCallbacks(conf.callbacks, &GetCurrentBlockThunk, this), JitStateInfo{jit_state})
+        , block_of_code(GenRunCodeCallbacks(conf, &GetCurrentBlockThunk, &TierUpBlockThunk, this), JitStateInfo{jit_state, conf.rsb_size}, CodeCacheConfig{conf.code_cache_near_size, conf.code_cache_far_size, conf.code_cache_constant_pool_size, conf.code_cache_lazy_commit}, conf.enable_statistics, conf.fastmem_pointer)
         , emitter(block_of_code, conf)
     {
         ASSERT(conf.page_table_address_space_bits >= 12 && conf.page_table_address_space_bits <= 64);
+        ASSERT(conf.page_table_levels >= 1 && conf.page_table_levels <= 4 && conf.page_table_levels <= conf.page_table_address_space_bits - 12);
+        ASSERT(conf.rsb_size >= 1 && conf.rsb_size <= A64JitState::RSBMaxSize && Common::BitCount(conf.rsb_size) == 1);
+
+        if (conf.translation_cache_path) {
+            translation_cache = std::make_unique<TranslationCache>(conf.translation_cache_path, std::initializer_list<u64>{
+                conf.enable_superblocks,
+                conf.superblock_max_instructions,
+                conf.enable_tiered_compilation,
+                conf.hook_data_cache_operations,
+                conf.dczid_el0,
+            });
+        }
+
+        if (conf.compilation_mode != UserConfig::CompilationMode::Synchronous) {
+            background_translator = std::make_unique<BackgroundTranslator>([this](IR::LocationDescriptor location) { return Translate(location); });
+        }
+
+        if (conf.protect_code_pages && WriteWatcher::IsSupported()) {
+            code_page_watcher = std::make_unique<WriteWatcher>([this](u64 host_page) { OnCodePageWritten(host_page); });
+        }
     }
 
     ~Impl() = default;
@@ -50,18 +89,34 @@ public:
         ASSERT(!is_executing);
         is_executing = true;
         SCOPE_EXIT { this->is_executing = false; };
-        jit_state.halt_requested = false;
+        // Requests are only discarded as Run returns, so one from another thread racing with the start
+        // of Run is not lost, and one made after this point applies to the next call.
+        SCOPE_EXIT { this->jit_state.halt_requested.store(false, std::memory_order_seq_cst); };
+        if (!conf.enable_ticks) {
+            // Without ticks cycles_remaining only indicates whether execution should continue.
+            // Sequentially consistent accesses order the store before the load, pairing with RequestHalt.
+            jit_state.cycles_remaining.store(1, std::memory_order_seq_cst);
+            if (jit_state.halt_requested.load(std::memory_order_seq_cst)) {
+                jit_state.cycles_remaining.store(0, std::memory_order_seq_cst);
+            }
+        }
+
+        // Writes to code pages made since the last Run.
+        ApplyCodePageWrites();
+        PerformRequestedCacheInvalidation();
 
         // TODO: Check code alignment
 
-        const u32 new_rsb_ptr = (jit_state.rsb_ptr - 1) & A64JitState::RSBPtrMask;
-        if (jit_state.GetUniqueHash() == jit_state.rsb_location_descriptors[new_rsb_ptr]) {
+        const u32 new_rsb_ptr = (jit_state.rsb_ptr - sizeof(A64JitState::RSBEntry)) & block_of_code.GetJitStateInfo().rsb_ptr_mask;
+        const auto& rsb_entry = jit_state.rsb[new_rsb_ptr / sizeof(A64JitState::RSBEntry)];
+        if (jit_state.GetUniqueHash() == rsb_entry.location_descriptor) {
             jit_state.rsb_ptr = new_rsb_ptr;
-            block_of_code.RunCodeFrom(&jit_state, reinterpret_cast<CodePtr>(jit_state.rsb_codeptrs[new_rsb_ptr]));
+            block_of_code.RunCodeFrom(&jit_state, reinterpret_cast<CodePtr>(rsb_entry.code_ptr));
         } else {
             block_of_code.RunCode(&jit_state);
         }
 
+        ApplyCodePageWrites();
         PerformRequestedCacheInvalidation();
     }
 
@@ -77,13 +132,26 @@ public:
         RequestCacheInvalidation();
     }
 
+    void InvalidateTLB() {
+        jit_state.ResetTLB();
+    }
+
+    void WaitForBackgroundTranslation() {
+        ASSERT(!is_executing);
+        if (background_translator) {
+            background_translator->WaitUntilIdle();
+        }
+    }
+
     void Reset() {
         ASSERT(!is_executing);
-        jit_state = {};
+        // A64JitState holds atomics and so is not assignable.
+        jit_state.~A64JitState();
+        new (&jit_state) A64JitState{};
     }
 
     void HaltExecution() {
-        jit_state.halt_requested = true;
+        RequestHalt();
     }
 
     u64 GetSP() const {
@@ -171,6 +239,30 @@ public:
         jit_state.exclusive_state = 0;
     }
 
+    u64 GetRSBHitCount() const {
+        return jit_state.rsb_hits;
+    }
+
+    u64 GetRSBMissCount() const {
+        return jit_state.rsb_misses;
+    }
+
+    u64 GetFastDispatchHitCount() const {
+        return jit_state.fast_dispatch_hits;
+    }
+
+    u64 GetFastDispatchMissCount() const {
+        return jit_state.fast_dispatch_misses;
+    }
+
+    u64 GetMXCSRAccessCount() const {
+        return jit_state.mxcsr_accesses;
+    }
+
+    u64 GetTierUpCount() const {
+        return jit_state.tier_ups;
+    }
+
     bool IsExecuting() const {
         return is_executing;
     }
@@ -186,32 +278,350 @@ private:
     }
 
     CodePtr GetCurrentBlock() {
-        IR::LocationDescriptor current_location{jit_state.GetUniqueHash()};
+        const IR::LocationDescriptor current_location{jit_state.GetUniqueHash()};
+
+        while (true) {
+            // Code pages written to are invalidated here, before execution resumes, as well as when Run returns.
+            if (ApplyCodePageWrites()) {
+                PerformRequestedCacheInvalidation();
+            }
+
+            const CodePtr code = GetOrEmitBlock(current_location);
+
+            // Code pages are protected before they are read for translation, so a write made while code was being
+            // translated has been recorded by now. The code may be stale, and is invalidated before it is entered.
+            if (!code_pages_written.load()) {
+                return code;
+            }
+        }
+    }
+
+    CodePtr GetOrEmitBlock(IR::LocationDescriptor current_location) {
+        if (background_translator) {
+            EmitBackgroundTranslations();
+        }
 
         if (auto block = emitter.GetBasicBlock(current_location))
             return block->entrypoint;
 
-        constexpr size_t MINIMUM_REMAINING_CODESIZE = 1 * 1024 * 1024;
-        if (block_of_code.SpaceRemaining() < MINIMUM_REMAINING_CODESIZE) {
-            // Immediately evacuate cache
-            invalidate_entire_cache = true;
-            PerformRequestedCacheInvalidation();
+        if (conf.compilation_mode == UserConfig::CompilationMode::BackgroundInterpret) {
+            // Only one location is waited for at a time, so that each instruction
+            // interpreted in the meantime does not start a translation of its own.
+            if (!awaited_location) {
+                awaited_location = current_location;
+                background_translator->Request(current_location, true);
+            }
+            return emitter.GetInterpretSingleInstruction();
         }
 
         // JIT Compile
-        IR::Block ir_block = A64::Translate(A64::LocationDescriptor{current_location}, [this](u64 vaddr) { return conf.callbacks->MemoryReadCode(vaddr); });
-        Optimization::A64CallbackConfigPass(ir_block, conf);
-        Optimization::A64GetSetElimination(ir_block);
-        Optimization::DeadCodeElimination(ir_block);
+        prefetch_depths.erase(current_location);
+        IR::Block ir_block = background_translator ? background_translator->Translate(current_location) : Translate(current_location);
+        return EmitBlock(ir_block, PrefetchDepth());
+    }
+
+    /// Number of levels of successors prefetched after a block the guest is about to execute is emitted.
+    size_t PrefetchDepth() const {
+        // When translating in the background, successors are always worth queuing as translation is off-thread.
+        return background_translator ? std::max<size_t>(conf.prefetch_depth, 1) : conf.prefetch_depth;
+    }
+
+    /**
+     * Emits a newly translated block, making space for it in the code cache if necessary.
+     * Then prefetches the blocks statically known to follow it, up to prefetch_depth levels ahead.
+     */
+    CodePtr EmitBlock(IR::Block& ir_block, size_t prefetch_depth) {
+        if (!block_of_code.EnsureBlockSpace()) {
+            // Evict the oldest segment of the cache
+            jit_state.ResetRSB();
+            emitter.AdvanceCodeSegment();
+        }
+
+        std::vector<IR::LocationDescriptor> successors;
+        if (prefetch_depth > 0) {
+            GetSuccessors(ir_block, successors);
+        }
+
+        const CodePtr entrypoint = emitter.Emit(ir_block).entrypoint;
+        Prefetch(std::move(successors), prefetch_depth);
+        return entrypoint;
+    }
+
+    /**
+     * Translates and emits the blocks at locations and their successors, up to depth levels in total.
+     * Emitting a block patches the links to it from blocks that have already been emitted.
+     * When translating in the background, translation is instead queued on the worker.
+     */
+    void Prefetch(std::vector<IR::LocationDescriptor> locations, size_t depth) {
+        for (size_t level = 0; level < depth && !locations.empty(); level++) {
+            std::vector<IR::LocationDescriptor> next_level;
+
+            for (const IR::LocationDescriptor location : locations) {
+                if (emitter.GetBasicBlock(location)) {
+                    continue;
+                }
+
+                if (background_translator) {
+                    prefetch_depths[location] = depth - level - 1;
+                    background_translator->Request(location);
+                    continue;
+                }
+
+                // Prefetching must not evict code: the block that triggered it is about to be executed.
+                if (!block_of_code.EnsureBlockSpace()) {
+                    return;
+                }
+
+                IR::Block ir_block = Translate(location);
+                GetSuccessors(ir_block, next_level);
+                emitter.Emit(ir_block);
+            }
+
+            locations = std::move(next_level);
+        }
+    }
+
+    void EmitBackgroundTranslations() {
+        for (IR::Block& ir_block : background_translator->TakeFinished()) {
+            const IR::LocationDescriptor location = ir_block.Location();
+
+            size_t prefetch_depth = PrefetchDepth();
+            if (const auto iter = prefetch_depths.find(location); iter != prefetch_depths.end()) {
+                prefetch_depth = iter->second;
+                prefetch_depths.erase(iter);
+            }
+
+            if (awaited_location == location) {
+                awaited_location = boost::none;
+            }
+            if (!emitter.GetBasicBlock(location)) {
+                EmitBlock(ir_block, prefetch_depth);
+            }
+        }
+    }
+
+    /// Appends the locations statically known to follow ir_block: its side exits and the targets of its links.
+    static void GetSuccessors(const IR::Block& ir_block, std::vector<IR::LocationDescriptor>& successors) {
+        for (const auto& side_exit : ir_block.SideExits()) {
+            successors.push_back(side_exit.target);
+        }
+        GetSuccessors(ir_block.GetTerminal(), successors);
+    }
+
+    static void GetSuccessors(const IR::Terminal& terminal, std::vector<IR::LocationDescriptor>& successors) {
+        Common::VisitVariant<void>(terminal, [&successors](const auto& t) {
+            using T = std::decay_t<decltype(t)>;
+            if constexpr (std::is_same_v<T, IR::Term::LinkBlock> || std::is_same_v<T, IR::Term::LinkBlockFast>) {
+                successors.push_back(t.next);
+            } else if constexpr (std::is_same_v<T, IR::Term::If> || std::is_same_v<T, IR::Term::CheckBit>) {
+                GetSuccessors(t.then_, successors);
+                GetSuccessors(t.else_, successors);
+            } else if constexpr (std::is_same_v<T, IR::Term::CheckHalt>) {
+                GetSuccessors(t.else_, successors);
+            }
+        });
+    }
+
+    static CodePtr TierUpBlockThunk(void* thisptr, u64 location_descriptor) {
+        Jit::Impl* this_ = static_cast<Jit::Impl*>(thisptr);
+        return this_->TierUpBlock(IR::LocationDescriptor{location_descriptor});
+    }
+
+    CodePtr TierUpBlock(IR::LocationDescriptor location) {
+        const auto block = emitter.GetBasicBlock(location);
+        ASSERT(block);
+
+        // We are executing code from the cache, so no segment can be evicted here.
+        // The block remains at tier 0, and its rearmed counter requests recompilation again later.
+        if (!block_of_code.EnsureBlockSpace()) {
+            return block->entrypoint;
+        }
+
+        IR::Block ir_block = TranslateOptimized(location, true);
+        const CodePtr entrypoint = emitter.EmitOptimized(ir_block).entrypoint;
+        if (conf.enable_statistics) {
+            jit_state.tier_ups++;
+        }
+        return entrypoint;
+    }
+
+    IR::Block Translate(IR::LocationDescriptor location) {
+        return conf.enable_tiered_compilation ? TranslateTier0(location) : TranslateOptimized(location, conf.enable_superblocks);
+    }
+
+    /// Fast translation for code that has not yet been found to be hot.
+    IR::Block TranslateTier0(IR::LocationDescriptor location) {
+        IR::Block ir_block = TranslateCached(location, 0, {}, [this](IR::Block& ir_block) {
+            Optimization::A64CallbackConfigPass(ir_block, conf);
+            Optimization::DeadCodeElimination(ir_block);
+        });
+        Optimization::A64MergeInterpretBlocksPass(ir_block, conf.callbacks);
+        Optimization::VerificationPass(ir_block);
+        return ir_block;
+    }
+
+    IR::Block TranslateOptimized(IR::LocationDescriptor location, bool enable_superblocks) {
+        const A64::TranslationOptions options{enable_superblocks, conf.superblock_max_instructions};
+        IR::Block ir_block = TranslateCached(location, enable_superblocks ? 2 : 1, options, [this](IR::Block& ir_block) {
+            Optimization::A64CallbackConfigPass(ir_block, conf);
+            Optimization::A64GetSetElimination(ir_block);
+            Optimization::DeadCodeElimination(ir_block);
+            if (conf.enable_tiered_compilation) {
+                Optimization::CommonSubexpressionElimination(ir_block);
+                Optimization::DeadCodeElimination(ir_block);
+            }
+        });
+        // Merging reads guest code beyond the block, so it is not covered by the translation cache.
         Optimization::A64MergeInterpretBlocksPass(ir_block, conf.callbacks);
         // printf("%s\n", IR::DumpBlock(ir_block).c_str());
         Optimization::VerificationPass(ir_block);
-        return emitter.Emit(ir_block).entrypoint;
+        return ir_block;
+    }
+
+    /// Translates and optimises a block, reusing the result from the translation cache if possible.
+    /// variant distinguishes translations of the same location that differ in options or optimisation.
+    template <typename OptimizeFn>
+    IR::Block TranslateCached(IR::LocationDescriptor location, u8 variant, A64::TranslationOptions options, OptimizeFn optimize) {
+        u64 protected_page = ~u64(0);
+        const auto read_code = [this, &protected_page](u64 vaddr) {
+            // The page is protected before it is read, so that no write made after the read goes undetected.
+            if (code_page_watcher && (vaddr & ~u64(0xFFF)) != protected_page) {
+                protected_page = vaddr & ~u64(0xFFF);
+                ProtectCodePage(protected_page);
+            }
+            return conf.callbacks->MemoryReadCode(vaddr);
+        };
+
+        if (!translation_cache) {
+            IR::Block ir_block = A64::Translate(A64::LocationDescriptor{location}, read_code, options);
+            optimize(ir_block);
+            return ir_block;
+        }
+
+        if (auto cached = translation_cache->Load(location, variant, read_code)) {
+            return std::move(*cached);
+        }
+
+        TranslationCache::CodeReads code_reads;
+        IR::Block ir_block = A64::Translate(A64::LocationDescriptor{location}, [&](u64 vaddr) {
+            const u32 instruction = read_code(vaddr);
+            code_reads.emplace_back(vaddr, instruction);
+            return instruction;
+        }, options);
+        optimize(ir_block);
+        translation_cache->Store(ir_block, variant, code_reads);
+        return ir_block;
+    }
+
+    /// Returns the host memory backing the guest page containing vaddr, if it is accessed through fastmem or page_table.
+    u8* GetHostPage(u64 vaddr) const {
+        vaddr &= ~u64(0xFFF);
+
+        if (conf.fastmem_pointer && block_of_code.SupportsFastmem()) {
+            if (conf.fastmem_address_space_bits < 64 && (vaddr >> conf.fastmem_address_space_bits) != 0) {
+                return nullptr;
+            }
+            return static_cast<u8*>(conf.fastmem_pointer) + vaddr;
+        }
+
+        if (!conf.page_table) {
+            return nullptr;
+        }
+
+        const size_t page_index_bits = conf.page_table_address_space_bits - 12;
+        u64 page_index = vaddr >> 12;
+        if (page_index_bits < 52) {
+            if (!conf.silently_mirror_page_table && (page_index >> page_index_bits) != 0) {
+                return nullptr;
+            }
+            page_index &= (u64(1) << page_index_bits) - 1;
+        }
+
+        // Mirrors EmitMultiLevelVAddrLookup: the first level takes the bits left over by the others.
+        const size_t levels = conf.page_table_levels;
+        const size_t level_bits = page_index_bits / levels;
+        void* const* table = conf.page_table;
+        for (size_t level = 0; level < levels; level++) {
+            const size_t shift = level_bits * (levels - 1 - level);
+            u64 index = page_index >> shift;
+            if (level != 0) {
+                index &= (u64(1) << level_bits) - 1;
+            }
+            if (!table[index]) {
+                return nullptr;
+            }
+            if (level == levels - 1) {
+                return static_cast<u8*>(table[index]);
+            }
+            table = static_cast<void* const*>(table[index]);
+        }
+        UNREACHABLE();
+    }
+
+    /// Write-protects the host pages backing guest_page, which code is about to be translated from.
+    /// Called from the background translator when translating in the background.
+    void ProtectCodePage(u64 guest_page) {
+        u8* const host = GetHostPage(guest_page);
+        if (!host) {
+            return;
+        }
+
+        // The guest page may straddle two host pages if it is not host page aligned.
+        const u64 host_page_size = WriteWatcher::PageSize();
+        const u64 host_begin = reinterpret_cast<u64>(host) & ~(host_page_size - 1);
+        const u64 host_end = reinterpret_cast<u64>(host) + 0x1000;
+        std::lock_guard lock{code_pages_mutex};
+        for (u64 host_page = host_begin; host_page < host_end; host_page += host_page_size) {
+            auto& guest_pages = code_pages[host_page];
+            if (std::find(guest_pages.begin(), guest_pages.end(), guest_page) == guest_pages.end()) {
+                guest_pages.push_back(guest_page);
+            }
+            code_page_watcher->Watch(host_page);
+        }
+    }
+
+    /// Called from the fault handler, on any thread, when a write-protected code page is written to.
+    /// Only atomics are updated, as the handler may have interrupted a thread holding any lock.
+    void OnCodePageWritten(u64) {
+        code_pages_written.store(true);
+        RequestHalt();
+    }
+
+    /// Queues invalidation of the guest code backed by code pages that have been written to.
+    /// Returns true if any have been written to since the last call.
+    bool ApplyCodePageWrites() {
+        if (!code_page_watcher || !code_pages_written.exchange(false)) {
+            return false;
+        }
+
+        const std::vector<u64> written = code_page_watcher->TakeWrittenPages();
+        std::lock_guard lock{code_pages_mutex};
+        for (const u64 host_page : written) {
+            const auto iter = code_pages.find(host_page);
+            if (iter == code_pages.end()) {
+                continue;
+            }
+            for (const u64 guest_page : iter->second) {
+                invalid_cache_ranges.add(boost::icl::discrete_interval<u64>::closed(guest_page, guest_page + 0xFFF));
+            }
+            code_pages.erase(iter);
+        }
+        return true;
+    }
+
+    /// Makes emitted code return to the dispatcher at its next halt check. May be called from any thread.
+    void RequestHalt() {
+        // Emitted code polls these from the thread executing Run. Without ticks, if Run has just set
+        // cycles_remaining and missed halt_requested, these stores are ordered after its store.
+        jit_state.halt_requested.store(true, std::memory_order_seq_cst);
+        if (!conf.enable_ticks) {
+            jit_state.cycles_remaining.store(0, std::memory_order_seq_cst);
+        }
     }
 
     void RequestCacheInvalidation() {
         if (is_executing) {
-            jit_state.halt_requested = true;
+            RequestHalt();
             return;
         }
 
@@ -224,9 +634,19 @@ private:
         }
 
         jit_state.ResetRSB();
+        if (background_translator) {
+            background_translator->Clear();
+            awaited_location = boost::none;
+            prefetch_depths.clear();
+        }
         if (invalidate_entire_cache) {
             block_of_code.ClearCache();
             emitter.ClearCache();
+            if (code_page_watcher) {
+                std::lock_guard lock{code_pages_mutex};
+                code_page_watcher->UnwatchAll();
+                code_pages.clear();
+            }
         } else {
             emitter.InvalidateCacheRanges(invalid_cache_ranges);
         }
@@ -234,15 +654,30 @@ private:
         invalidate_entire_cache = false;
     }
 
-    bool is_executing = false;
+    /// Read by RequestCacheInvalidation, which may be called from other threads.
+    std::atomic<bool> is_executing{false};
 
     UserConfig conf;
     A64JitState jit_state;
     BlockOfCode block_of_code;
     A64EmitX64 emitter;
+    std::unique_ptr<TranslationCache> translation_cache;
+    std::unique_ptr<BackgroundTranslator> background_translator;
+    /// Location whose translation is awaited while instructions are interpreted.
+    boost::optional<IR::LocationDescriptor> awaited_location;
+    /// Remaining prefetch depth of blocks queued for translation by Prefetch.
+    std::unordered_map<IR::LocationDescriptor, size_t> prefetch_depths;
 
     bool invalidate_entire_cache = false;
     boost::icl::interval_set<u64> invalid_cache_ranges;
+
+    /// Maps each host page write-protected by code_page_watcher to the guest code pages it backs.
+    std::unordered_map<u64, std::vector<u64>> code_pages;
+    /// Serialises access to code_pages, which the background translator adds to.
+    std::mutex code_pages_mutex;
+    /// Set by the fault handler when a code page is written to, until the write is applied by ApplyCodePageWrites.
+    std::atomic<bool> code_pages_written{false};
+    std::unique_ptr<WriteWatcher> code_page_watcher;
 };
 
 Jit::Jit(UserConfig conf)
@@ -262,6 +697,14 @@ void Jit::InvalidateCacheRange(u64 start_address, size_t length) {
     impl->InvalidateCacheRange(start_address, length);
 }
 
+void Jit::InvalidateTLB() {
+    impl->InvalidateTLB();
+}
+
+void Jit::WaitForBackgroundTranslation() {
+    impl->WaitForBackgroundTranslation();
+}
+
 void Jit::Reset() {
     impl->Reset();
 }
@@ -346,6 +789,30 @@ void Jit::ClearExclusiveState() {
     impl->ClearExclusiveState();
 }
 
+std::uint64_t Jit::GetRSBHitCount() const {
+    return impl->GetRSBHitCount();
+}
+
+std::uint64_t Jit::GetRSBMissCount() const {
+    return impl->GetRSBMissCount();
+}
+
+std::uint64_t Jit::GetFastDispatchHitCount() const {
+    return impl->GetFastDispatchHitCount();
+}
+
+std::uint64_t Jit::GetFastDispatchMissCount() const {
+    return impl->GetFastDispatchMissCount();
+}
+
+std::uint64_t Jit::GetMXCSRAccessCount() const {
+    return impl->GetMXCSRAccessCount();
+}
+
+std::uint64_t Jit::GetTierUpCount() const {
+    return impl->GetTierUpCount();
+}
+
 bool Jit::IsExecuting() const {
     return impl->IsExecuting();
 }
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <array>
+#include <atomic>
 
 #include <xbyak.h>
 
@@ -24,7 +25,7 @@ class BlockOfCode;
 struct A64JitState {
     using ProgramCounterType = u64;
 
-    A64JitState() { ResetRSB(); }
+    A64JitState() { ResetRSB(); ResetTLB(); }
 
     std::array<u64, 31> reg{};
     u64 sp = 0;
@@ -51,24 +52,49 @@ struct A64JitState {
     // For internal use (See: BlockOfCode::RunCode)
     u32 guest_MXCSR = 0x00001f80;
     u32 save_host_MXCSR = 0;
+    bool guest_MXCSR_live = false; // Switched to lazily, see BlockOfCode::SwitchMxcsrOnEntry.
     s64 cycles_to_run = 0;
-    s64 cycles_remaining = 0;
-    bool halt_requested = false;
+    // Written by other threads to halt execution, see Jit::Impl::RequestHalt.
+    // Emitted code reads these directly, so both must be lock-free with the representation of the plain type.
+    std::atomic<s64> cycles_remaining = 0; // Without ticks: positive until a halt is requested.
+    std::atomic<bool> halt_requested = false;
     bool check_bit = false;
 
     // Exclusive state
     static constexpr u64 RESERVATION_GRANULE_MASK = 0xFFFF'FFFF'FFFF'FFF0ull;
     u8 exclusive_state = 0;
     u64 exclusive_address = 0;
-
-    static constexpr size_t RSBSize = 8; // MUST be a power of 2.
-    static constexpr size_t RSBPtrMask = RSBSize - 1;
+    /// Value read when the reservation was made, for exclusive accesses performed as host atomics.
+    u64 exclusive_value = 0;
+
+    // The size of the RSB in use is configured by UserConfig::rsb_size.
+    // rsb_ptr is a byte offset into rsb.
+    static constexpr size_t RSBMaxSize = 64; // MUST be a power of 2.
+    struct RSBEntry {
+        u64 location_descriptor;
+        u64 code_ptr;
+    };
     u32 rsb_ptr = 0;
-    std::array<u64, RSBSize> rsb_location_descriptors;
-    std::array<u64, RSBSize> rsb_codeptrs;
+    std::array<RSBEntry, RSBMaxSize> rsb;
+    u64 rsb_hits = 0;
+    u64 rsb_misses = 0;
+    u64 fast_dispatch_hits = 0;
+    u64 fast_dispatch_misses = 0;
+    u64 mxcsr_accesses = 0; // stmxcsr and ldmxcsr instructions executed
+    u64 tier_ups = 0;       // blocks recompiled by tiered compilation
     void ResetRSB() {
-        rsb_location_descriptors.fill(0xFFFFFFFFFFFFFFFFull);
-        rsb_codeptrs.fill(0);
+        rsb.fill(RSBEntry{0xFFFFFFFFFFFFFFFFull, 0});
+    }
+
+    // Software TLB (See: UserConfig::enable_tlb). Direct-mapped, indexed by the bottom bits of the guest page number.
+    static constexpr size_t TLB_PAGE_BITS = 12;
+    static constexpr size_t TLB_SIZE = 256; // MUST be a power of 2.
+    /// Set in the tag of an entry for a guest page without host memory, which is accessed through the memory callbacks.
+    static constexpr u64 TLB_TAG_NO_HOST_MEMORY = u64(1) << 63;
+    std::array<u64, TLB_SIZE> tlb_tags;    // Guest page number of each entry, all ones if empty.
+    std::array<u64, TLB_SIZE> tlb_offsets; // Host page address minus guest page address.
+    void ResetTLB() {
+        tlb_tags.fill(0xFFFFFFFFFFFFFFFFull);
     }
 
     u32 fpsr_exc = 0;
@@ -88,6 +114,9 @@ struct A64JitState {
 #pragma warning(pop)
 #endif
 
+static_assert(std::atomic<s64>::is_always_lock_free && sizeof(std::atomic<s64>) == sizeof(s64));
+static_assert(std::atomic<bool>::is_always_lock_free && sizeof(std::atomic<bool>) == sizeof(bool));
+
 using CodePtr = const void*;
 
 } // namespace Dynarmic::BackendX64
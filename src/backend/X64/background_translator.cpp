@@ -0,0 +1,118 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include <algorithm>
+#include <utility>
+
+#include "backend/x64/background_translator.h"
+
+namespace Dynarmic::BackendX64 {
+
+BackgroundTranslator::BackgroundTranslator(TranslateFn translate)
+    : translate(std::move(translate))
+    , worker([this] { WorkerLoop(); })
+{}
+
+BackgroundTranslator::~BackgroundTranslator() {
+    {
+        std::lock_guard lock{mutex};
+        stop = true;
+    }
+    work_available.notify_one();
+    worker.join();
+}
+
+void BackgroundTranslator::Request(IR::LocationDescriptor location, bool prioritise) {
+    {
+        std::lock_guard lock{mutex};
+        if (in_progress == location || finished.count(location)) {
+            return;
+        }
+        if (!queued.insert(location).second) {
+            if (!prioritise) {
+                return;
+            }
+            queue.erase(std::find(queue.begin(), queue.end(), location));
+        }
+        if (prioritise) {
+            queue.push_front(location);
+        } else {
+            queue.push_back(location);
+        }
+    }
+    work_available.notify_one();
+}
+
+std::vector<IR::Block> BackgroundTranslator::TakeFinished() {
+    std::vector<IR::Block> result;
+
+    std::lock_guard lock{mutex};
+    result.reserve(finished.size());
+    for (auto& [location, block] : finished) {
+        result.emplace_back(std::move(block));
+    }
+    finished.clear();
+    return result;
+}
+
+IR::Block BackgroundTranslator::Translate(IR::LocationDescriptor location) {
+    std::unique_lock lock{mutex};
+    work_finished.wait(lock, [&] { return in_progress != location; });
+
+    if (const auto iter = finished.find(location); iter != finished.end()) {
+        IR::Block block = std::move(iter->second);
+        finished.erase(iter);
+        return block;
+    }
+
+    if (queued.erase(location)) {
+        queue.erase(std::find(queue.begin(), queue.end(), location));
+    }
+
+    lock.unlock();
+    return translate(location);
+}
+
+void BackgroundTranslator::WaitUntilIdle() {
+    std::unique_lock lock{mutex};
+    work_finished.wait(lock, [this] { return queue.empty() && !in_progress; });
+}
+
+void BackgroundTranslator::Clear() {
+    std::lock_guard lock{mutex};
+    queue.clear();
+    queued.clear();
+    finished.clear();
+    generation++;
+}
+
+void BackgroundTranslator::WorkerLoop() {
+    std::unique_lock lock{mutex};
+    while (true) {
+        work_available.wait(lock, [this] { return stop || !queue.empty(); });
+        if (stop) {
+            return;
+        }
+
+        const IR::LocationDescriptor location = queue.front();
+        queue.pop_front();
+        queued.erase(location);
+        in_progress = location;
+        const size_t started_generation = generation;
+
+        lock.unlock();
+        IR::Block block = translate(location);
+        lock.lock();
+
+        if (generation == started_generation) {
+            finished.emplace(location, std::move(block));
+        }
+        in_progress = boost::none;
+        work_finished.notify_all();
+    }
+}
+
+} // namespace Dynarmic::BackendX64
@@ -0,0 +1,80 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "frontend/ir/basic_block.h"
+#include "frontend/ir/location_descriptor.h"
+
+namespace Dynarmic::BackendX64 {
+
+/**
+ * Translates and optimises blocks on a worker thread.
+ * Only translation happens on the worker; the resulting blocks are handed back to be emitted by the owner.
+ * The translate function must be safe to call from the worker thread and the owner's thread concurrently.
+ */
+class BackgroundTranslator final {
+public:
+    using TranslateFn = std::function<IR::Block(IR::LocationDescriptor location)>;
+
+    explicit BackgroundTranslator(TranslateFn translate);
+    ~BackgroundTranslator();
+
+    BackgroundTranslator(const BackgroundTranslator&) = delete;
+    BackgroundTranslator& operator=(const BackgroundTranslator&) = delete;
+
+    /**
+     * Queues location for translation unless it is already being translated or has been translated.
+     * @param prioritise If true, location is moved to the front of the queue.
+     */
+    void Request(IR::LocationDescriptor location, bool prioritise = false);
+
+    /// Removes and returns all blocks whose translation has finished.
+    std::vector<IR::Block> TakeFinished();
+
+    /**
+     * Returns the translation of location, removing it from the translator.
+     * Waits for the worker if it is currently translating location, otherwise translates on the calling thread.
+     */
+    IR::Block Translate(IR::LocationDescriptor location);
+
+    /// Waits until the queue is empty and no translation is in progress.
+    void WaitUntilIdle();
+
+    /// Discards all queued and finished translations. Translations in progress are discarded when they finish.
+    void Clear();
+
+private:
+    void WorkerLoop();
+
+    TranslateFn translate;
+
+    mutable std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_finished;
+    std::deque<IR::LocationDescriptor> queue;
+    std::unordered_set<IR::LocationDescriptor> queued;
+    boost::optional<IR::LocationDescriptor> in_progress;
+    std::unordered_map<IR::LocationDescriptor, IR::Block> finished;
+    /// Incremented by Clear so that translations started before it are discarded.
+    size_t generation = 0;
+    bool stop = false;
+
+    std::thread worker;
+};
+
+} // namespace Dynarmic::BackendX64
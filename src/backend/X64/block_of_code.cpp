@@ -4,10 +4,17 @@
  * General Public License version 2 or any later version.
  */
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <limits>
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
 #include <xbyak.h>
 
 #include "backend/x64/a32_jitstate.h"
@@ -36,30 +43,119 @@ const Xbyak::Reg64 BlockOfCode::ABI_PARAM6 = Xbyak::util::r9;
 const std::array<Xbyak::Reg64, 6> BlockOfCode::ABI_PARAMS = {BlockOfCode::ABI_PARAM1, BlockOfCode::ABI_PARAM2, BlockOfCode::ABI_PARAM3, BlockOfCode::ABI_PARAM4, BlockOfCode::ABI_PARAM5, BlockOfCode::ABI_PARAM6};
 #endif
 
-constexpr size_t TOTAL_CODE_SIZE = 128 * 1024 * 1024;
-constexpr size_t FAR_CODE_OFFSET = 100 * 1024 * 1024;
-constexpr size_t CONSTANT_POOL_SIZE = 2 * 1024 * 1024;
+const Xbyak::Reg64 BlockOfCode::FASTMEM_BASE = Xbyak::util::r13;
+
+namespace {
+
+constexpr size_t MAX_CODE_SEGMENT_COUNT = 8;
+/// Space that must remain in the current segment of both near and far code before another block is emitted.
+constexpr size_t MINIMUM_BLOCK_SPACE = 1 * 1024 * 1024;
+/// Granularity at which memory is committed when lazy commit is enabled.
+constexpr size_t COMMIT_CHUNK_SIZE = 64 * 1024;
+/// Memory committed up front for the dispatcher and routines emitted by the emitters before PreludeComplete.
+constexpr size_t PRELUDE_COMMIT_SIZE = 1 * 1024 * 1024;
+
+size_t TotalCodeSize(const CodeCacheConfig& config) {
+    return config.constant_pool_size + config.near_code_size + config.far_code_size;
+}
+
+/// Reserves address space for the code cache. The first chunk is committed so that code may be emitted immediately.
+u8* ReserveCodeMemory(size_t size) {
+#ifdef _WIN32
+    u8* const ptr = static_cast<u8*>(VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS));
+#else
+    void* const mapped = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    u8* const ptr = mapped == MAP_FAILED ? nullptr : static_cast<u8*>(mapped);
+#endif
+    if (!ptr) {
+        throw Xbyak::Error(Xbyak::ERR_CANT_ALLOC);
+    }
+    return ptr;
+}
+
+void CommitCodeMemory(u8* ptr, size_t size) {
+#ifdef _WIN32
+    const bool success = VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_EXECUTE_READWRITE) != nullptr;
+#else
+    const bool success = mprotect(ptr, size, PROT_READ | PROT_WRITE | PROT_EXEC) == 0;
+#endif
+    ASSERT_MSG(success, "Failed to commit code memory");
+}
+
+void ReleaseCodeMemory(u8* ptr, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+void* AllocateCodeMemory(const CodeCacheConfig& config) {
+    if (!config.lazy_commit) {
+        // Let Xbyak allocate and commit the whole cache.
+        return nullptr;
+    }
+
+    u8* const ptr = ReserveCodeMemory(TotalCodeSize(config));
+    CommitCodeMemory(ptr, COMMIT_CHUNK_SIZE);
+    return ptr;
+}
+
+} // anonymous namespace
 
-BlockOfCode::BlockOfCode(RunCodeCallbacks cb, JitStateInfo jsi)
-        : Xbyak::CodeGenerator(TOTAL_CODE_SIZE)
+BlockOfCode::BlockOfCode(RunCodeCallbacks cb, JitStateInfo jsi, CodeCacheConfig cache_config, bool enable_statistics, void* fastmem_pointer)
+        : Xbyak::CodeGenerator(TotalCodeSize(cache_config), AllocateCodeMemory(cache_config))
         , cb(std::move(cb))
         , jsi(jsi)
-        , constant_pool(*this, CONSTANT_POOL_SIZE)
+        , cache_config(cache_config)
+        , enable_statistics(enable_statistics)
+        , fastmem_pointer(fastmem_pointer)
+        , committed_chunks(cache_config.lazy_commit ? (TotalCodeSize(cache_config) + COMMIT_CHUNK_SIZE - 1) / COMMIT_CHUNK_SIZE : 0)
+        , constant_pool(*this, cache_config.constant_pool_size)
 {
+    ASSERT(cache_config.far_code_size >= MINIMUM_BLOCK_SPACE);
+
+    if (cache_config.lazy_commit) {
+        committed_chunks[0] = true;
+        EnsureCommitted(getCurr(), PRELUDE_COMMIT_SIZE);
+    }
+
     GenRunCode();
     exception_handler.Register(*this);
 }
 
+BlockOfCode::~BlockOfCode() {
+    if (cache_config.lazy_commit) {
+        ReleaseCodeMemory(const_cast<u8*>(getCode()), TotalCodeSize(cache_config));
+    }
+}
+
 void BlockOfCode::PreludeComplete() {
+    ASSERT_MSG(!cache_config.lazy_commit || getCurr() <= getCode() + cache_config.constant_pool_size + PRELUDE_COMMIT_SIZE,
+               "Prelude is larger than the memory committed for it");
+
     prelude_complete = true;
     near_code_begin = getCurr();
-    far_code_begin = getCurr() + FAR_CODE_OFFSET;
+    far_code_begin = getCode() + cache_config.constant_pool_size + cache_config.near_code_size;
+
+    ASSERT_MSG(near_code_begin < far_code_begin, "Prelude does not fit in near code");
+    const size_t near_code_size = static_cast<const u8*>(far_code_begin) - static_cast<const u8*>(near_code_begin);
+    ASSERT(near_code_size >= MINIMUM_BLOCK_SPACE);
+
+    // Small caches have fewer segments so that a block always fits into an empty segment.
+    const size_t smallest_region = std::min(near_code_size, cache_config.far_code_size);
+    segment_count = std::clamp<size_t>(smallest_region / (2 * MINIMUM_BLOCK_SPACE), 1, MAX_CODE_SEGMENT_COUNT);
+    near_segment_size = near_code_size / segment_count;
+    far_segment_size = cache_config.far_code_size / segment_count;
+
     ClearCache();
 }
 
 void BlockOfCode::ClearCache() {
     ASSERT(prelude_complete);
     in_far_code = false;
+    current_segment = 0;
     near_code_ptr = near_code_begin;
     far_code_ptr = far_code_begin;
     SetCodePtr(near_code_begin);
@@ -67,22 +163,44 @@ void BlockOfCode::ClearCache() {
 
 size_t BlockOfCode::SpaceRemaining() const {
     ASSERT(prelude_complete);
-    // This function provides an underestimate of near-code-size but that's okay.
-    // (Why? The maximum size of near code should be measured from near_code_begin, not top_.)
-    // These are offsets from Xbyak::CodeArray::top_.
-    std::size_t far_code_offset, near_code_offset;
-    if (in_far_code) {
-        near_code_offset = static_cast<const u8*>(near_code_ptr) - getCode();
-        far_code_offset = getCurr() - getCode();
-    } else {
-        near_code_offset = getCurr() - getCode();
-        far_code_offset = static_cast<const u8*>(far_code_ptr) - getCode();
-    }
-    if (far_code_offset > TOTAL_CODE_SIZE)
-        return 0;
-    if (near_code_offset > FAR_CODE_OFFSET)
+    const u8* const near_code_end = static_cast<const u8*>(near_code_begin) + (current_segment + 1) * near_segment_size;
+    const u8* const far_code_end = static_cast<const u8*>(far_code_begin) + (current_segment + 1) * far_segment_size;
+    const u8* const near_code_curr = in_far_code ? static_cast<const u8*>(near_code_ptr) : getCurr();
+    const u8* const far_code_curr = in_far_code ? getCurr() : static_cast<const u8*>(far_code_ptr);
+    if (near_code_curr > near_code_end || far_code_curr > far_code_end)
         return 0;
-    return std::min(TOTAL_CODE_SIZE - far_code_offset, FAR_CODE_OFFSET - near_code_offset);
+    return std::min<size_t>(near_code_end - near_code_curr, far_code_end - far_code_curr);
+}
+
+bool BlockOfCode::EnsureBlockSpace() {
+    ASSERT(!in_far_code);
+    if (SpaceRemaining() < MINIMUM_BLOCK_SPACE) {
+        return false;
+    }
+    EnsureCommitted(getCurr(), MINIMUM_BLOCK_SPACE);
+    EnsureCommitted(far_code_ptr, MINIMUM_BLOCK_SPACE);
+    return true;
+}
+
+size_t BlockOfCode::AdvanceSegment() {
+    ASSERT(prelude_complete);
+    ASSERT(!in_far_code);
+    current_segment = (current_segment + 1) % segment_count;
+    near_code_ptr = static_cast<const u8*>(near_code_begin) + current_segment * near_segment_size;
+    far_code_ptr = static_cast<const u8*>(far_code_begin) + current_segment * far_segment_size;
+    SetCodePtr(near_code_ptr);
+
+    const bool has_space = EnsureBlockSpace();
+    ASSERT(has_space);
+    return current_segment;
+}
+
+bool BlockOfCode::IsInSegment(CodePtr ptr, size_t segment) const {
+    const u8* const p = static_cast<const u8*>(ptr);
+    const u8* const near_segment_begin = static_cast<const u8*>(near_code_begin) + segment * near_segment_size;
+    const u8* const far_segment_begin = static_cast<const u8*>(far_code_begin) + segment * far_segment_size;
+    return (p >= near_segment_begin && p < near_segment_begin + near_segment_size)
+        || (p >= far_segment_begin && p < far_segment_begin + far_segment_size);
 }
 
 void BlockOfCode::RunCode(void* jit_state) const {
@@ -108,7 +226,7 @@ void BlockOfCode::ForceReturnFromRunCode(bool mxcsr_already_exited) {
 }
 
 void BlockOfCode::GenRunCode() {
-    Xbyak::Label loop, enter_mxcsr_then_loop;
+    Xbyak::Label loop;
 
     align();
     run_code_from = getCurr<RunCodeFromFuncType>();
@@ -117,12 +235,16 @@ void BlockOfCode::GenRunCode() {
 
     mov(r15, ABI_PARAM1);
     mov(r14, ABI_PARAM2); // save temporarily in non-volatile register
+    if (fastmem_pointer) {
+        mov(FASTMEM_BASE, reinterpret_cast<u64>(fastmem_pointer));
+    }
 
-    cb.GetTicksRemaining->EmitCall(*this);
-    mov(qword[r15 + jsi.offsetof_cycles_to_run], ABI_RETURN);
-    mov(qword[r15 + jsi.offsetof_cycles_remaining], ABI_RETURN);
+    if (TicksEnabled()) {
+        cb.GetTicksRemaining->EmitCall(*this);
+        mov(qword[r15 + jsi.offsetof_cycles_to_run], ABI_RETURN);
+        mov(qword[r15 + jsi.offsetof_cycles_remaining], ABI_RETURN);
+    }
 
-    SwitchMxcsrOnEntry();
     jmp(r14);
 
     align();
@@ -135,33 +257,41 @@ void BlockOfCode::GenRunCode() {
     ABI_PushCalleeSaveRegistersAndAdjustStack(*this);
 
     mov(r15, ABI_PARAM1);
+    if (fastmem_pointer) {
+        mov(FASTMEM_BASE, reinterpret_cast<u64>(fastmem_pointer));
+    }
 
-    cb.GetTicksRemaining->EmitCall(*this);
-    mov(qword[r15 + jsi.offsetof_cycles_to_run], ABI_RETURN);
-    mov(qword[r15 + jsi.offsetof_cycles_remaining], ABI_RETURN);
+    if (TicksEnabled()) {
+        cb.GetTicksRemaining->EmitCall(*this);
+        mov(qword[r15 + jsi.offsetof_cycles_to_run], ABI_RETURN);
+        mov(qword[r15 + jsi.offsetof_cycles_remaining], ABI_RETURN);
+    }
 
-    L(enter_mxcsr_then_loop);
-    SwitchMxcsrOnEntry();
     L(loop);
     cb.LookupBlock->EmitCall(*this);
 
     jmp(ABI_RETURN);
 
     // Return from run code variants
-    const auto emit_return_from_run_code = [this, &loop, &enter_mxcsr_then_loop](bool mxcsr_already_exited, bool force_return){
+    const auto emit_return_from_run_code = [this, &loop](bool mxcsr_already_exited, bool force_return){
         if (!force_return) {
+            Xbyak::Label halt;
+            JumpIfHaltRequested(halt);
             cmp(qword[r15 + jsi.offsetof_cycles_remaining], 0);
-            jg(mxcsr_already_exited ? enter_mxcsr_then_loop : loop);
+            jg(loop);
+            L(halt);
         }
 
         if (!mxcsr_already_exited) {
             SwitchMxcsrOnExit();
         }
 
-        cb.AddTicks->EmitCall(*this, [this](RegList param) {
-            mov(param[0], qword[r15 + jsi.offsetof_cycles_to_run]);
-            sub(param[0], qword[r15 + jsi.offsetof_cycles_remaining]);
-        });
+        if (TicksEnabled()) {
+            cb.AddTicks->EmitCall(*this, [this](RegList param) {
+                mov(param[0], qword[r15 + jsi.offsetof_cycles_to_run]);
+                sub(param[0], qword[r15 + jsi.offsetof_cycles_remaining]);
+            });
+        }
 
         ABI_PopCalleeSaveRegistersAndAdjustStack(*this);
         ret();
@@ -184,17 +314,54 @@ void BlockOfCode::GenRunCode() {
     emit_return_from_run_code(true, true);
 }
 
+void BlockOfCode::LookupBlock() {
+    cb.LookupBlock->EmitCall(*this);
+}
+
+void BlockOfCode::TierUpBlock(u64 location_descriptor) {
+    ASSERT(cb.TierUpBlock);
+    cb.TierUpBlock->EmitCall(*this, [&](RegList param) {
+        mov(param[0], location_descriptor);
+    });
+}
+
 void BlockOfCode::SwitchMxcsrOnEntry() {
+    Xbyak::Label end;
+    cmp(byte[r15 + jsi.offsetof_guest_MXCSR_live], u8(0));
+    jne(end);
     stmxcsr(dword[r15 + jsi.offsetof_save_host_MXCSR]);
     ldmxcsr(dword[r15 + jsi.offsetof_guest_MXCSR]);
+    mov(byte[r15 + jsi.offsetof_guest_MXCSR_live], u8(1));
+    UpdateStatistic(jsi.offsetof_mxcsr_accesses, 2);
+    L(end);
 }
 
 void BlockOfCode::SwitchMxcsrOnExit() {
+    Xbyak::Label end;
+    cmp(byte[r15 + jsi.offsetof_guest_MXCSR_live], u8(0));
+    je(end);
     stmxcsr(dword[r15 + jsi.offsetof_guest_MXCSR]);
     ldmxcsr(dword[r15 + jsi.offsetof_save_host_MXCSR]);
+    mov(byte[r15 + jsi.offsetof_guest_MXCSR_live], u8(0));
+    UpdateStatistic(jsi.offsetof_mxcsr_accesses, 2);
+    L(end);
+}
+
+void BlockOfCode::StoreGuestMxcsr() {
+    stmxcsr(dword[r15 + jsi.offsetof_guest_MXCSR]);
+    UpdateStatistic(jsi.offsetof_mxcsr_accesses);
+}
+
+void BlockOfCode::LoadGuestMxcsr() {
+    ldmxcsr(dword[r15 + jsi.offsetof_guest_MXCSR]);
+    UpdateStatistic(jsi.offsetof_mxcsr_accesses);
 }
 
 void BlockOfCode::UpdateTicks() {
+    if (!TicksEnabled()) {
+        return;
+    }
+
     cb.AddTicks->EmitCall(*this, [this](RegList param) {
         mov(param[0], qword[r15 + jsi.offsetof_cycles_to_run]);
         sub(param[0], qword[r15 + jsi.offsetof_cycles_remaining]);
@@ -205,6 +372,29 @@ void BlockOfCode::UpdateTicks() {
     mov(qword[r15 + jsi.offsetof_cycles_remaining], ABI_RETURN);
 }
 
+void BlockOfCode::JumpIfHaltRequested(const Xbyak::Label& target) {
+    if (!TicksEnabled()) {
+        return;
+    }
+    cmp(byte[r15 + jsi.offsetof_halt_requested], u8(0));
+    jne(target, T_NEAR);
+}
+
+void BlockOfCode::JumpIfHaltRequested(const void* target) {
+    if (!TicksEnabled()) {
+        return;
+    }
+    cmp(byte[r15 + jsi.offsetof_halt_requested], u8(0));
+    jne(target);
+}
+
+void BlockOfCode::UpdateStatistic(size_t offsetof_counter, u32 amount) {
+    if (!enable_statistics) {
+        return;
+    }
+    add(qword[r15 + offsetof_counter], amount);
+}
+
 Xbyak::Address BlockOfCode::MConst(const Xbyak::AddressFrame& frame, u64 lower, u64 upper) {
     return constant_pool.GetConstant(frame, lower, upper);
 }
@@ -232,16 +422,41 @@ CodePtr BlockOfCode::GetCodeBegin() const {
 }
 
 void* BlockOfCode::AllocateFromCodeSpace(size_t alloc_size) {
+    void* ret = ReserveFromCodeSpace(alloc_size);
+    EnsureCommitted(ret, alloc_size);
+    memset(ret, 0, alloc_size);
+    return ret;
+}
+
+void* BlockOfCode::ReserveFromCodeSpace(size_t alloc_size) {
     if (size_ + alloc_size >= maxSize_) {
         throw Xbyak::Error(Xbyak::ERR_CODE_IS_TOO_BIG);
     }
 
     void* ret = getCurr<void*>();
     size_ += alloc_size;
-    memset(ret, 0, alloc_size);
     return ret;
 }
 
+void BlockOfCode::EnsureCommitted(const void* begin, size_t size) {
+    if (!cache_config.lazy_commit || size == 0) {
+        return;
+    }
+
+    const size_t begin_offset = static_cast<const u8*>(begin) - getCode();
+    const size_t first_chunk = begin_offset / COMMIT_CHUNK_SIZE;
+    const size_t last_chunk = std::min((begin_offset + size - 1) / COMMIT_CHUNK_SIZE, committed_chunks.size() - 1);
+
+    for (size_t chunk = first_chunk; chunk <= last_chunk; chunk++) {
+        if (committed_chunks[chunk]) {
+            continue;
+        }
+        const size_t chunk_size = std::min(COMMIT_CHUNK_SIZE, maxSize_ - chunk * COMMIT_CHUNK_SIZE);
+        CommitCodeMemory(const_cast<u8*>(getCode()) + chunk * COMMIT_CHUNK_SIZE, chunk_size);
+        committed_chunks[chunk] = true;
+    }
+}
+
 void BlockOfCode::SetCodePtr(CodePtr code_ptr) {
     // The "size" defines where top_, the insertion point, is.
     size_t required_size = reinterpret_cast<const u8*>(code_ptr) - getCode();
@@ -263,4 +478,12 @@ bool BlockOfCode::DoesCpuSupport(Xbyak::util::Cpu::Type type) const {
 #endif
 }
 
+bool BlockOfCode::SupportsFastmem() const {
+    return exception_handler.SupportsFastmem();
+}
+
+void BlockOfCode::SetFastmemCallback(FastmemCallback cb, void* arg) {
+    exception_handler.SetFastmemCallback(cb, arg);
+}
+
 } // namespace Dynarmic::BackendX64
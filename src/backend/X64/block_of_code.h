@@ -7,8 +7,10 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include <memory>
 #include <type_traits>
+#include <vector>
 
 #include <xbyak.h>
 #include <xbyak_util.h>
@@ -24,20 +26,42 @@ using CodePtr = const void*;
 
 struct RunCodeCallbacks {
     std::unique_ptr<Callback> LookupBlock;
+    /// AddTicks and GetTicksRemaining are both null if ticks are disabled.
     std::unique_ptr<Callback> AddTicks;
     std::unique_ptr<Callback> GetTicksRemaining;
+    /// May be null if tiered compilation is not supported by the frontend.
+    std::unique_ptr<Callback> TierUpBlock;
+};
+
+struct CodeCacheConfig {
+    size_t near_code_size;
+    size_t far_code_size;
+    size_t constant_pool_size;
+    /// Reserve address space for the whole cache up front but only commit memory as it is used.
+    bool lazy_commit;
 };
 
 class BlockOfCode final : public Xbyak::CodeGenerator {
 public:
-    BlockOfCode(RunCodeCallbacks cb, JitStateInfo jsi);
+    /// If fastmem_pointer is not nullptr, it is held in FASTMEM_BASE throughout emitted code.
+    BlockOfCode(RunCodeCallbacks cb, JitStateInfo jsi, CodeCacheConfig cache_config, bool enable_statistics, void* fastmem_pointer);
+    ~BlockOfCode();
     /// Call when external emitters have finished emitting their preludes.
     void PreludeComplete();
 
     /// Clears this block of code and resets code pointer to beginning.
     void ClearCache();
-    /// Calculates how much space is remaining to use. This is the minimum of near code and far code.
+    /// Calculates how much space is remaining to use in the current segment. This is the minimum of near code and far code.
     size_t SpaceRemaining() const;
+    /// Returns true if there is room to emit another block in the current segment, committing memory for it if necessary.
+    bool EnsureBlockSpace();
+    /// The cache is split into segments that are filled in order and reused oldest first.
+    /// Moves emission to the start of the next segment, whose previous contents the caller must discard.
+    /// There is always room for another block after this call.
+    /// @return The index of the new current segment.
+    size_t AdvanceSegment();
+    /// Returns true if ptr lies within the near or far code of the given segment.
+    bool IsInSegment(CodePtr ptr, size_t segment) const;
 
     /// Runs emulated code.
     void RunCode(void* jit_state) const;
@@ -47,13 +71,35 @@ public:
     void ReturnFromRunCode(bool mxcsr_already_exited = false);
     /// Code emitter: Returns to dispatcher, forces return to host
     void ForceReturnFromRunCode(bool mxcsr_already_exited = false);
-    /// Code emitter: Makes guest MXCSR the current MXCSR
+    /// Code emitter: Calls cb.LookupBlock, the host code pointer for the current location is returned in ABI_RETURN
+    void LookupBlock();
+    /// Code emitter: Calls cb.TierUpBlock, the host code pointer to continue execution at is returned in ABI_RETURN
+    void TierUpBlock(u64 location_descriptor);
+    /// Code emitter: Makes guest MXCSR the current MXCSR, unless it already is.
+    /// The host MXCSR is current on entry to emitted code, and the switch to the guest MXCSR is deferred until
+    /// a block that requires it runs. It then stays current until emitted code returns to the host.
     void SwitchMxcsrOnEntry();
-    /// Code emitter: Makes saved host MXCSR the current MXCSR
+    /// Code emitter: Makes saved host MXCSR the current MXCSR, unless it already is
     void SwitchMxcsrOnExit();
+    /// Code emitter: Saves the current MXCSR, which must be the guest MXCSR, to guest_MXCSR
+    void StoreGuestMxcsr();
+    /// Code emitter: Makes guest_MXCSR the current MXCSR, which must already be the guest MXCSR
+    void LoadGuestMxcsr();
     /// Code emitter: Updates cycles remaining my calling cb.AddTicks and cb.GetTicksRemaining
     /// @note this clobbers ABI callee-save registers
     void UpdateTicks();
+    /// If false, cycles are not counted and cycles_remaining is instead kept positive by the frontend
+    /// until a halt is requested, so that the checks emitted for cycles remaining also serve as halt checks.
+    bool TicksEnabled() const { return cb.GetTicksRemaining != nullptr; }
+    /// Code emitter: Jumps to target if a halt has been requested. This precedes each check of cycles remaining,
+    /// as a halt requested from another thread cannot safely modify cycles_remaining while ticks are counted.
+    /// Without ticks nothing is emitted, the check of cycles remaining already serves as the halt check.
+    void JumpIfHaltRequested(const Xbyak::Label& target);
+    void JumpIfHaltRequested(const void* target);
+
+    /// Code emitter: Adds amount to the u64 counter at the given offset into the jit state, if statistics are enabled
+    /// @note this clobbers host flags
+    void UpdateStatistic(size_t offsetof_counter, u32 amount = 1);
 
     /// Code emitter: Calls the function
     template <typename FunctionPointer>
@@ -79,6 +125,7 @@ public:
     /// "Cold" / Rarely executed instructions sit in far code, so the CPU doesn't fetch them unless necessary.
     void SwitchToFarCode();
     void SwitchToNearCode();
+    bool IsInFarCode() const { return in_far_code; }
 
     CodePtr GetCodeBegin() const;
 
@@ -96,6 +143,11 @@ public:
     /// This is useful for objects that need to be placed close to or within code.
     /// The lifetime of this memory is the same as the code around it.
     void* AllocateFromCodeSpace(size_t size);
+    /// As AllocateFromCodeSpace, but the memory is neither zeroed nor committed.
+    /// EnsureCommitted must be called on any part of it before use.
+    void* ReserveFromCodeSpace(size_t size);
+    /// Commits memory in the given range if lazy commit is enabled.
+    void EnsureCommitted(const void* begin, size_t size);
 
     void SetCodePtr(CodePtr code_ptr);
     void EnsurePatchLocationSize(CodePtr begin, size_t size);
@@ -120,17 +172,39 @@ public:
     static const std::array<Xbyak::Reg64, 6> ABI_PARAMS;
 #endif
 
+    /// Callee-saved register holding the fastmem pointer given on construction. Emitted code that uses it must
+    /// reserve it in the register allocator and must not pin guest registers to it.
+    static const Xbyak::Reg64 FASTMEM_BASE;
+
     bool DoesCpuSupport(Xbyak::util::Cpu::Type type) const;
 
+    /// Returns true if faulting memory accesses in emitted code can be caught, which fastmem relies on.
+    bool SupportsFastmem() const;
+    using FastmemCallback = bool (*)(void* arg, u64 rip);
+    /// Sets the function called when a memory access in emitted code faults.
+    /// It is given arg and the host address of the faulting instruction, and returns true if it has rewritten the
+    /// instruction so that the access can be retried. It is called from a signal handler, so must not allocate
+    /// or take locks. Pass nullptr to remove the callback.
+    void SetFastmemCallback(FastmemCallback cb, void* arg);
+
     JitStateInfo GetJitStateInfo() const { return jsi; }
 
 private:
     RunCodeCallbacks cb;
     JitStateInfo jsi;
+    CodeCacheConfig cache_config;
+    bool enable_statistics;
+    void* fastmem_pointer;
 
     bool prelude_complete = false;
     CodePtr near_code_begin;
     CodePtr far_code_begin;
+    size_t segment_count;
+    size_t near_segment_size;
+    size_t far_segment_size;
+    size_t current_segment = 0;
+
+    std::vector<bool> committed_chunks;
 
     ConstantPool constant_pool;
 
@@ -153,6 +227,8 @@ private:
         ~ExceptionHandler();
 
         void Register(BlockOfCode& code);
+        bool SupportsFastmem() const;
+        void SetFastmemCallback(FastmemCallback cb, void* arg);
     private:
         struct Impl;
         std::unique_ptr<Impl> impl;
@@ -4,9 +4,10 @@
  * General Public License version 2 or any later version.
  */
 
-#include <unordered_set>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
 
-#include <boost/icl/interval_map.hpp>
 #include <boost/icl/interval_set.hpp>
 
 #include "backend/x64/block_range_information.h"
@@ -16,27 +17,106 @@ namespace Dynarmic::BackendX64 {
 
 template <typename ProgramCounterType>
 void BlockRangeInformation<ProgramCounterType>::AddRange(boost::icl::discrete_interval<ProgramCounterType> range, IR::LocationDescriptor location) {
-    block_ranges.add(std::make_pair(range, std::set<IR::LocationDescriptor>{location}));
+    if (boost::icl::is_empty(range)) {
+        return;
+    }
+
+    const ProgramCounterType first = boost::icl::first(range);
+    const ProgramCounterType last = boost::icl::last(range);
+    auto& pages_of_location = location_pages[location];
+
+    for (ProgramCounterType page = first >> page_bits;; page++) {
+        pages[page].push_back(RangeEntry{first, last, location});
+        if (std::find(pages_of_location.begin(), pages_of_location.end(), page) == pages_of_location.end()) {
+            pages_of_location.push_back(page);
+        }
+        if (page == last >> page_bits) {
+            break;
+        }
+    }
 }
 
 template <typename ProgramCounterType>
 void BlockRangeInformation<ProgramCounterType>::ClearCache() {
-    block_ranges.clear();
+    pages.clear();
+    location_pages.clear();
 }
 
 template <typename ProgramCounterType>
-std::unordered_set<IR::LocationDescriptor> BlockRangeInformation<ProgramCounterType>::InvalidateRanges(const boost::icl::interval_set<ProgramCounterType>& ranges) {
-    std::unordered_set<IR::LocationDescriptor> erase_locations;
+const std::vector<IR::LocationDescriptor>& BlockRangeInformation<ProgramCounterType>::InvalidateRanges(const boost::icl::interval_set<ProgramCounterType>& ranges) {
+    invalidated_locations.clear();
+
+    const auto visit_page = [this](const std::vector<RangeEntry>& entries, ProgramCounterType first, ProgramCounterType last) {
+        for (const auto& entry : entries) {
+            if (entry.first <= last && first <= entry.last) {
+                invalidated_locations.push_back(entry.location);
+            }
+        }
+    };
+
     for (auto invalidate_interval : ranges) {
-        auto pair = block_ranges.equal_range(invalidate_interval);
-        for (auto it = pair.first; it != pair.second; ++it) {
-            for (const auto &descriptor : it->second) {
-                erase_locations.insert(descriptor);
+        if (boost::icl::is_empty(invalidate_interval)) {
+            continue;
+        }
+
+        const ProgramCounterType first = boost::icl::first(invalidate_interval);
+        const ProgramCounterType last = boost::icl::last(invalidate_interval);
+        const ProgramCounterType first_page = first >> page_bits;
+        const ProgramCounterType last_page = last >> page_bits;
+
+        if (static_cast<u64>(last_page - first_page) >= pages.size()) {
+            // Large ranges touch more pages than we have entries for; scan the index instead.
+            for (const auto& [page, entries] : pages) {
+                if (page >= first_page && page <= last_page) {
+                    visit_page(entries, first, last);
+                }
+            }
+            continue;
+        }
+
+        for (ProgramCounterType page = first_page;; page++) {
+            if (const auto iter = pages.find(page); iter != pages.end()) {
+                visit_page(iter->second, first, last);
+            }
+            if (page == last_page) {
+                break;
             }
         }
     }
-    // TODO: EFFICIENCY: Remove ranges that are to be erased.
-    return erase_locations;
+
+    // A block is found once for each of its ranges that overlaps; keep only the first, which removes it.
+    const auto is_duplicate = [this](IR::LocationDescriptor location) { return !RemoveLocation(location); };
+    invalidated_locations.erase(std::remove_if(invalidated_locations.begin(), invalidated_locations.end(), is_duplicate),
+                                invalidated_locations.end());
+
+    return invalidated_locations;
+}
+
+template <typename ProgramCounterType>
+bool BlockRangeInformation<ProgramCounterType>::RemoveLocation(IR::LocationDescriptor location) {
+    const auto iter = location_pages.find(location);
+    if (iter == location_pages.end()) {
+        return false;
+    }
+
+    for (const ProgramCounterType page : iter->second) {
+        const auto page_iter = pages.find(page);
+        if (page_iter == pages.end()) {
+            continue;
+        }
+
+        auto& entries = page_iter->second;
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [location](const RangeEntry& entry) {
+            return entry.location == location;
+        }), entries.end());
+
+        if (entries.empty()) {
+            pages.erase(page_iter);
+        }
+    }
+
+    location_pages.erase(iter);
+    return true;
 }
 
 template class BlockRangeInformation<u32>;
@@ -6,24 +6,44 @@
 
 #pragma once
 
-#include <unordered_set>
+#include <unordered_map>
+#include <vector>
 
-#include <boost/icl/interval_map.hpp>
 #include <boost/icl/interval_set.hpp>
 
 #include "frontend/ir/location_descriptor.h"
 
 namespace Dynarmic::BackendX64 {
 
+/// Maps ranges of guest code to the blocks translated from them.
+/// Ranges are bucketed by guest page so that invalidating a range only visits the blocks on the affected pages.
 template <typename ProgramCounterType>
 class BlockRangeInformation {
 public:
     void AddRange(boost::icl::discrete_interval<ProgramCounterType> range, IR::LocationDescriptor location);
     void ClearCache();
-    std::unordered_set<IR::LocationDescriptor> InvalidateRanges(const boost::icl::interval_set<ProgramCounterType>& ranges);
+    /// Returns the blocks overlapping `ranges` and removes them from the index.
+    /// The returned vector is reused, and is only valid until the next call.
+    const std::vector<IR::LocationDescriptor>& InvalidateRanges(const boost::icl::interval_set<ProgramCounterType>& ranges);
+    /// Removes all ranges associated with a block.
+    /// @return false if the block had no ranges.
+    bool RemoveLocation(IR::LocationDescriptor location);
 
 private:
-    boost::icl::interval_map<ProgramCounterType, std::set<IR::LocationDescriptor>> block_ranges;
+    static constexpr size_t page_bits = 12;
+
+    struct RangeEntry {
+        ProgramCounterType first;
+        ProgramCounterType last;
+        IR::LocationDescriptor location;
+    };
+
+    /// Page number -> ranges touching that page.
+    std::unordered_map<ProgramCounterType, std::vector<RangeEntry>> pages;
+    /// Block -> page numbers it has entries on.
+    std::unordered_map<IR::LocationDescriptor, std::vector<ProgramCounterType>> location_pages;
+    /// Result of InvalidateRanges, kept to avoid an allocation per call.
+    std::vector<IR::LocationDescriptor> invalidated_locations;
 };
 
 } // namespace Dynarmic::BackendX64
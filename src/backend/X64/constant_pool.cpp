@@ -15,7 +15,7 @@ namespace Dynarmic::BackendX64 {
 ConstantPool::ConstantPool(BlockOfCode& code, size_t size) : code(code), pool_size(size) {
     code.int3();
     code.align(align_size);
-    pool_begin = reinterpret_cast<u8*>(code.AllocateFromCodeSpace(size));
+    pool_begin = reinterpret_cast<u8*>(code.ReserveFromCodeSpace(size));
     current_pool_ptr = pool_begin;
 }
 
@@ -24,6 +24,7 @@ Xbyak::Address ConstantPool::GetConstant(const Xbyak::AddressFrame& frame, u64 l
     auto iter = constant_info.find(constant);
     if (iter == constant_info.end()) {
         ASSERT(static_cast<size_t>(current_pool_ptr - pool_begin) < pool_size);
+        code.EnsureCommitted(current_pool_ptr, align_size);
         std::memcpy(current_pool_ptr, &lower, sizeof(u64));
         std::memcpy(current_pool_ptr + sizeof(u64), &upper, sizeof(u64));
         iter = constant_info.emplace(constant, current_pool_ptr).first;
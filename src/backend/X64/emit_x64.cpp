@@ -4,9 +4,12 @@
  * General Public License version 2 or any later version.
  */
 
+#include <algorithm>
+#include <initializer_list>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "backend/x64/abi.h"
 #include "backend/x64/block_of_code.h"
 #include "backend/x64/emit_x64.h"
 #include "common/assert.h"
@@ -73,10 +76,10 @@ void EmitX64::PushRSBHelper(Xbyak::Reg64 loc_desc_reg, Xbyak::Reg64 index_reg, I
     patch_information[target].mov_rcx.emplace_back(code.getCurr());
     EmitPatchMovRcx(target_code_ptr);
 
-    code.mov(qword[r15 + index_reg * 8 + code.GetJitStateInfo().offsetof_rsb_location_descriptors], loc_desc_reg);
-    code.mov(qword[r15 + index_reg * 8 + code.GetJitStateInfo().offsetof_rsb_codeptrs], rcx);
+    code.mov(qword[r15 + index_reg + code.GetJitStateInfo().offsetof_rsb_location_descriptor], loc_desc_reg);
+    code.mov(qword[r15 + index_reg + code.GetJitStateInfo().offsetof_rsb_code_ptr], rcx);
 
-    code.add(index_reg.cvt32(), 1);
+    code.add(index_reg.cvt32(), u32(code.GetJitStateInfo().rsb_entry_size));
     code.and_(index_reg.cvt32(), u32(code.GetJitStateInfo().rsb_ptr_mask));
     code.mov(dword[r15 + code.GetJitStateInfo().offsetof_rsb_ptr], index_reg.cvt32());
 }
@@ -93,6 +96,43 @@ void EmitX64::EmitPushRSB(EmitContext& ctx, IR::Inst* inst) {
     PushRSBHelper(loc_desc_reg, index_reg, IR::LocationDescriptor{unique_hash_of_target});
 }
 
+void EmitX64::EmitSideExitIf(EmitContext& ctx, IR::Inst* inst) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    const IR::Cond cond = args[0].GetImmediateCond();
+    const size_t index = args[1].GetImmediateU64();
+
+    // EmitCond clobbers these registers.
+    ctx.reg_alloc.ScratchGpr({HostLoc::RAX});
+    ctx.reg_alloc.ScratchGpr({HostLoc::RBX});
+    ctx.reg_alloc.ScratchGpr({HostLoc::RSI});
+
+    Xbyak::Label exit = EmitCond(cond, Xbyak::CodeGenerator::T_NEAR);
+    EmitSideExit(ctx.block, index, exit);
+}
+
+void EmitX64::EmitSideExitIfBit(EmitContext& ctx, IR::Inst* inst) {
+    auto args = ctx.reg_alloc.GetArgumentInfo(inst);
+    const bool taken_if = args[1].GetImmediateU1();
+    const size_t index = args[2].GetImmediateU64();
+
+    Xbyak::Label exit;
+    if (args[0].IsImmediate()) {
+        if (args[0].GetImmediateU1() != taken_if) {
+            return;
+        }
+        code.jmp(exit, code.T_NEAR);
+    } else {
+        const Xbyak::Reg8 bit = ctx.reg_alloc.UseGpr(args[0]).cvt8();
+        code.test(bit, bit);
+        if (taken_if) {
+            code.jnz(exit, code.T_NEAR);
+        } else {
+            code.jz(exit, code.T_NEAR);
+        }
+    }
+    EmitSideExit(ctx.block, index, exit);
+}
+
 void EmitX64::EmitGetCarryFromOp(EmitContext&, IR::Inst*) {
     ASSERT_MSG(false, "should never happen");
 }
@@ -155,11 +195,15 @@ void EmitX64::EmitNZCVFromPackedFlags(EmitContext& ctx, IR::Inst* inst) {
 }
 
 void EmitX64::EmitAddCycles(size_t cycles) {
+    if (!code.TicksEnabled()) {
+        return;
+    }
+
     ASSERT(cycles < std::numeric_limits<u32>::max());
     code.sub(qword[r15 + code.GetJitStateInfo().offsetof_cycles_remaining], static_cast<u32>(cycles));
 }
 
-Xbyak::Label EmitX64::EmitCond(IR::Cond cond) {
+Xbyak::Label EmitX64::EmitCond(IR::Cond cond, Xbyak::CodeGenerator::LabelType type) {
     Xbyak::Label label;
 
     const Xbyak::Reg32 cpsr = eax;
@@ -177,53 +221,53 @@ Xbyak::Label EmitX64::EmitCond(IR::Cond cond) {
     switch (cond) {
     case IR::Cond::EQ: //z
         code.test(cpsr, z_mask);
-        code.jnz(label);
+        code.jnz(label, type);
         break;
     case IR::Cond::NE: //!z
         code.test(cpsr, z_mask);
-        code.jz(label);
+        code.jz(label, type);
         break;
     case IR::Cond::CS: //c
         code.test(cpsr, c_mask);
-        code.jnz(label);
+        code.jnz(label, type);
         break;
     case IR::Cond::CC: //!c
         code.test(cpsr, c_mask);
-        code.jz(label);
+        code.jz(label, type);
         break;
     case IR::Cond::MI: //n
         code.test(cpsr, n_mask);
-        code.jnz(label);
+        code.jnz(label, type);
         break;
     case IR::Cond::PL: //!n
         code.test(cpsr, n_mask);
-        code.jz(label);
+        code.jz(label, type);
         break;
     case IR::Cond::VS: //v
         code.test(cpsr, v_mask);
-        code.jnz(label);
+        code.jnz(label, type);
         break;
     case IR::Cond::VC: //!v
         code.test(cpsr, v_mask);
-        code.jz(label);
+        code.jz(label, type);
         break;
     case IR::Cond::HI: { //c & !z
         code.and_(cpsr, z_mask | c_mask);
         code.cmp(cpsr, c_mask);
-        code.je(label);
+        code.je(label, type);
         break;
     }
     case IR::Cond::LS: { //!c | z
         code.and_(cpsr, z_mask | c_mask);
         code.cmp(cpsr, c_mask);
-        code.jne(label);
+        code.jne(label, type);
         break;
     }
     case IR::Cond::GE: { // n == v
         code.and_(cpsr, n_mask | v_mask);
-        code.jz(label);
+        code.jz(label, type);
         code.cmp(cpsr, n_mask | v_mask);
-        code.je(label);
+        code.je(label, type);
         break;
     }
     case IR::Cond::LT: { // n != v
@@ -231,7 +275,7 @@ Xbyak::Label EmitX64::EmitCond(IR::Cond cond) {
         code.and_(cpsr, n_mask | v_mask);
         code.jz(fail);
         code.cmp(cpsr, n_mask | v_mask);
-        code.jne(label);
+        code.jne(label, type);
         code.L(fail);
         break;
     }
@@ -246,7 +290,7 @@ Xbyak::Label EmitX64::EmitCond(IR::Cond cond) {
         code.xor_(tmp1, tmp2);
         code.or_(tmp1, cpsr);
         code.test(tmp1, 1);
-        code.jz(label);
+        code.jz(label, type);
         break;
     }
     case IR::Cond::LE: { // z | (n != v)
@@ -260,7 +304,7 @@ Xbyak::Label EmitX64::EmitCond(IR::Cond cond) {
         code.xor_(tmp1, tmp2);
         code.or_(tmp1, cpsr);
         code.test(tmp1, 1);
-        code.jnz(label);
+        code.jnz(label, type);
         break;
     }
     default:
@@ -285,13 +329,97 @@ void EmitX64::EmitCondPrelude(const IR::Block& block) {
     code.L(pass);
 }
 
+void EmitX64::EmitMxcsrPrelude(const IR::Block& block) {
+    const bool requires_guest_mxcsr = std::any_of(block.begin(), block.end(), [](const IR::Inst& inst) {
+        // Reads of FPSR and writes to FPSR or FPCR access the guest MXCSR directly.
+        switch (inst.GetOpcode()) {
+        case IR::Opcode::A32GetFpscr:
+        case IR::Opcode::A64GetFPSR:
+        case IR::Opcode::A64SetFPSR:
+            return true;
+        default:
+            return inst.IsFloatingPointOperation() || inst.WritesToFPCR();
+        }
+    });
+    if (requires_guest_mxcsr) {
+        code.SwitchMxcsrOnEntry();
+    }
+}
+
+void EmitX64::EmitSideExit(const IR::Block& block, size_t index, Xbyak::Label& exit) {
+    const auto& side_exit = block.SideExits().at(index);
+
+    code.SwitchToFarCode();
+    code.L(exit);
+    EmitAddCycles(side_exit.cycle_count);
+    EmitTerminal(IR::Term::LinkBlock{side_exit.target}, block.Location());
+    code.SwitchToNearCode();
+}
+
+void EmitX64::EmitTierUpCounter(IR::LocationDescriptor location, u32 threshold) {
+    Xbyak::Label counter, tier_up;
+
+    code.sub(dword[rip + counter], 1);
+    code.jz(tier_up, code.T_NEAR);
+
+    code.SwitchToFarCode();
+    // Keep the counter on a cache line of its own so that it does not share a line with code.
+    code.align(64);
+    code.L(counter);
+    code.dd(threshold);
+    code.align(64);
+    code.L(tier_up);
+    // Rearm the counter, so that if the block cannot be recompiled now it is tried again after another `threshold` entries.
+    code.mov(dword[rip + counter], threshold);
+    code.TierUpBlock(location.Value());
+    code.jmp(code.ABI_RETURN);
+    code.SwitchToNearCode();
+}
+
+bool EmitX64::IsSelfLoop(const IR::Block& block) {
+    const auto links_to_self = [&block](const IR::Terminal& terminal, const auto& self) -> bool {
+        return Common::VisitVariant<bool>(terminal, [&](const auto& x) {
+            using T = std::decay_t<decltype(x)>;
+            if constexpr (std::is_same_v<T, IR::Term::LinkBlock> || std::is_same_v<T, IR::Term::LinkBlockFast>) {
+                return x.next == block.Location();
+            } else if constexpr (std::is_same_v<T, IR::Term::If> || std::is_same_v<T, IR::Term::CheckBit>) {
+                return self(x.then_, self) || self(x.else_, self);
+            } else if constexpr (std::is_same_v<T, IR::Term::CheckHalt>) {
+                return self(x.else_, self);
+            } else {
+                return false;
+            }
+        });
+    };
+    return links_to_self(block.GetTerminal(), links_to_self);
+}
+
 void EmitX64::EmitTerminal(IR::Terminal terminal, IR::LocationDescriptor initial_location) {
     Common::VisitVariant<void>(terminal, [this, &initial_location](auto x) {
         using T = std::decay_t<decltype(x)>;
-        if constexpr (!std::is_same_v<T, IR::Term::Invalid>) {
+        if constexpr (std::is_same_v<T, IR::Term::Invalid>) {
+            ASSERT_MSG(false, "Invalid terminal");
+        } else if constexpr (std::is_same_v<T, IR::Term::If> || std::is_same_v<T, IR::Term::CheckBit>) {
             this->EmitTerminalImpl(x, initial_location);
         } else {
-            ASSERT_MSG(false, "Invalid terminal");
+            if constexpr (std::is_same_v<T, IR::Term::LinkBlock> || std::is_same_v<T, IR::Term::LinkBlockFast>) {
+                if (loop_head && x.next == initial_location) {
+                    // Back edge: keep looping in host code while there are cycles remaining and no halt has been requested.
+                    // LinkBlockFast back edges are checked too and exit as LinkBlock would, so every loop observes a halt.
+                    Xbyak::Label halt;
+                    code.JumpIfHaltRequested(halt);
+                    code.cmp(qword[r15 + code.GetJitStateInfo().offsetof_cycles_remaining], 0);
+                    code.jg(*loop_head, code.T_NEAR);
+                    code.L(halt);
+                    if constexpr (std::is_same_v<T, IR::Term::LinkBlockFast>) {
+                        this->EmitBlockExit();
+                        this->EmitTerminalImpl(IR::Term::LinkBlock{x.next}, initial_location);
+                        return;
+                    }
+                }
+            }
+            this->EmitBlockExit();
+            this->EmitTerminalImpl(x, initial_location);
         }
     });
 }
@@ -322,12 +450,293 @@ void EmitX64::Unpatch(const IR::LocationDescriptor& desc) {
     Patch(desc, nullptr);
 }
 
+void EmitX64::GenInlineCacheMissHandler() {
+    // Expects the location descriptor of the current location in rbx and the index of the inline cache in r12.
+    const auto update_inline_cache = [](EmitX64* this_, size_t index, u64 location_descriptor, CodePtr target_code_ptr) {
+        this_->UpdateInlineCache(index, IR::LocationDescriptor{location_descriptor}, target_code_ptr);
+    };
+
+    code.align();
+    inline_cache_miss_handler = code.getCurr<const void*>();
+    code.LookupBlock();
+    code.mov(rbp, code.ABI_RETURN);
+    code.mov(code.ABI_PARAM1, reinterpret_cast<u64>(this));
+    code.mov(code.ABI_PARAM2, r12);
+    code.mov(code.ABI_PARAM3, rbx);
+    code.mov(code.ABI_PARAM4, rbp);
+    code.CallFunction(static_cast<void(*)(EmitX64*, size_t, u64, CodePtr)>(update_inline_cache));
+    code.jmp(rbp);
+}
+
+void EmitX64::EmitInlineCache(CodePtr fallback, IR::LocationDescriptor block_location) {
+    // Expects the location descriptor of the current location in rbx.
+    // Each entry compares against a previously seen target and jumps directly to it on a match.
+    // Entries are filled in by UpdateInlineCache on a miss.
+    size_t index;
+    if (free_inline_caches.empty()) {
+        index = inline_caches.size();
+        inline_caches.emplace_back();
+    } else {
+        index = free_inline_caches.back();
+        free_inline_caches.pop_back();
+        inline_caches[index] = InlineCacheInformation{};
+    }
+    block_inline_caches[block_location].push_back(index);
+
+    InlineCacheInformation& info = inline_caches[index];
+    info.location_descriptors.fill(0xFFFF'FFFF'FFFF'FFFFull);
+    info.fallback = fallback;
+
+    info.entrypoint = code.getCurr();
+    code.mov(rax, reinterpret_cast<u64>(info.location_descriptors.data()));
+    for (size_t i = 0; i < INLINE_CACHE_ENTRIES; i++) {
+        Xbyak::Label next;
+        code.cmp(rbx, qword[rax + i * sizeof(u64)]);
+        code.jne(next, code.T_NEAR);
+        info.patch_locations[i] = code.getCurr();
+        EmitPatchJmp(IR::LocationDescriptor{info.location_descriptors[i]});
+        code.L(next);
+    }
+    code.mov(r12, index);
+    code.jmp(inline_cache_miss_handler);
+}
+
+void EmitX64::UpdateInlineCache(size_t index, IR::LocationDescriptor target_desc, CodePtr target_code_ptr) {
+    if (index >= inline_caches.size()) {
+        // The cache was cleared during the lookup.
+        return;
+    }
+
+    InlineCacheInformation& info = inline_caches[index];
+    if (!info.entrypoint) {
+        // The code containing this inline cache was evicted during the lookup.
+        // If the entry has since been reused by a new block, it is updated below instead. This is harmless,
+        // as an entry is only ever filled with a target and the code for that target.
+        return;
+    }
+    info.misses++;
+
+    const CodePtr save_code_ptr = code.getCurr();
+    if (info.entries_used < INLINE_CACHE_ENTRIES) {
+        const size_t entry = info.entries_used++;
+        info.location_descriptors[entry] = target_desc.Value();
+        patch_information[target_desc].jmp.emplace_back(info.patch_locations[entry]);
+        code.SetCodePtr(info.patch_locations[entry]);
+        EmitPatchJmp(target_desc, target_code_ptr);
+    } else if (info.misses == INLINE_CACHE_MISS_LIMIT) {
+        // This site is megamorphic, give up on caching it.
+        code.SetCodePtr(info.entrypoint);
+        code.jmp(info.fallback, code.T_NEAR);
+    }
+    code.SetCodePtr(save_code_ptr);
+}
+
+void EmitX64::ReleaseInlineCaches(IR::LocationDescriptor block_location) {
+    const auto iter = block_inline_caches.find(block_location);
+    if (iter == block_inline_caches.end()) {
+        return;
+    }
+
+    for (const size_t index : iter->second) {
+        InlineCacheInformation& info = inline_caches[index];
+        // Targets must no longer patch the jumps of this cache.
+        for (size_t i = 0; i < info.entries_used; i++) {
+            const auto patch_iter = patch_information.find(IR::LocationDescriptor{info.location_descriptors[i]});
+            if (patch_iter != patch_information.end()) {
+                auto& jmp = patch_iter->second.jmp;
+                jmp.erase(std::remove(jmp.begin(), jmp.end(), info.patch_locations[i]), jmp.end());
+            }
+        }
+        info.entrypoint = nullptr;
+        free_inline_caches.push_back(index);
+    }
+
+    block_inline_caches.erase(iter);
+}
+
+void EmitX64::EmitPageTableSetExclusive(Xbyak::Reg64 vaddr, Xbyak::Reg64 value, size_t bitsize, const VAddrLookup& lookup,
+                                        const std::function<void(Xbyak::Reg64 vaddr)>& mark) {
+    const auto& jsi = code.GetJitStateInfo();
+
+    Xbyak::Label abort, end;
+
+    code.mov(code.byte[r15 + jsi.offsetof_exclusive_state], u8(1));
+    if (jsi.exclusive_address_size == 4) {
+        code.mov(dword[r15 + jsi.offsetof_exclusive_address], vaddr.cvt32());
+    } else {
+        code.mov(qword[r15 + jsi.offsetof_exclusive_address], vaddr);
+    }
+    const Xbyak::RegExp src_ptr = lookup(abort, vaddr, value);
+    switch (bitsize) {
+    case 8:
+        code.movzx(value.cvt32(), code.byte[src_ptr]);
+        break;
+    case 16:
+        code.movzx(value.cvt32(), word[src_ptr]);
+        break;
+    case 32:
+        code.mov(value.cvt32(), dword[src_ptr]);
+        break;
+    case 64:
+        code.mov(value, qword[src_ptr]);
+        break;
+    default:
+        UNREACHABLE();
+    }
+    code.mov(qword[r15 + jsi.offsetof_exclusive_value], value);
+    code.L(end);
+
+    // Memory outside the page table is tracked by the global monitor instead.
+    // The call is made from a local subroutine so that the stack is aligned as for the fallbacks.
+    Xbyak::Label subroutine;
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(subroutine);
+    code.jmp(end, code.T_NEAR);
+    code.L(subroutine);
+    ABI_PushCallerSaveRegistersAndAdjustStack(code);
+    mark(vaddr);
+    ABI_PopCallerSaveRegistersAndAdjustStack(code);
+    code.ret();
+    code.SwitchToNearCode();
+}
+
+void EmitX64::EmitPageTableExclusiveWrite(Xbyak::Reg64 vaddr, Xbyak::Reg64 value, Xbyak::Reg32 passed, Xbyak::Reg64 tmp, size_t bitsize,
+                                          const VAddrLookup& lookup, const std::function<void(Xbyak::Reg64 vaddr, Xbyak::Reg64 value)>& write) {
+    const auto& jsi = code.GetJitStateInfo();
+    // The immediate is sign-extended for 64-bit addresses, so only the low bits of the mask may be clear.
+    ASSERT(jsi.exclusive_address_size == 4 || (jsi.reservation_granule_mask >> 31) == 0x1'FFFF'FFFF);
+    const u32 reservation_granule_mask = static_cast<u32>(jsi.reservation_granule_mask);
+
+    Xbyak::Label abort, end;
+
+    code.mov(passed, u32(1));
+    code.cmp(code.byte[r15 + jsi.offsetof_exclusive_state], u8(0));
+    code.je(end);
+    if (jsi.exclusive_address_size == 4) {
+        code.mov(tmp.cvt32(), vaddr.cvt32());
+        code.xor_(tmp.cvt32(), dword[r15 + jsi.offsetof_exclusive_address]);
+        code.test(tmp.cvt32(), reservation_granule_mask);
+    } else {
+        code.mov(tmp, vaddr);
+        code.xor_(tmp, qword[r15 + jsi.offsetof_exclusive_address]);
+        code.test(tmp, reservation_granule_mask);
+    }
+    code.jne(end);
+    code.mov(code.byte[r15 + jsi.offsetof_exclusive_state], u8(0));
+    const Xbyak::RegExp dest_ptr = lookup(abort, vaddr, tmp);
+    // The store succeeds only if memory still holds the value read when the reservation was made.
+    code.mov(rax, qword[r15 + jsi.offsetof_exclusive_value]);
+    code.lock();
+    switch (bitsize) {
+    case 8:
+        code.cmpxchg(code.byte[dest_ptr], value.cvt8());
+        break;
+    case 16:
+        code.cmpxchg(word[dest_ptr], value.cvt16());
+        break;
+    case 32:
+        code.cmpxchg(dword[dest_ptr], value.cvt32());
+        break;
+    case 64:
+        code.cmpxchg(qword[dest_ptr], value);
+        break;
+    default:
+        UNREACHABLE();
+    }
+    code.setnz(passed.cvt8());
+    code.L(end);
+
+    Xbyak::Label subroutine;
+    code.SwitchToFarCode();
+    code.L(abort);
+    code.call(subroutine);
+    code.jmp(end, code.T_NEAR);
+    code.L(subroutine);
+    ABI_PushCallerSaveRegistersAndAdjustStackExcept(code, HostLocRegIdx(passed.getIdx()));
+    code.mov(rax, value);
+    write(vaddr, rax);
+    code.mov(passed, code.ABI_RETURN.cvt32());
+    ABI_PopCallerSaveRegistersAndAdjustStackExcept(code, HostLocRegIdx(passed.getIdx()));
+    code.ret();
+    code.SwitchToNearCode();
+}
+
+void EmitX64::RegisterFastmemAccess(CodePtr access, void (*fallback)()) {
+    // A call with a 32-bit displacement.
+    constexpr size_t call_size = 5;
+
+    const size_t size = code.getCurr<const u8*>() - static_cast<const u8*>(access);
+    if (size < call_size) {
+        code.nop(call_size - size);
+    }
+    fastmem_patch_information.insert_or_assign(reinterpret_cast<u64>(access), FastmemPatchInformation{fallback, std::max(size, call_size)});
+}
+
+bool EmitX64::BackpatchFastmem(u64 rip) {
+    // This runs in a signal handler. The entry is marked as patched rather than erased, as erasing would free memory.
+    const auto iter = fastmem_patch_information.find(rip);
+    if (iter == fastmem_patch_information.end() || !iter->second.fallback) {
+        return false;
+    }
+    const auto [fallback, size] = iter->second;
+    iter->second.fallback = nullptr;
+
+    const CodePtr save_code_ptr = code.getCurr();
+    code.SetCodePtr(reinterpret_cast<CodePtr>(rip));
+    code.call(fallback);
+    code.nop(size - (code.getCurr<u64>() - rip));
+    code.SetCodePtr(save_code_ptr);
+    return true;
+}
+
 void EmitX64::ClearCache() {
     block_descriptors.clear();
     patch_information.clear();
+    inline_caches.clear();
+    free_inline_caches.clear();
+    block_inline_caches.clear();
+    fastmem_patch_information.clear();
+}
+
+std::vector<IR::LocationDescriptor> EmitX64::AdvanceCodeSegment() {
+    const size_t segment = code.AdvanceSegment();
+    const auto in_segment = [this, segment](CodePtr ptr) { return code.IsInSegment(ptr, segment); };
+
+    std::vector<IR::LocationDescriptor> evicted;
+    for (const auto& [descriptor, block] : block_descriptors) {
+        if (in_segment(block.entrypoint)) {
+            evicted.emplace_back(descriptor);
+        }
+    }
+
+    // Patch locations within the segment are about to be overwritten by new code, forget them.
+    for (auto& [descriptor, patch_info] : patch_information) {
+        for (auto* locations : {&patch_info.jg, &patch_info.jmp, &patch_info.mov_rcx}) {
+            locations->erase(std::remove_if(locations->begin(), locations->end(), in_segment), locations->end());
+        }
+    }
+
+    for (auto iter = fastmem_patch_information.begin(); iter != fastmem_patch_information.end();) {
+        if (in_segment(reinterpret_cast<CodePtr>(iter->first))) {
+            iter = fastmem_patch_information.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+
+    for (const auto& descriptor : evicted) {
+        if (patch_information.count(descriptor)) {
+            Unpatch(descriptor);
+        }
+        ReleaseInlineCaches(descriptor);
+        block_descriptors.erase(descriptor);
+    }
+
+    return evicted;
 }
 
-void EmitX64::InvalidateBasicBlocks(const std::unordered_set<IR::LocationDescriptor>& locations) {
+void EmitX64::InvalidateBasicBlocks(const std::vector<IR::LocationDescriptor>& locations) {
     for (const auto &descriptor : locations) {
         auto it = block_descriptors.find(descriptor);
         if (it == block_descriptors.end()) {
@@ -337,6 +746,7 @@ void EmitX64::InvalidateBasicBlocks(const std::unordered_set<IR::LocationDescrip
         if (patch_information.count(descriptor)) {
             Unpatch(descriptor);
         }
+        ReleaseInlineCaches(descriptor);
         block_descriptors.erase(it);
     }
 }
@@ -7,6 +7,8 @@
 #pragma once
 
 #include <array>
+#include <deque>
+#include <functional>
 #include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
@@ -71,8 +73,12 @@ public:
     /// Empties the entire cache.
     virtual void ClearCache();
 
+    /// Starts emitting into the oldest segment of the code cache, discarding every block previously emitted there.
+    /// @return The locations of the discarded blocks.
+    virtual std::vector<IR::LocationDescriptor> AdvanceCodeSegment();
+
     /// Invalidates a selection of basic blocks.
-    void InvalidateBasicBlocks(const std::unordered_set<IR::LocationDescriptor>& locations);
+    void InvalidateBasicBlocks(const std::vector<IR::LocationDescriptor>& locations);
 
 protected:
     // Microinstruction emitters
@@ -86,10 +92,25 @@ protected:
 
     // Helpers
     void EmitAddCycles(size_t cycles);
-    Xbyak::Label EmitCond(IR::Cond cond);
+    Xbyak::Label EmitCond(IR::Cond cond, Xbyak::CodeGenerator::LabelType type = Xbyak::CodeGenerator::T_AUTO);
     void EmitCondPrelude(const IR::Block& block);
+    /// Code emitter: Switches to the guest MXCSR if any instruction in `block` requires it.
+    /// Blocks without floating-point instructions leave whichever MXCSR is current in place.
+    void EmitMxcsrPrelude(const IR::Block& block);
+    void EmitSideExit(const IR::Block& block, size_t index, Xbyak::Label& exit);
+    /// Code emitter: Counts entries into a block, requesting recompilation once it has been entered `threshold` times.
+    /// @note Must be emitted at the block entrypoint, where no host registers are live.
+    void EmitTierUpCounter(IR::LocationDescriptor location, u32 threshold);
     void PushRSBHelper(Xbyak::Reg64 loc_desc_reg, Xbyak::Reg64 index_reg, IR::LocationDescriptor target);
 
+    // Self-loops
+    /// Returns true if the terminal of `block` may link back to the start of the block.
+    static bool IsSelfLoop(const IR::Block& block);
+    /// Code emitter: Called before any terminal that leaves the current block.
+    virtual void EmitBlockExit() {}
+    /// If set, links to the current block jump here instead of to the block's entrypoint.
+    Xbyak::Label* loop_head = nullptr;
+
     // Terminal instruction emitters
     void EmitTerminal(IR::Terminal terminal, IR::LocationDescriptor initial_location);
     virtual void EmitTerminalImpl(IR::Term::Interpret terminal, IR::LocationDescriptor initial_location) = 0;
@@ -97,6 +118,7 @@ protected:
     virtual void EmitTerminalImpl(IR::Term::LinkBlock terminal, IR::LocationDescriptor initial_location) = 0;
     virtual void EmitTerminalImpl(IR::Term::LinkBlockFast terminal, IR::LocationDescriptor initial_location) = 0;
     virtual void EmitTerminalImpl(IR::Term::PopRSBHint terminal, IR::LocationDescriptor initial_location) = 0;
+    virtual void EmitTerminalImpl(IR::Term::FastDispatchHint terminal, IR::LocationDescriptor initial_location) = 0;
     virtual void EmitTerminalImpl(IR::Term::If terminal, IR::LocationDescriptor initial_location) = 0;
     virtual void EmitTerminalImpl(IR::Term::CheckBit terminal, IR::LocationDescriptor initial_location) = 0;
     virtual void EmitTerminalImpl(IR::Term::CheckHalt terminal, IR::LocationDescriptor initial_location) = 0;
@@ -113,10 +135,62 @@ protected:
     virtual void EmitPatchJmp(const IR::LocationDescriptor& target_desc, CodePtr target_code_ptr = nullptr) = 0;
     virtual void EmitPatchMovRcx(CodePtr target_code_ptr = nullptr) = 0;
 
+    // Inline caches
+    static constexpr size_t INLINE_CACHE_ENTRIES = 2;
+    static constexpr size_t INLINE_CACHE_MISS_LIMIT = 8;
+    struct InlineCacheInformation {
+        std::array<u64, INLINE_CACHE_ENTRIES> location_descriptors;
+        std::array<CodePtr, INLINE_CACHE_ENTRIES> patch_locations;
+        CodePtr entrypoint;  // Overwritten with a jump to fallback when the site degrades; null once freed
+        CodePtr fallback;
+        size_t entries_used = 0;
+        size_t misses = 0;
+    };
+    void GenInlineCacheMissHandler();
+    /// Code emitter: Emits an inline cache at the end of the block at `block_location`.
+    void EmitInlineCache(CodePtr fallback, IR::LocationDescriptor block_location);
+    void UpdateInlineCache(size_t index, IR::LocationDescriptor target_desc, CodePtr target_code_ptr);
+    /// Frees the inline caches of the block at `block_location`, whose code must no longer be reachable.
+    void ReleaseInlineCaches(IR::LocationDescriptor block_location);
+    const void* inline_cache_miss_handler;
+
+    // Exclusive accesses to page table memory with the global monitor, performed as host atomics
+    /// Code emitter: Looks up the host address of `vaddr`, jumping to `abort` if it is not backed by host memory.
+    using VAddrLookup = std::function<Xbyak::RegExp(Xbyak::Label& abort, Xbyak::Reg64 vaddr, Xbyak::Reg64 scratch)>;
+    /// Code emitter: Makes the reservation for the `bitsize`-bit access at `vaddr`, recording the value in memory.
+    /// Memory outside the page table is marked in the global monitor instead, by a call emitted by `mark`.
+    void EmitPageTableSetExclusive(Xbyak::Reg64 vaddr, Xbyak::Reg64 value, size_t bitsize, const VAddrLookup& lookup,
+                                   const std::function<void(Xbyak::Reg64 vaddr)>& mark);
+    /// Code emitter: Stores `value` at `vaddr` if the reservation is held and memory still holds the recorded value.
+    /// Sets `passed` to 0 if the store was performed, 1 otherwise. Expects RAX to be reserved by the caller.
+    /// Memory outside the page table is written through the global monitor instead, by a call emitted by `write`,
+    /// which receives the value in RAX and must return the same result.
+    void EmitPageTableExclusiveWrite(Xbyak::Reg64 vaddr, Xbyak::Reg64 value, Xbyak::Reg32 passed, Xbyak::Reg64 tmp, size_t bitsize,
+                                     const VAddrLookup& lookup, const std::function<void(Xbyak::Reg64 vaddr, Xbyak::Reg64 value)>& write);
+
+    // Fastmem
+    struct FastmemPatchInformation {
+        void (*fallback)();  // Thunk performing the access through the memory callbacks, nullptr once patched
+        size_t size;         // Bytes available for the call to fallback
+    };
+    /// Code emitter: Records the memory access emitted at `access` as one that may fault, padding it so that it can
+    /// later be rewritten into a call to `fallback`. Must be called immediately after emitting the access.
+    void RegisterFastmemAccess(CodePtr access, void (*fallback)());
+    /// Called when the instruction at `rip` faults. If it is a fastmem access, rewrites it into a call to its fallback.
+    /// Called from a signal handler, so does not allocate or free memory.
+    /// @return true if the instruction was rewritten and may be retried.
+    bool BackpatchFastmem(u64 rip);
+
     // State
     BlockOfCode& code;
     std::unordered_map<IR::LocationDescriptor, BlockDescriptor> block_descriptors;
     std::unordered_map<IR::LocationDescriptor, PatchInformation> patch_information;
+    std::deque<InlineCacheInformation> inline_caches;
+    /// Indices into inline_caches of entries that have been freed and may be reused.
+    std::vector<size_t> free_inline_caches;
+    /// Block -> indices into inline_caches of the inline caches emitted in it.
+    std::unordered_map<IR::LocationDescriptor, std::vector<size_t>> block_inline_caches;
+    std::unordered_map<u64, FastmemPatchInformation> fastmem_patch_information;
 };
 
 } // namespace Dynarmic::BackendX64
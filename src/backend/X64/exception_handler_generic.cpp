@@ -4,6 +4,9 @@
  * General Public License version 2 or any later version.
  */
 
+#include <utility>
+
+#include "backend/x64/write_watcher.h"
 #include "backend_x64/block_of_code.h"
 
 namespace Dynarmic::BackendX64 {
@@ -18,4 +21,35 @@ void BlockOfCode::ExceptionHandler::Register(BlockOfCode&) {
     // Do nothing
 }
 
+bool BlockOfCode::ExceptionHandler::SupportsFastmem() const {
+    return false;
+}
+
+void BlockOfCode::ExceptionHandler::SetFastmemCallback(FastmemCallback, void*) {
+    // Do nothing
+}
+
+WriteWatcher::WriteWatcher(WriteCallback callback) : callback(std::move(callback)) {}
+WriteWatcher::~WriteWatcher() = default;
+
+bool WriteWatcher::IsSupported() {
+    return false;
+}
+
+size_t WriteWatcher::PageSize() {
+    return 4096;
+}
+
+void WriteWatcher::Watch(u64) {
+    // Do nothing
+}
+
+void WriteWatcher::UnwatchAll() {
+    // Do nothing
+}
+
+std::vector<u64> WriteWatcher::TakeWrittenPages() {
+    return {};
+}
+
 } // namespace Dynarmic::BackendX64
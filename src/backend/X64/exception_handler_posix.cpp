@@ -0,0 +1,483 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach/mach.h>
+#include <mach/mach_vm.h>
+#include <sys/ucontext.h>
+#else
+#include <ucontext.h>
+#endif
+
+#include "backend/x64/block_of_code.h"
+#include "backend/x64/write_watcher.h"
+#include "common/assert.h"
+#include "common/common_types.h"
+
+namespace Dynarmic::BackendX64 {
+
+namespace {
+
+struct CodeBlockInfo {
+    u64 code_begin;
+    u64 code_end;
+    BlockOfCode::FastmemCallback fastmem_callback;
+    void* fastmem_callback_arg;
+};
+
+/**
+ * A host page watched by one or more WriteWatchers. Its address is stable, so the fault handler can update it
+ * without allocating. It is freed only after it has been removed from the watched page table.
+ */
+struct WatchedPage {
+    static constexpr size_t max_watchers = 16;
+
+    WatchedPage(u64 page, int original_protection) : page(page), original_protection(original_protection) {}
+
+    const u64 page;
+    /// Protection of the page before it was first watched, restored when it is written to or no longer watched.
+    const int original_protection;
+    /// Set while the page is write-protected. Whoever clears it makes the page writable again.
+    std::atomic<bool> is_protected{false};
+    std::array<std::atomic<WriteWatcher*>, max_watchers> watchers{};
+    /// Set for each slot of watchers when the page is written to, until the watcher takes the write.
+    std::array<std::atomic<bool>, max_watchers> written{};
+
+    bool HasWatchers() const {
+        return std::any_of(watchers.begin(), watchers.end(), [](const auto& watcher) { return watcher.load() != nullptr; });
+    }
+};
+
+struct WatchedPageInfo {
+    u64 page;
+    WatchedPage* watched_page;
+};
+
+/**
+ * A table that is replaced as a whole by writers and read without taking locks, so that it can be read from a
+ * signal handler. Writers must be serialised by the caller. A replaced table is freed once no reader is using it.
+ */
+template <typename T>
+class PublishedTable final {
+public:
+    PublishedTable() = default;
+    ~PublishedTable() { delete current.load(); }
+
+    PublishedTable(const PublishedTable&) = delete;
+    PublishedTable& operator=(const PublishedTable&) = delete;
+
+    /// Returns the result of calling fn with the current table. Safe to call from a signal handler.
+    template <typename Fn>
+    bool Read(Fn fn) const {
+        readers.fetch_add(1);
+        const bool result = fn(*current.load());
+        readers.fetch_sub(1);
+        return result;
+    }
+
+    /// Returns the current table. Only for use by writers.
+    const std::vector<T>& Get() const {
+        return *current.load();
+    }
+
+    /// Replaces the current table, waiting until no reader is using the old one before freeing it.
+    void Publish(std::vector<T> table) {
+        const std::vector<T>* old = current.exchange(new std::vector<T>(std::move(table)));
+        WaitForReaders();
+        delete old;
+    }
+
+    /// Waits until no reader is using a table published before this call.
+    void WaitForReaders() const {
+        while (readers.load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+
+private:
+    std::atomic<const std::vector<T>*> current{new std::vector<T>()};
+    mutable std::atomic<size_t> readers{0};
+};
+
+u64 GetRip(void* raw_context) {
+#if defined(__APPLE__)
+    return static_cast<ucontext_t*>(raw_context)->uc_mcontext->__ss.__rip;
+#elif defined(__FreeBSD__)
+    return static_cast<ucontext_t*>(raw_context)->uc_mcontext.mc_rip;
+#else
+    return static_cast<ucontext_t*>(raw_context)->uc_mcontext.gregs[REG_RIP];
+#endif
+}
+
+#if defined(__linux__)
+/// A range of host memory with the same protection.
+struct MappingInfo {
+    u64 begin;
+    u64 end;
+    int protection;
+};
+
+/// Returns the host memory mappings listed in /proc/self/maps, sorted by address.
+std::vector<MappingInfo> ReadMappings() {
+    std::vector<MappingInfo> mappings;
+    std::ifstream maps{"/proc/self/maps"};
+    std::string line;
+    while (std::getline(maps, line)) {
+        unsigned long long begin, end;
+        char permissions[5];
+        if (std::sscanf(line.c_str(), "%llx-%llx %4s", &begin, &end, permissions) != 3) {
+            continue;
+        }
+        int protection = PROT_NONE;
+        protection |= permissions[0] == 'r' ? PROT_READ : 0;
+        protection |= permissions[1] == 'w' ? PROT_WRITE : 0;
+        protection |= permissions[2] == 'x' ? PROT_EXEC : 0;
+        mappings.push_back(MappingInfo{begin, end, protection});
+    }
+    return mappings;
+}
+#else
+/// Returns the current protection of the host page containing address, or PROT_NONE if it is not mapped.
+int GetProtection(u64 address) {
+#if defined(__APPLE__)
+    mach_vm_address_t region_address = address;
+    mach_vm_size_t region_size = 0;
+    vm_region_basic_info_data_64_t region_info;
+    mach_msg_type_number_t count = VM_REGION_BASIC_INFO_COUNT_64;
+    mach_port_t object_name;
+    if (mach_vm_region(mach_task_self(), &region_address, &region_size, VM_REGION_BASIC_INFO_64, reinterpret_cast<vm_region_info_t>(&region_info), &count, &object_name) != KERN_SUCCESS || region_address > address) {
+        return PROT_NONE;
+    }
+    int protection = PROT_NONE;
+    protection |= (region_info.protection & VM_PROT_READ) ? PROT_READ : 0;
+    protection |= (region_info.protection & VM_PROT_WRITE) ? PROT_WRITE : 0;
+    protection |= (region_info.protection & VM_PROT_EXECUTE) ? PROT_EXEC : 0;
+    return protection;
+#else
+    // The protection cannot be queried here, so the page is taken to be readable and writable as Watch requires.
+    return PROT_READ | PROT_WRITE;
+#endif
+}
+#endif
+
+/// Process-wide handler for faults in emitted code and writes to watched pages. Other faults are passed on to the previously installed handler.
+class SigHandler final {
+public:
+    SigHandler() {
+        struct sigaction sa;
+        sa.sa_sigaction = &SigHandler::SigAction;
+        sa.sa_flags = SA_SIGINFO | SA_ONSTACK | SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        ASSERT_MSG(sigaction(SIGSEGV, &sa, &old_sa_segv) == 0, "Unable to install SIGSEGV handler");
+        ASSERT_MSG(sigaction(SIGBUS, &sa, &old_sa_bus) == 0, "Unable to install SIGBUS handler");
+    }
+
+    void AddCodeBlock(u64 code_begin, u64 code_end) {
+        std::lock_guard lock{code_blocks_mutex};
+        std::vector<CodeBlockInfo> table = code_blocks.Get();
+        const auto iter = std::upper_bound(table.begin(), table.end(), code_begin, [](u64 begin, const CodeBlockInfo& info) { return begin < info.code_begin; });
+        table.insert(iter, CodeBlockInfo{code_begin, code_end, nullptr, nullptr});
+        code_blocks.Publish(std::move(table));
+    }
+
+    void RemoveCodeBlock(u64 code_begin) {
+        std::lock_guard lock{code_blocks_mutex};
+        std::vector<CodeBlockInfo> table = code_blocks.Get();
+        table.erase(std::remove_if(table.begin(), table.end(), [&](const CodeBlockInfo& info) { return info.code_begin == code_begin; }), table.end());
+        code_blocks.Publish(std::move(table));
+    }
+
+    void SetFastmemCallback(u64 code_begin, BlockOfCode::FastmemCallback cb, void* arg) {
+        std::lock_guard lock{code_blocks_mutex};
+        std::vector<CodeBlockInfo> table = code_blocks.Get();
+        for (auto& info : table) {
+            if (info.code_begin == code_begin) {
+                info.fastmem_callback = cb;
+                info.fastmem_callback_arg = arg;
+            }
+        }
+        code_blocks.Publish(std::move(table));
+    }
+
+    void Watch(WriteWatcher* watcher, u64 page) {
+        std::lock_guard lock{watched_pages_mutex};
+        WatchedPage* watched_page = FindWatchedPage(page);
+        if (!watched_page) {
+            const int protection = GetPageProtection(page);
+            if (!(protection & PROT_WRITE)) {
+                // The page cannot be written to, so there is nothing to watch.
+                return;
+            }
+            watched_page = new WatchedPage{page, protection};
+            std::vector<WatchedPageInfo> table = watched_pages.Get();
+            const auto iter = std::upper_bound(table.begin(), table.end(), page, [](u64 page, const WatchedPageInfo& info) { return page < info.page; });
+            table.insert(iter, WatchedPageInfo{page, watched_page});
+            watched_pages.Publish(std::move(table));
+        }
+
+        auto& watchers = watched_page->watchers;
+        if (std::find(watchers.begin(), watchers.end(), watcher) == watchers.end()) {
+            const auto slot = std::find(watchers.begin(), watchers.end(), nullptr);
+            ASSERT_MSG(slot != watchers.end(), "Too many WriteWatchers are watching the same page");
+            watched_page->written[slot - watchers.begin()].store(false);
+            slot->store(watcher);
+        }
+
+        if (!watched_page->is_protected.load()) {
+            ASSERT_MSG(mprotect(reinterpret_cast<void*>(page), page_size, watched_page->original_protection & ~PROT_WRITE) == 0, "Unable to write-protect page");
+            watched_page->is_protected.store(true);
+        }
+    }
+
+    void UnwatchAll(WriteWatcher* watcher) {
+        RemoveWatcher(watcher, false);
+        // A fault handler that has already loaded watcher may still be calling its callback.
+        watched_pages.WaitForReaders();
+    }
+
+    std::vector<u64> TakeWrittenPages(WriteWatcher* watcher) {
+        return RemoveWatcher(watcher, true);
+    }
+
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+private:
+    static void SigAction(int sig, siginfo_t* info, void* raw_context);
+
+    bool HandleFault(u64 rip, u64 fault_address) {
+        // Writes to watched pages are checked first, as they may come from fastmem accesses which must not be backpatched.
+        const bool is_watched = watched_pages.Read([this, fault_address](const std::vector<WatchedPageInfo>& table) {
+            const u64 page = fault_address & ~u64(page_size - 1);
+            const auto iter = std::lower_bound(table.begin(), table.end(), page, [](const WatchedPageInfo& info, u64 page) { return info.page < page; });
+            if (iter == table.end() || iter->page != page) {
+                return false;
+            }
+
+            // Only atomics are updated here: the handler may have interrupted a thread holding any lock.
+            // If is_protected is already clear, another thread is making the page writable and the write is retried.
+            WatchedPage& watched_page = *iter->watched_page;
+            if (watched_page.is_protected.exchange(false)) {
+                ASSERT_MSG(mprotect(reinterpret_cast<void*>(page), page_size, watched_page.original_protection) == 0, "Unable to unprotect page");
+                for (size_t slot = 0; slot < WatchedPage::max_watchers; slot++) {
+                    if (WriteWatcher* const watcher = watched_page.watchers[slot].load()) {
+                        watched_page.written[slot].store(true);
+                        watcher->callback(page);
+                    }
+                }
+            }
+            return true;
+        });
+        if (is_watched) {
+            return true;
+        }
+
+        return code_blocks.Read([rip](const std::vector<CodeBlockInfo>& table) {
+            const auto iter = std::upper_bound(table.begin(), table.end(), rip, [](u64 rip, const CodeBlockInfo& info) { return rip < info.code_begin; });
+            if (iter == table.begin()) {
+                return false;
+            }
+            const CodeBlockInfo& info = *std::prev(iter);
+            return rip < info.code_end && info.fastmem_callback && info.fastmem_callback(info.fastmem_callback_arg, rip);
+        });
+    }
+
+    /// Code blocks sorted by code_begin. Looked up without locking when a fault occurs.
+    PublishedTable<CodeBlockInfo> code_blocks;
+    /// Serialises changes to code_blocks.
+    std::mutex code_blocks_mutex;
+
+    /// Returns the current protection of the host page containing address, or PROT_NONE if it is not mapped.
+    /// Must be called with watched_pages_mutex held.
+    int GetPageProtection(u64 address) {
+#if defined(__linux__)
+        // Reading /proc/self/maps is slow, so it is only read again for addresses outside every cached mapping.
+        const auto find = [this, address] {
+            const auto iter = std::upper_bound(mappings.begin(), mappings.end(), address, [](u64 address, const MappingInfo& info) { return address < info.begin; });
+            return iter != mappings.begin() && address < std::prev(iter)->end ? std::prev(iter) : mappings.end();
+        };
+        auto iter = find();
+        if (iter == mappings.end()) {
+            mappings = ReadMappings();
+            iter = find();
+        }
+        return iter != mappings.end() ? iter->protection : PROT_NONE;
+#else
+        return GetProtection(address);
+#endif
+    }
+
+    WatchedPage* FindWatchedPage(u64 page) const {
+        const auto& table = watched_pages.Get();
+        const auto iter = std::lower_bound(table.begin(), table.end(), page, [](const WatchedPageInfo& info, u64 page) { return info.page < page; });
+        return iter != table.end() && iter->page == page ? iter->watched_page : nullptr;
+    }
+
+    /**
+     * Removes watcher from every watched page, or only from those written to if only_written is set, and returns
+     * the pages it was removed from that have been written to. Pages no longer watched by any WriteWatcher are
+     * given back their original protection.
+     */
+    std::vector<u64> RemoveWatcher(WriteWatcher* watcher, bool only_written) {
+        std::lock_guard lock{watched_pages_mutex};
+#if defined(__linux__)
+        if (!only_written) {
+            // Host memory may have been remapped since its mappings were cached.
+            mappings.clear();
+        }
+#endif
+        std::vector<u64> written_pages;
+        std::vector<WatchedPage*> unwatched_pages;
+        for (const WatchedPageInfo& info : watched_pages.Get()) {
+            WatchedPage& watched_page = *info.watched_page;
+            for (size_t slot = 0; slot < WatchedPage::max_watchers; slot++) {
+                if (watched_page.watchers[slot].load() != watcher) {
+                    continue;
+                }
+                const bool written = watched_page.written[slot].load();
+                if (only_written && !written) {
+                    continue;
+                }
+                if (written) {
+                    written_pages.push_back(info.page);
+                }
+                watched_page.watchers[slot].store(nullptr);
+                watched_page.written[slot].store(false);
+            }
+            if (watched_page.HasWatchers()) {
+                continue;
+            }
+            if (watched_page.is_protected.exchange(false)) {
+                // This fails harmlessly if the page has since been unmapped.
+                mprotect(reinterpret_cast<void*>(info.page), page_size, watched_page.original_protection);
+            }
+            unwatched_pages.push_back(&watched_page);
+        }
+
+        if (!unwatched_pages.empty()) {
+            std::vector<WatchedPageInfo> table = watched_pages.Get();
+            table.erase(std::remove_if(table.begin(), table.end(), [&](const WatchedPageInfo& info) {
+                return std::find(unwatched_pages.begin(), unwatched_pages.end(), info.watched_page) != unwatched_pages.end();
+            }), table.end());
+            watched_pages.Publish(std::move(table));
+            for (WatchedPage* watched_page : unwatched_pages) {
+                delete watched_page;
+            }
+        }
+        return written_pages;
+    }
+
+    /// Watched pages sorted by page. Looked up without locking when a fault occurs.
+    PublishedTable<WatchedPageInfo> watched_pages;
+    /// Serialises changes to watched_pages and to the watchers of each WatchedPage.
+    std::mutex watched_pages_mutex;
+#if defined(__linux__)
+    /// Host memory mappings cached by GetPageProtection. Guarded by watched_pages_mutex.
+    std::vector<MappingInfo> mappings;
+#endif
+    struct sigaction old_sa_segv;
+    struct sigaction old_sa_bus;
+};
+
+SigHandler& GetSigHandler() {
+    static SigHandler sig_handler;
+    return sig_handler;
+}
+
+void SigHandler::SigAction(int sig, siginfo_t* info, void* raw_context) {
+    ASSERT(sig == SIGSEGV || sig == SIGBUS);
+
+    SigHandler& handler = GetSigHandler();
+    if (handler.HandleFault(GetRip(raw_context), reinterpret_cast<u64>(info->si_addr))) {
+        // The faulting instruction has been rewritten or the page made writable, execution resumes by retrying it.
+        return;
+    }
+
+    const struct sigaction& retry_sa = sig == SIGSEGV ? handler.old_sa_segv : handler.old_sa_bus;
+    if (retry_sa.sa_flags & SA_SIGINFO) {
+        retry_sa.sa_sigaction(sig, info, raw_context);
+        return;
+    }
+    if (retry_sa.sa_handler == SIG_DFL) {
+        // The fault recurs on return and is then handled by the default action.
+        signal(sig, SIG_DFL);
+        return;
+    }
+    if (retry_sa.sa_handler == SIG_IGN) {
+        return;
+    }
+    retry_sa.sa_handler(sig);
+}
+
+} // anonymous namespace
+
+struct BlockOfCode::ExceptionHandler::Impl final {
+    u64 code_begin;
+};
+
+BlockOfCode::ExceptionHandler::ExceptionHandler() = default;
+
+BlockOfCode::ExceptionHandler::~ExceptionHandler() {
+    if (impl) {
+        GetSigHandler().RemoveCodeBlock(impl->code_begin);
+    }
+}
+
+void BlockOfCode::ExceptionHandler::Register(BlockOfCode& code) {
+    impl = std::make_unique<Impl>();
+    impl->code_begin = reinterpret_cast<u64>(code.getCode());
+    GetSigHandler().AddCodeBlock(impl->code_begin, impl->code_begin + code.maxSize_);
+}
+
+bool BlockOfCode::ExceptionHandler::SupportsFastmem() const {
+    return true;
+}
+
+void BlockOfCode::ExceptionHandler::SetFastmemCallback(FastmemCallback cb, void* arg) {
+    GetSigHandler().SetFastmemCallback(impl->code_begin, cb, arg);
+}
+
+WriteWatcher::WriteWatcher(WriteCallback callback) : callback(std::move(callback)) {}
+
+WriteWatcher::~WriteWatcher() {
+    UnwatchAll();
+}
+
+bool WriteWatcher::IsSupported() {
+    return true;
+}
+
+size_t WriteWatcher::PageSize() {
+    return GetSigHandler().page_size;
+}
+
+void WriteWatcher::Watch(u64 host_page) {
+    GetSigHandler().Watch(this, host_page);
+}
+
+void WriteWatcher::UnwatchAll() {
+    GetSigHandler().UnwatchAll(this);
+}
+
+std::vector<u64> WriteWatcher::TakeWrittenPages() {
+    return GetSigHandler().TakeWrittenPages(this);
+}
+
+} // namespace Dynarmic::BackendX64
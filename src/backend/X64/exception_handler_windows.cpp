@@ -5,12 +5,14 @@
  */
 
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
 #include "backend/x64/block_of_code.h"
+#include "backend/x64/write_watcher.h"
 #include "common/assert.h"
 #include "common/common_types.h"
 
@@ -198,5 +200,36 @@ void BlockOfCode::ExceptionHandler::Register(BlockOfCode& code) {
     impl = std::make_unique<Impl>(rfuncs, code.getCode());
 }
 
+bool BlockOfCode::ExceptionHandler::SupportsFastmem() const {
+    return false;
+}
+
+void BlockOfCode::ExceptionHandler::SetFastmemCallback(FastmemCallback, void*) {
+    // Do nothing
+}
+
+WriteWatcher::WriteWatcher(WriteCallback callback) : callback(std::move(callback)) {}
+WriteWatcher::~WriteWatcher() = default;
+
+bool WriteWatcher::IsSupported() {
+    return false;
+}
+
+size_t WriteWatcher::PageSize() {
+    return 4096;
+}
+
+void WriteWatcher::Watch(u64) {
+    // Do nothing
+}
+
+void WriteWatcher::UnwatchAll() {
+    // Do nothing
+}
+
+std::vector<u64> WriteWatcher::TakeWrittenPages() {
+    return {};
+}
+
 } // namespace BackendX64
 } // namespace Dynarmic
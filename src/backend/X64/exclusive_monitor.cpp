@@ -0,0 +1,82 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include <immintrin.h>
+
+#include <dynarmic/exclusive_monitor.h>
+#include "common/assert.h"
+#include "common/bit_util.h"
+#include "common/common_types.h"
+
+namespace Dynarmic {
+
+ExclusiveMonitor::ExclusiveMonitor(size_t processor_count)
+    : reservations(processor_count)
+    , locks(size_t(1) << (Common::HighestSetBit(processor_count * LOCKS_PER_PROCESSOR - 1) + 1))
+{}
+
+size_t ExclusiveMonitor::GetProcessorCount() const {
+    return reservations.size();
+}
+
+void ExclusiveMonitor::Mark(size_t processor_id, u64 address, size_t size) {
+    ASSERT(size <= 16);
+    const u64 masked_address = address & RESERVATION_GRANULE_MASK;
+
+    reservations[processor_id].address.store(masked_address);
+}
+
+std::atomic<bool>& ExclusiveMonitor::LockFor(u64 masked_address) {
+    return locks[(masked_address >> 4) & (locks.size() - 1)].is_locked;
+}
+
+bool ExclusiveMonitor::CheckAndLock(size_t processor_id, u64 address, size_t size) {
+    ASSERT(size <= 16);
+    const u64 masked_address = address & RESERVATION_GRANULE_MASK;
+    std::atomic<u64>& reservation = reservations[processor_id].address;
+
+    // Fail without touching the lock if the reservation has already been lost.
+    if (reservation.load() != masked_address) {
+        return false;
+    }
+
+    std::atomic<bool>& lock = LockFor(masked_address);
+    while (lock.exchange(true, std::memory_order_acquire)) {
+        // Wait on a plain load so that waiting processors share the cache line until the lock is released.
+        while (lock.load(std::memory_order_relaxed)) {
+            _mm_pause();
+        }
+    }
+
+    // Another processor may have completed an exclusive operation on this granule in the meantime.
+    if (reservation.load() != masked_address) {
+        lock.store(false, std::memory_order_release);
+        return false;
+    }
+    return true;
+}
+
+void ExclusiveMonitor::ClearAndUnlock(u64 address) {
+    const u64 masked_address = address & RESERVATION_GRANULE_MASK;
+
+    // Reservations are cleared after the operation so that one made while it was in progress is also lost.
+    for (Reservation& other : reservations) {
+        u64 expected = masked_address;
+        if (other.address.load() == expected) {
+            other.address.compare_exchange_strong(expected, INVALID_EXCLUSIVE_ADDRESS);
+        }
+    }
+
+    LockFor(masked_address).store(false, std::memory_order_release);
+}
+
+void ExclusiveMonitor::Clear() {
+    for (Reservation& reservation : reservations) {
+        reservation.address.store(INVALID_EXCLUSIVE_ADDRESS);
+    }
+}
+
+} // namespace Dynarmic
@@ -14,15 +14,26 @@ namespace Dynarmic::BackendX64 {
 
 struct JitStateInfo {
     template <typename JitStateType>
-    JitStateInfo(const JitStateType&)
+    JitStateInfo(const JitStateType&, size_t rsb_size)
         : offsetof_cycles_remaining(offsetof(JitStateType, cycles_remaining))
         , offsetof_cycles_to_run(offsetof(JitStateType, cycles_to_run))
+        , offsetof_halt_requested(offsetof(JitStateType, halt_requested))
         , offsetof_save_host_MXCSR(offsetof(JitStateType, save_host_MXCSR))
         , offsetof_guest_MXCSR(offsetof(JitStateType, guest_MXCSR))
+        , offsetof_guest_MXCSR_live(offsetof(JitStateType, guest_MXCSR_live))
         , offsetof_rsb_ptr(offsetof(JitStateType, rsb_ptr))
-        , rsb_ptr_mask(JitStateType::RSBPtrMask)
-        , offsetof_rsb_location_descriptors(offsetof(JitStateType, rsb_location_descriptors))
-        , offsetof_rsb_codeptrs(offsetof(JitStateType, rsb_codeptrs))
+        , rsb_ptr_mask((rsb_size - 1) * sizeof(typename JitStateType::RSBEntry))
+        , rsb_entry_size(sizeof(typename JitStateType::RSBEntry))
+        , offsetof_rsb_location_descriptor(offsetof(JitStateType, rsb) + offsetof(typename JitStateType::RSBEntry, location_descriptor))
+        , offsetof_rsb_code_ptr(offsetof(JitStateType, rsb) + offsetof(typename JitStateType::RSBEntry, code_ptr))
+        , offsetof_rsb_hits(offsetof(JitStateType, rsb_hits))
+        , offsetof_rsb_misses(offsetof(JitStateType, rsb_misses))
+        , offsetof_mxcsr_accesses(offsetof(JitStateType, mxcsr_accesses))
+        , offsetof_exclusive_state(offsetof(JitStateType, exclusive_state))
+        , offsetof_exclusive_address(offsetof(JitStateType, exclusive_address))
+        , exclusive_address_size(sizeof(JitStateType::exclusive_address))
+        , offsetof_exclusive_value(offsetof(JitStateType, exclusive_value))
+        , reservation_granule_mask(JitStateType::RESERVATION_GRANULE_MASK)
         , offsetof_CPSR_nzcv(offsetof(JitStateType, CPSR_nzcv))
         , offsetof_FPSCR_IDC(offsetof(JitStateType, FPSCR_IDC))
         , offsetof_FPSCR_UFC(offsetof(JitStateType, FPSCR_UFC))
@@ -32,12 +43,23 @@ struct JitStateInfo {
 
     const size_t offsetof_cycles_remaining;
     const size_t offsetof_cycles_to_run;
+    const size_t offsetof_halt_requested;
     const size_t offsetof_save_host_MXCSR;
     const size_t offsetof_guest_MXCSR;
+    const size_t offsetof_guest_MXCSR_live;
     const size_t offsetof_rsb_ptr;
     const size_t rsb_ptr_mask;
-    const size_t offsetof_rsb_location_descriptors;
-    const size_t offsetof_rsb_codeptrs;
+    const size_t rsb_entry_size;
+    const size_t offsetof_rsb_location_descriptor;
+    const size_t offsetof_rsb_code_ptr;
+    const size_t offsetof_rsb_hits;
+    const size_t offsetof_rsb_misses;
+    const size_t offsetof_mxcsr_accesses;
+    const size_t offsetof_exclusive_state;
+    const size_t offsetof_exclusive_address;
+    const size_t exclusive_address_size;
+    const size_t offsetof_exclusive_value;
+    const u64 reservation_granule_mask;
     const size_t offsetof_CPSR_nzcv;
     const size_t offsetof_FPSCR_IDC;
     const size_t offsetof_FPSCR_UFC;
@@ -397,6 +397,11 @@ void RegAlloc::HostCall(IR::Inst* result_def, boost::optional<Argument&> arg0, b
     }
 }
 
+void RegAlloc::ReserveGpr(HostLoc loc) {
+    ASSERT(HostLocIsGPR(loc) && LocInfo(loc).IsEmpty());
+    reserved_locations.push_back(loc);
+}
+
 void RegAlloc::EndOfAllocScope() {
     for (auto& iter : hostloc_info) {
         iter.EndOfAllocScope();
@@ -412,7 +417,7 @@ HostLoc RegAlloc::SelectARegister(HostLocList desired_locations) const {
 
     // Find all locations that have not been allocated..
     auto allocated_locs = std::partition(candidates.begin(), candidates.end(), [this](auto loc){
-        return !this->LocInfo(loc).IsLocked();
+        return !this->LocInfo(loc).IsLocked() && std::find(reserved_locations.begin(), reserved_locations.end(), loc) == reserved_locations.end();
     });
     candidates.erase(allocated_locs, candidates.end());
     ASSERT_MSG(!candidates.empty(), "All candidate registers have already been allocated");
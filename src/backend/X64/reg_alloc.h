@@ -115,6 +115,9 @@ public:
 
     // TODO: Values in host flags
 
+    /// Removes an empty register from the pool of allocatable registers for the rest of the block.
+    void ReserveGpr(HostLoc loc);
+
     void EndOfAllocScope();
 
     void AssertNoMoreUses();
@@ -141,6 +144,7 @@ private:
     HostLoc FindFreeSpill() const;
 
     std::vector<HostLocInfo> hostloc_info;
+    std::vector<HostLoc> reserved_locations;
     HostLocInfo& LocInfo(HostLoc loc);
     const HostLocInfo& LocInfo(HostLoc loc) const;
 
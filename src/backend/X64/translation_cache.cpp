@@ -0,0 +1,182 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+
+#include "backend/x64/translation_cache.h"
+#include "common/fnv1a.h"
+#include "frontend/ir/block_serialization.h"
+
+namespace Dynarmic::BackendX64 {
+
+namespace {
+
+constexpr u64 file_magic = 0x4548434143525444; // "DTRCACHE"
+
+template <typename T>
+void Append(std::vector<u8>& data, T value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    const size_t offset = data.size();
+    data.resize(offset + sizeof(T));
+    std::memcpy(data.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+bool Extract(const std::vector<u8>& data, size_t& offset, T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (offset > data.size() || data.size() - offset < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+
+} // anonymous namespace
+
+TranslationCache::TranslationCache(const std::string& path, std::initializer_list<u64> config_values) {
+    Common::FNV1a hasher;
+    hasher.Mix(IR::SerializationFormatVersion());
+    for (u64 value : config_values) {
+        hasher.Mix(value);
+    }
+    fingerprint = hasher.Value();
+
+    ReadFile(path);
+}
+
+void TranslationCache::ReadFile(const std::string& path) {
+    std::vector<u8> contents;
+    {
+        std::ifstream in{path, std::ios::binary};
+        contents.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    }
+
+    // Find the longest prefix of the file that is intact.
+    size_t valid_size = 0;
+    u64 magic, file_fingerprint;
+    size_t offset = 0;
+    if (Extract(contents, offset, magic) && Extract(contents, offset, file_fingerprint) && magic == file_magic && file_fingerprint == fingerprint) {
+        valid_size = offset;
+
+        u32 record_size;
+        while (Extract(contents, offset, record_size) && contents.size() - offset >= record_size + sizeof(u64)) {
+            const std::vector<u8> record(contents.begin() + offset, contents.begin() + offset + record_size);
+            offset += record_size;
+
+            u64 checksum;
+            Common::FNV1a hasher;
+            hasher.Mix(record.data(), record.size());
+            if (!Extract(contents, offset, checksum) || hasher.Value() != checksum || !ParseRecord(record)) {
+                break;
+            }
+            valid_size = offset;
+        }
+    }
+
+    if (valid_size != 0 && valid_size == contents.size()) {
+        file.open(path, std::ios::binary | std::ios::app);
+        return;
+    }
+
+    // Stale or damaged file: rewrite it with whatever remains usable.
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (valid_size == 0) {
+        std::vector<u8> header;
+        Append(header, file_magic);
+        Append(header, fingerprint);
+        file.write(reinterpret_cast<const char*>(header.data()), header.size());
+    } else {
+        file.write(reinterpret_cast<const char*>(contents.data()), valid_size);
+    }
+    file.flush();
+}
+
+bool TranslationCache::ParseRecord(const std::vector<u8>& record) {
+    size_t offset = 0;
+    u64 location;
+    u8 variant;
+    u32 address_count;
+    Entry entry;
+    if (!Extract(record, offset, location) || !Extract(record, offset, variant) || !Extract(record, offset, entry.code_hash) || !Extract(record, offset, address_count)) {
+        return false;
+    }
+    if ((record.size() - offset) / sizeof(u64) < address_count) {
+        return false;
+    }
+
+    entry.code_addresses.resize(address_count);
+    for (u64& address : entry.code_addresses) {
+        Extract(record, offset, address);
+    }
+    entry.block_data.assign(record.begin() + offset, record.end());
+
+    entries.insert_or_assign(Key{IR::LocationDescriptor{location}, variant}, std::move(entry));
+    return true;
+}
+
+boost::optional<IR::Block> TranslationCache::Load(IR::LocationDescriptor location, u8 variant, const ReadCodeFn& read_code) {
+    std::lock_guard lock{mutex};
+
+    const auto iter = entries.find(Key{location, variant});
+    if (iter == entries.end()) {
+        return boost::none;
+    }
+
+    Common::FNV1a hasher;
+    for (u64 vaddr : iter->second.code_addresses) {
+        hasher.Mix(vaddr);
+        hasher.Mix(read_code(vaddr));
+    }
+
+    boost::optional<IR::Block> block{IR::Block{location}};
+    if (hasher.Value() != iter->second.code_hash || !IR::DeserializeBlock(iter->second.block_data, *block)) {
+        // Guest code has changed since this block was stored.
+        entries.erase(iter);
+        return boost::none;
+    }
+    return block;
+}
+
+void TranslationCache::Store(const IR::Block& block, u8 variant, const CodeReads& code_reads) {
+    Entry entry;
+    Common::FNV1a hasher;
+    for (const auto& [vaddr, value] : code_reads) {
+        hasher.Mix(vaddr);
+        hasher.Mix(value);
+        entry.code_addresses.push_back(vaddr);
+    }
+    entry.code_hash = hasher.Value();
+    entry.block_data = IR::SerializeBlock(block);
+
+    std::vector<u8> record;
+    Append(record, block.Location().Value());
+    Append(record, variant);
+    Append(record, entry.code_hash);
+    Append(record, static_cast<u32>(entry.code_addresses.size()));
+    for (u64 address : entry.code_addresses) {
+        Append(record, address);
+    }
+    record.insert(record.end(), entry.block_data.begin(), entry.block_data.end());
+
+    Common::FNV1a checksum;
+    checksum.Mix(record.data(), record.size());
+
+    std::vector<u8> framed;
+    Append(framed, static_cast<u32>(record.size()));
+    framed.insert(framed.end(), record.begin(), record.end());
+    Append(framed, checksum.Value());
+
+    std::lock_guard lock{mutex};
+    file.write(reinterpret_cast<const char*>(framed.data()), framed.size());
+    file.flush();
+
+    entries.insert_or_assign(Key{block.Location(), variant}, std::move(entry));
+}
+
+} // namespace Dynarmic::BackendX64
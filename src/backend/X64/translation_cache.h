@@ -0,0 +1,89 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "common/common_types.h"
+#include "frontend/ir/basic_block.h"
+#include "frontend/ir/location_descriptor.h"
+
+namespace Dynarmic::BackendX64 {
+
+/**
+ * A file of translated and optimised blocks that persists between runs of the program.
+ *
+ * Each block is stored alongside the addresses of all guest code read while translating it and a hash
+ * of the values read. A block is only reused if re-reading those addresses produces the same hash.
+ * The file is discarded if it was written by a different version of the IR or with a different
+ * configuration.
+ *
+ * Load and Store may be called from several threads.
+ */
+class TranslationCache final {
+public:
+    using ReadCodeFn = std::function<u32(u64 vaddr)>;
+    /// (vaddr, value) of each read of guest code made during translation.
+    using CodeReads = std::vector<std::pair<u64, u32>>;
+
+    /**
+     * @param path          Path of the cache file. It is created if it does not exist.
+     * @param config_values Every configuration value that affects the blocks passed to Store.
+     */
+    TranslationCache(const std::string& path, std::initializer_list<u64> config_values);
+
+    /**
+     * Looks up a block previously stored with the same location and variant.
+     * @param variant   Distinguishes different kinds of translation of the same location.
+     * @param read_code Used to check that guest code has not changed since the block was stored.
+     */
+    boost::optional<IR::Block> Load(IR::LocationDescriptor location, u8 variant, const ReadCodeFn& read_code);
+
+    /// Stores a block, replacing any earlier block with the same location and variant.
+    void Store(const IR::Block& block, u8 variant, const CodeReads& code_reads);
+
+private:
+    struct Key {
+        IR::LocationDescriptor location;
+        u8 variant;
+
+        bool operator==(const Key& o) const {
+            return location == o.location && variant == o.variant;
+        }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return std::hash<IR::LocationDescriptor>()(key.location) ^ key.variant;
+        }
+    };
+
+    struct Entry {
+        std::vector<u64> code_addresses;
+        u64 code_hash;
+        std::vector<u8> block_data;
+    };
+
+    void ReadFile(const std::string& path);
+    bool ParseRecord(const std::vector<u8>& record);
+
+    u64 fingerprint;
+    std::mutex mutex;
+    std::unordered_map<Key, Entry, KeyHash> entries;
+    std::ofstream file;
+};
+
+} // namespace Dynarmic::BackendX64
@@ -0,0 +1,55 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+#include "common/common_types.h"
+
+namespace Dynarmic::BackendX64 {
+
+/**
+ * Detects writes to host memory by write-protecting the pages containing it.
+ *
+ * When a watched page is written to, it is given back its original protection and the write is recorded
+ * for every WriteWatcher watching it. Each of their callbacks is called with the address of the page before
+ * the write proceeds. Callbacks may be called on any thread from within a signal handler, so they must only
+ * do async-signal-safe work such as storing to atomics; the written pages are collected by TakeWrittenPages.
+ *
+ * Only writes made by host code are detected. A system call such as read that writes to a watched page
+ * fails with EFAULT instead.
+ */
+class WriteWatcher final {
+public:
+    using WriteCallback = std::function<void(u64 host_page)>;
+
+    explicit WriteWatcher(WriteCallback callback);
+    ~WriteWatcher();
+
+    WriteWatcher(const WriteWatcher&) = delete;
+    WriteWatcher& operator=(const WriteWatcher&) = delete;
+
+    /// Returns true if writes can be detected on this platform. Otherwise Watch does nothing.
+    static bool IsSupported();
+    /// Size of the host pages that are watched.
+    static size_t PageSize();
+
+    /// Starts watching host_page, which must be PageSize-aligned. Pages that are not writable are not watched.
+    /// The original protection of host memory may be cached until UnwatchAll is next called.
+    void Watch(u64 host_page);
+    /// Stops watching all pages. Pages no longer watched by any WriteWatcher are given back their original protection.
+    void UnwatchAll();
+    /// Returns the watched pages written to since they were last watched, and stops watching them.
+    std::vector<u64> TakeWrittenPages();
+
+    /// Called when a watched page is written to.
+    const WriteCallback callback;
+};
+
+} // namespace Dynarmic::BackendX64
@@ -0,0 +1,39 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+#include "common/common_types.h"
+
+namespace Dynarmic::Common {
+
+/// Incremental 64-bit FNV-1a hash. Not suitable where collisions may be engineered.
+class FNV1a final {
+public:
+    void Mix(const void* data, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ static_cast<const u8*>(data)[i]) * 0x100000001b3;
+        }
+    }
+
+    template <typename T>
+    void Mix(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Mix(&value, sizeof(T));
+    }
+
+    u64 Value() const {
+        return hash;
+    }
+
+private:
+    u64 hash = 0xcbf29ce484222325;
+};
+
+} // namespace Dynarmic::Common
@@ -15,6 +15,7 @@
 #include "frontend/A32/translate/translate_arm/translate_arm.h"
 #include "frontend/A32/types.h"
 #include "frontend/ir/basic_block.h"
+#include "frontend/ir/superblock.h"
 
 namespace Dynarmic::A32 {
 
@@ -28,7 +29,7 @@ static bool CondCanContinue(ConditionalState cond_state, const A32::IREmitter& i
     return std::all_of(ir.block.begin(), ir.block.end(), [](const IR::Inst& inst) { return !inst.WritesToCPSR(); });
 }
 
-IR::Block TranslateArm(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code) {
+IR::Block TranslateArm(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code, const TranslationOptions& options) {
     IR::Block block{descriptor};
     ArmTranslatorVisitor visitor{block, descriptor};
 
@@ -51,6 +52,11 @@ IR::Block TranslateArm(LocationDescriptor descriptor, MemoryReadCodeFuncType mem
 
         visitor.ir.current_location = visitor.ir.current_location.AdvancePC(4);
         block.CycleCount()++;
+
+        if (!should_continue && options.enable_superblocks && visitor.cond_state == ConditionalState::None) {
+            should_continue = IR::ConvertToSideExit(block, visitor.ir, visitor.ir.current_location, options.superblock_max_instructions)
+                           || IR::FollowUnconditionalBranch(block, visitor.ir.current_location, options.superblock_max_instructions);
+        }
     }
 
     if (visitor.cond_state == ConditionalState::Translating || visitor.cond_state == ConditionalState::Trailing) {
@@ -14,6 +14,7 @@
 #include "frontend/A32/location_descriptor.h"
 #include "frontend/A32/translate/translate.h"
 #include "frontend/A32/types.h"
+#include "frontend/ir/superblock.h"
 
 namespace Dynarmic::A32 {
 namespace {
@@ -774,7 +775,7 @@ struct ThumbTranslatorVisitor final {
         if (m == Reg::R14)
             ir.SetTerm(IR::Term::PopRSBHint{});
         else
-            ir.SetTerm(IR::Term::ReturnToDispatch{});
+            ir.SetTerm(IR::Term::FastDispatchHint{});
         return false;
     }
 
@@ -783,7 +784,7 @@ struct ThumbTranslatorVisitor final {
         ir.PushRSB(ir.current_location.AdvancePC(2));
         ir.BXWritePC(ir.GetRegister(m));
         ir.SetRegister(Reg::LR, ir.Imm32((ir.current_location.PC() + 2) | 1));
-        ir.SetTerm(IR::Term::ReturnToDispatch{});
+        ir.SetTerm(IR::Term::FastDispatchHint{});
         return false;
     }
 
@@ -879,7 +880,7 @@ std::tuple<u32, ThumbInstSize> ReadThumbInstruction(u32 arm_pc, MemoryReadCodeFu
 
 } // local namespace
 
-IR::Block TranslateThumb(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code) {
+IR::Block TranslateThumb(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code, const TranslationOptions& options) {
     IR::Block block{descriptor};
     ThumbTranslatorVisitor visitor{block, descriptor};
 
@@ -905,6 +906,11 @@ IR::Block TranslateThumb(LocationDescriptor descriptor, MemoryReadCodeFuncType m
         const s32 advance_pc = (inst_size == ThumbInstSize::Thumb16) ? 2 : 4;
         visitor.ir.current_location = visitor.ir.current_location.AdvancePC(advance_pc);
         block.CycleCount()++;
+
+        if (!should_continue && options.enable_superblocks) {
+            should_continue = IR::ConvertToSideExit(block, visitor.ir, visitor.ir.current_location, options.superblock_max_instructions)
+                           || IR::FollowUnconditionalBranch(block, visitor.ir.current_location, options.superblock_max_instructions);
+        }
     }
 
     block.SetEndLocation(visitor.ir.current_location);
@@ -331,6 +331,40 @@ IR::U32 TranslatorVisitor::ExclusiveMem(IR::U64 address, size_t bytesize, AccTyp
     }
 }
 
+IR::UAny TranslatorVisitor::AtomicMem(IR::U64 address, size_t bytesize, AccType /*acctype*/, IR::UAny value, AtomicOp op) {
+    switch (bytesize) {
+    case 1:
+        return ir.AtomicMemoryOp8(address, value, op);
+    case 2:
+        return ir.AtomicMemoryOp16(address, value, op);
+    case 4:
+        return ir.AtomicMemoryOp32(address, value, op);
+    case 8:
+        return ir.AtomicMemoryOp64(address, value, op);
+    default:
+        ASSERT_MSG(false, "Invalid bytesize parameter {}", bytesize);
+        return {};
+    }
+}
+
+IR::UAnyU128 TranslatorVisitor::CompareAndSwapMem(IR::U64 address, size_t bytesize, AccType /*acctype*/, IR::UAnyU128 expected, IR::UAnyU128 desired) {
+    switch (bytesize) {
+    case 1:
+        return ir.CompareAndSwapMemory8(address, expected, desired);
+    case 2:
+        return ir.CompareAndSwapMemory16(address, expected, desired);
+    case 4:
+        return ir.CompareAndSwapMemory32(address, expected, desired);
+    case 8:
+        return ir.CompareAndSwapMemory64(address, expected, desired);
+    case 16:
+        return ir.CompareAndSwapMemory128(address, expected, desired);
+    default:
+        ASSERT_MSG(false, "Invalid bytesize parameter {}", bytesize);
+        return {};
+    }
+}
+
 IR::U32U64 TranslatorVisitor::SignExtend(IR::UAny value, size_t to_size) {
     switch (to_size) {
     case 32:
@@ -0,0 +1,234 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include "frontend/A64/translate/impl/impl.h"
+
+namespace Dynarmic::A64 {
+
+static IR::U64 AtomicAddress(TranslatorVisitor& tv, Reg Rn) {
+    if (Rn == Reg::SP) {
+        // SP alignment is not checked, as for the other loads and stores.
+        return tv.SP(64);
+    }
+    return tv.X(64, Rn);
+}
+
+static bool CompareAndSwap(TranslatorVisitor& tv, size_t size, bool L, Reg Rs, bool o0, Reg Rn, Reg Rt) {
+    // Shared Decode
+
+    const AccType acctype = L || o0 ? AccType::ORDEREDRW : AccType::ATOMIC;
+    const size_t datasize = 8 << size;
+    const size_t regsize = datasize == 64 ? 64 : 32;
+
+    // Operation
+
+    const IR::U64 address = AtomicAddress(tv, Rn);
+    const IR::UAny comparevalue = tv.X(datasize, Rs);
+    const IR::UAny newvalue = tv.X(datasize, Rt);
+
+    const IR::UAny data = tv.CompareAndSwapMem(address, datasize / 8, acctype, comparevalue, newvalue);
+    tv.X(regsize, Rs, tv.ZeroExtend(data, regsize));
+    return true;
+}
+
+static bool AtomicMemoryOperation(TranslatorVisitor& tv, size_t size, bool A, bool R, Reg Rs, Reg Rn, Reg Rt, AtomicOp op) {
+    // Shared Decode
+
+    const AccType acctype = A || R ? AccType::ORDEREDRW : AccType::ATOMIC;
+    const size_t datasize = 8 << size;
+    const size_t regsize = datasize == 64 ? 64 : 32;
+
+    // Operation
+
+    const IR::U64 address = AtomicAddress(tv, Rn);
+    const IR::UAny value = tv.X(datasize, Rs);
+
+    const IR::UAny data = tv.AtomicMem(address, datasize / 8, acctype, value, op);
+    tv.X(regsize, Rt, tv.ZeroExtend(data, regsize));
+    return true;
+}
+
+static bool LoadAcquirePC(TranslatorVisitor& tv, size_t size, Reg Rn, Reg Rt) {
+    // Shared Decode
+
+    const AccType acctype = AccType::ORDERED;
+    const size_t datasize = 8 << size;
+    const size_t regsize = datasize == 64 ? 64 : 32;
+
+    // Operation
+
+    const IR::U64 address = AtomicAddress(tv, Rn);
+    const IR::UAny data = tv.Mem(address, datasize / 8, acctype);
+    tv.X(regsize, Rt, tv.ZeroExtend(data, regsize));
+    return true;
+}
+
+bool TranslatorVisitor::CASP(bool sz, bool L, Reg Rs, bool o0, Reg Rn, Reg Rt) {
+    if (RegNumber(Rs) % 2 == 1 || RegNumber(Rt) % 2 == 1) {
+        return UnallocatedEncoding();
+    }
+
+    // Shared Decode
+
+    const AccType acctype = L || o0 ? AccType::ORDEREDRW : AccType::ATOMIC;
+    const size_t datasize = sz ? 128 : 64;
+
+    // Operation
+
+    const IR::U64 address = AtomicAddress(*this, Rn);
+
+    if (datasize == 64) {
+        const IR::U64 comparevalue = ir.Pack2x32To1x64(X(32, Rs), X(32, Rs + 1));
+        const IR::U64 newvalue = ir.Pack2x32To1x64(X(32, Rt), X(32, Rt + 1));
+
+        const IR::U64 data = CompareAndSwapMem(address, 8, acctype, comparevalue, newvalue);
+        X(32, Rs, ir.LeastSignificantWord(data));
+        X(32, Rs + 1, ir.MostSignificantWord(data).result);
+    } else {
+        const IR::U128 comparevalue = ir.Pack2x64To1x128(X(64, Rs), X(64, Rs + 1));
+        const IR::U128 newvalue = ir.Pack2x64To1x128(X(64, Rt), X(64, Rt + 1));
+
+        const IR::U128 data = CompareAndSwapMem(address, 16, acctype, comparevalue, newvalue);
+        X(64, Rs, ir.VectorGetElement(64, data, 0));
+        X(64, Rs + 1, ir.VectorGetElement(64, data, 1));
+    }
+
+    return true;
+}
+
+bool TranslatorVisitor::CASB(bool L, Reg Rs, bool o0, Reg Rn, Reg Rt) {
+    return CompareAndSwap(*this, 0, L, Rs, o0, Rn, Rt);
+}
+
+bool TranslatorVisitor::CASH(bool L, Reg Rs, bool o0, Reg Rn, Reg Rt) {
+    return CompareAndSwap(*this, 1, L, Rs, o0, Rn, Rt);
+}
+
+bool TranslatorVisitor::CAS(bool sz, bool L, Reg Rs, bool o0, Reg Rn, Reg Rt) {
+    return CompareAndSwap(*this, sz ? 3 : 2, L, Rs, o0, Rn, Rt);
+}
+
+bool TranslatorVisitor::LDADDB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::Add);
+}
+
+bool TranslatorVisitor::LDCLRB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::Clear);
+}
+
+bool TranslatorVisitor::LDEORB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::Eor);
+}
+
+bool TranslatorVisitor::LDSETB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::Set);
+}
+
+bool TranslatorVisitor::LDSMAXB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::SMax);
+}
+
+bool TranslatorVisitor::LDSMINB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::SMin);
+}
+
+bool TranslatorVisitor::LDUMAXB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::UMax);
+}
+
+bool TranslatorVisitor::LDUMINB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::UMin);
+}
+
+bool TranslatorVisitor::SWPB(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 0, A, R, Rs, Rn, Rt, AtomicOp::Swap);
+}
+
+bool TranslatorVisitor::LDAPRB(Reg Rn, Reg Rt) {
+    return LoadAcquirePC(*this, 0, Rn, Rt);
+}
+
+bool TranslatorVisitor::LDADDH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::Add);
+}
+
+bool TranslatorVisitor::LDCLRH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::Clear);
+}
+
+bool TranslatorVisitor::LDEORH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::Eor);
+}
+
+bool TranslatorVisitor::LDSETH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::Set);
+}
+
+bool TranslatorVisitor::LDSMAXH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::SMax);
+}
+
+bool TranslatorVisitor::LDSMINH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::SMin);
+}
+
+bool TranslatorVisitor::LDUMAXH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::UMax);
+}
+
+bool TranslatorVisitor::LDUMINH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::UMin);
+}
+
+bool TranslatorVisitor::SWPH(bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, 1, A, R, Rs, Rn, Rt, AtomicOp::Swap);
+}
+
+bool TranslatorVisitor::LDAPRH(Reg Rn, Reg Rt) {
+    return LoadAcquirePC(*this, 1, Rn, Rt);
+}
+
+bool TranslatorVisitor::LDADD(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::Add);
+}
+
+bool TranslatorVisitor::LDCLR(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::Clear);
+}
+
+bool TranslatorVisitor::LDEOR(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::Eor);
+}
+
+bool TranslatorVisitor::LDSET(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::Set);
+}
+
+bool TranslatorVisitor::LDSMAX(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::SMax);
+}
+
+bool TranslatorVisitor::LDSMIN(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::SMin);
+}
+
+bool TranslatorVisitor::LDUMAX(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::UMax);
+}
+
+bool TranslatorVisitor::LDUMIN(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::UMin);
+}
+
+bool TranslatorVisitor::SWP(bool sz, bool A, bool R, Reg Rs, Reg Rn, Reg Rt) {
+    return AtomicMemoryOperation(*this, sz ? 3 : 2, A, R, Rs, Rn, Rt, AtomicOp::Swap);
+}
+
+bool TranslatorVisitor::LDAPR(bool sz, Reg Rn, Reg Rt) {
+    return LoadAcquirePC(*this, sz ? 3 : 2, Rn, Rt);
+}
+
+} // namespace Dynarmic::A64
@@ -9,10 +9,52 @@
 #include "frontend/A64/translate/impl/impl.h"
 #include "frontend/A64/translate/translate.h"
 #include "frontend/ir/basic_block.h"
+#include "frontend/ir/opcodes.h"
+#include "frontend/ir/superblock.h"
 
 namespace Dynarmic::A64 {
 
-IR::Block Translate(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code) {
+/// If the block has so far ended with a forward conditional direct branch, replace the branch with a side exit
+/// so that translation can continue along the fall-through path. Returns true if translation should continue.
+static bool ConvertToSideExit(IR::Block& block, TranslatorVisitor& visitor, const TranslationOptions& options) {
+    const LocationDescriptor fallthrough = *visitor.ir.current_location;
+    if (IR::ConvertToSideExit(block, visitor.ir, fallthrough, options.superblock_max_instructions)) {
+        return true;
+    }
+
+    if (block.CycleCount() >= options.superblock_max_instructions) {
+        return false;
+    }
+
+    const auto terminal = block.GetTerminal();
+    const auto* check_bit = boost::get<IR::Term::CheckBit>(&terminal);
+    if (!check_bit) {
+        return false;
+    }
+
+    bool taken_if;
+    boost::optional<LocationDescriptor> target;
+    if ((target = IR::ForwardBranchTarget(check_bit->then_, check_bit->else_, fallthrough))) {
+        taken_if = true;
+    } else if ((target = IR::ForwardBranchTarget(check_bit->else_, check_bit->then_, fallthrough))) {
+        taken_if = false;
+    } else {
+        return false;
+    }
+
+    // The side exit tests the value directly, so the check bit itself need not be stored.
+    auto& set_check_bit = block.back();
+    ASSERT(set_check_bit.GetOpcode() == IR::Opcode::A64SetCheckBit);
+    const IR::U1 bit{set_check_bit.GetArg(0)};
+    set_check_bit.Invalidate();
+    block.Instructions().pop_back();
+
+    block.ReplaceTerminal(IR::Term::Invalid{});
+    visitor.ir.SideExitIfBit(bit, taken_if, *target);
+    return true;
+}
+
+IR::Block Translate(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code, TranslationOptions options) {
     IR::Block block{descriptor};
     TranslatorVisitor visitor{block, descriptor};
 
@@ -29,6 +71,11 @@ IR::Block Translate(LocationDescriptor descriptor, MemoryReadCodeFuncType memory
 
         visitor.ir.current_location = visitor.ir.current_location->AdvancePC(4);
         block.CycleCount()++;
+
+        if (!should_continue && options.enable_superblocks) {
+            should_continue = ConvertToSideExit(block, visitor, options)
+                           || IR::FollowUnconditionalBranch(block, *visitor.ir.current_location, options.superblock_max_instructions);
+        }
     }
 
     ASSERT_MSG(block.HasTerminal(), "Terminal has not been set");
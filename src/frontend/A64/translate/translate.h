@@ -21,13 +21,23 @@ class LocationDescriptor;
 
 using MemoryReadCodeFuncType = std::function<u32(u64 vaddr)>;
 
+struct TranslationOptions {
+    /// When a block ends with an unconditional direct branch (B, BL), continue translating at the
+    /// branch target instead of ending the block there. The resulting block covers several ranges of guest code.
+    bool enable_superblocks = false;
+
+    /// Superblock translation stops following branches once a block contains this many instructions.
+    size_t superblock_max_instructions = 0;
+};
+
 /**
  * This function translates instructions in memory into our intermediate representation.
  * @param descriptor The starting location of the basic block. Includes information like PC, FPCR state, &c.
  * @param memory_read_code The function we should use to read emulated memory.
+ * @param options Configures how translation is performed.
  * @return A translated basic block in the intermediate representation.
  */
-IR::Block Translate(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code);
+IR::Block Translate(LocationDescriptor descriptor, MemoryReadCodeFuncType memory_read_code, TranslationOptions options = {});
 
 /**
  * This function translates a single provided instruction into our intermediate representation.
@@ -41,6 +41,19 @@ enum class ShiftType {
     ROR,
 };
 
+/// Operation performed by an atomic read-modify-write of memory. The memory operand is the first operand.
+enum class AtomicOp : u8 {
+    Add,
+    Clear,
+    Eor,
+    Set,
+    SMax,
+    SMin,
+    UMax,
+    UMin,
+    Swap,
+};
+
 const char* CondToString(Cond cond);
 std::string RegToString(Reg reg);
 std::string VecToString(Vec vec);
@@ -8,6 +8,7 @@
 #include <initializer_list>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <fmt/format.h>
 #include <fmt/ostream.h>
@@ -24,6 +25,17 @@ void Block::AppendNewInst(Opcode opcode, std::initializer_list<IR::Value> args)
     PrependNewInst(end(), opcode, args);
 }
 
+void Block::AppendNewInst(Opcode opcode, const std::vector<Value>& args) {
+    IR::Inst* inst = new(instruction_alloc_pool->Alloc()) IR::Inst(opcode);
+    ASSERT(args.size() == inst->NumArgs());
+
+    for (size_t index = 0; index < args.size(); index++) {
+        inst->SetArg(index, args[index]);
+    }
+
+    instructions.push_back(inst);
+}
+
 Block::iterator Block::PrependNewInst(iterator insertion_point, Opcode opcode, std::initializer_list<Value> args) {
     IR::Inst* inst = new(instruction_alloc_pool->Alloc()) IR::Inst(opcode);
     ASSERT(args.size() == inst->NumArgs());
@@ -48,6 +60,26 @@ void Block::SetEndLocation(const LocationDescriptor& descriptor) {
     end_location = descriptor;
 }
 
+std::vector<std::pair<LocationDescriptor, LocationDescriptor>> Block::TranslatedRanges() const {
+    auto ranges = previous_ranges;
+    ranges.emplace_back(range_begin, end_location);
+    return ranges;
+}
+
+void Block::SplitTranslatedRange(const LocationDescriptor& end, const LocationDescriptor& next_begin) {
+    previous_ranges.emplace_back(range_begin, end);
+    range_begin = next_begin;
+}
+
+size_t Block::AddSideExit(const LocationDescriptor& target) {
+    side_exits.push_back({target, cycle_count});
+    return side_exits.size() - 1;
+}
+
+const std::vector<Block::SideExit>& Block::SideExits() const {
+    return side_exits;
+}
+
 Cond Block::GetCondition() const {
     return cond;
 }
@@ -131,14 +163,17 @@ static std::string TerminalToString(const Terminal& terminal_variant) {
         return "PopRSBHint{}";
     }
     case 6: {
+        return "FastDispatchHint{}";
+    }
+    case 7: {
         auto terminal = boost::get<IR::Term::If>(terminal_variant);
         return fmt::format("If{{{}, {}, {}}}", A64::CondToString(terminal.if_), TerminalToString(terminal.then_), TerminalToString(terminal.else_));
     }
-    case 7: {
+    case 8: {
         auto terminal = boost::get<IR::Term::CheckBit>(terminal_variant);
         return fmt::format("CheckBit{{{}, {}}}", TerminalToString(terminal.then_), TerminalToString(terminal.else_));
     }
-    case 8: {
+    case 9: {
         auto terminal = boost::get<IR::Term::CheckHalt>(terminal_variant);
         return fmt::format("CheckHalt{{{}}}", TerminalToString(terminal.else_));
     }
@@ -186,6 +221,8 @@ std::string DumpBlock(const IR::Block& block) {
             return A64::RegToString(arg.GetA64RegRef());
         case Type::A64Vec:
             return A64::VecToString(arg.GetA64VecRef());
+        case Type::Cond:
+            return A64::CondToString(arg.GetCond());
         default:
             return "<unknown immediate type>";
         }
@@ -223,6 +260,10 @@ std::string DumpBlock(const IR::Block& block) {
         inst_to_index[&inst] = index++;
     }
 
+    for (size_t i = 0; i < block.SideExits().size(); i++) {
+        const auto& side_exit = block.SideExits()[i];
+        ret += fmt::format("side exit {} = {} (cycles: {})\n", i, side_exit.target, side_exit.cycle_count);
+    }
     ret += "terminal = " + TerminalToString(block.GetTerminal()) + '\n';
 
     return ret;
@@ -9,6 +9,8 @@
 #include <initializer_list>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <boost/optional.hpp>
 
@@ -40,8 +42,16 @@ public:
     using reverse_iterator       = InstructionList::reverse_iterator;
     using const_reverse_iterator = InstructionList::const_reverse_iterator;
 
+    /// A conditional exit from the middle of a block.
+    struct SideExit {
+        /// Location execution continues at if the exit is taken.
+        LocationDescriptor target;
+        /// Number of cycles this block takes to execute up to and including the exit.
+        size_t cycle_count;
+    };
+
     explicit Block(const LocationDescriptor& location)
-        : location(location), end_location(location) {}
+        : location(location), end_location(location), range_begin(location) {}
 
     bool                   empty()   const { return instructions.empty();   }
     size_type              size()    const { return instructions.size();    }
@@ -77,6 +87,15 @@ public:
      */
     void AppendNewInst(Opcode op, std::initializer_list<Value> args);
 
+    /**
+     * Appends a new instruction to the end of this basic block,
+     * handling any allocations necessary to do so.
+     *
+     * @param op   Opcode representing the instruction to add.
+     * @param args Arguments for the instruction, one for each argument of op.
+     */
+    void AppendNewInst(Opcode op, const std::vector<Value>& args);
+
     /**
      * Prepends a new instruction to this basic block before the insertion point,
      * handling any allocations necessary to do so.
@@ -95,6 +114,17 @@ public:
     /// Sets the end location for this basic block.
     void SetEndLocation(const LocationDescriptor& descriptor);
 
+    /// Gets the ranges of guest code this block was translated from, as half-open [begin, end) pairs.
+    /// There is more than one range only if translation continued across a branch (a superblock).
+    std::vector<std::pair<LocationDescriptor, LocationDescriptor>> TranslatedRanges() const;
+    /// Ends the current range of guest code at `end` and starts a new range at `next_begin`.
+    void SplitTranslatedRange(const LocationDescriptor& end, const LocationDescriptor& next_begin);
+
+    /// Registers a side exit to `target` taken after the instructions translated so far, returning its index.
+    size_t AddSideExit(const LocationDescriptor& target);
+    /// Gets the side exits of this block, indexed by the immediate argument of the SideExit* instructions.
+    const std::vector<SideExit>& SideExits() const;
+
     /// Gets the condition required to pass in order to execute this block.
     Cond GetCondition() const;
     /// Sets the condition required to pass in order to execute this block.
@@ -136,6 +166,12 @@ private:
     LocationDescriptor location;
     /// Description of the end location of this block
     LocationDescriptor end_location;
+    /// Guest code ranges of this block prior to the current one
+    std::vector<std::pair<LocationDescriptor, LocationDescriptor>> previous_ranges;
+    /// Start of the current guest code range of this block, which ends at `end_location`
+    LocationDescriptor range_begin;
+    /// Conditional exits from the middle of this block
+    std::vector<SideExit> side_exits;
     /// Conditional to pass in order to execute this block
     Cond cond = Cond::AL;
     /// Block to execute next if `cond` did not pass.
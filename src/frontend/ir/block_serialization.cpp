@@ -0,0 +1,478 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "common/assert.h"
+#include "common/fnv1a.h"
+#include "common/variant_util.h"
+#include "frontend/A32/types.h"
+#include "frontend/A64/types.h"
+#include "frontend/ir/basic_block.h"
+#include "frontend/ir/block_serialization.h"
+#include "frontend/ir/microinstruction.h"
+#include "frontend/ir/opcodes.h"
+#include "frontend/ir/terminal.h"
+#include "frontend/ir/type.h"
+#include "frontend/ir/value.h"
+
+namespace Dynarmic::IR {
+
+namespace {
+
+constexpr u64 format_revision = 1;
+constexpr size_t max_terminal_depth = 32;
+
+enum class TerminalTag : u8 {
+    Invalid,
+    Interpret,
+    ReturnToDispatch,
+    LinkBlock,
+    LinkBlockFast,
+    PopRSBHint,
+    FastDispatchHint,
+    If,
+    CheckBit,
+    CheckHalt,
+};
+
+class Writer {
+public:
+    template <typename T>
+    void Write(T value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const size_t offset = data.size();
+        data.resize(offset + sizeof(T));
+        std::memcpy(data.data() + offset, &value, sizeof(T));
+    }
+
+    void WriteLocation(const LocationDescriptor& location) {
+        Write<u64>(location.Value());
+    }
+
+    void WriteTerminal(const Terminal& terminal) {
+        Common::VisitVariant<void>(terminal, [this](const auto& t) {
+            using T = std::decay_t<decltype(t)>;
+            if constexpr (std::is_same_v<T, Term::Invalid>) {
+                Write(TerminalTag::Invalid);
+            } else if constexpr (std::is_same_v<T, Term::Interpret>) {
+                Write(TerminalTag::Interpret);
+                WriteLocation(t.next);
+                Write<u64>(t.num_instructions);
+            } else if constexpr (std::is_same_v<T, Term::ReturnToDispatch>) {
+                Write(TerminalTag::ReturnToDispatch);
+            } else if constexpr (std::is_same_v<T, Term::LinkBlock>) {
+                Write(TerminalTag::LinkBlock);
+                WriteLocation(t.next);
+            } else if constexpr (std::is_same_v<T, Term::LinkBlockFast>) {
+                Write(TerminalTag::LinkBlockFast);
+                WriteLocation(t.next);
+            } else if constexpr (std::is_same_v<T, Term::PopRSBHint>) {
+                Write(TerminalTag::PopRSBHint);
+            } else if constexpr (std::is_same_v<T, Term::FastDispatchHint>) {
+                Write(TerminalTag::FastDispatchHint);
+            } else if constexpr (std::is_same_v<T, Term::If>) {
+                Write(TerminalTag::If);
+                Write(t.if_);
+                WriteTerminal(t.then_);
+                WriteTerminal(t.else_);
+            } else if constexpr (std::is_same_v<T, Term::CheckBit>) {
+                Write(TerminalTag::CheckBit);
+                WriteTerminal(t.then_);
+                WriteTerminal(t.else_);
+            } else if constexpr (std::is_same_v<T, Term::CheckHalt>) {
+                Write(TerminalTag::CheckHalt);
+                WriteTerminal(t.else_);
+            } else {
+                static_assert(!std::is_same_v<T, T>, "Unhandled terminal");
+            }
+        });
+    }
+
+    std::vector<u8> data;
+};
+
+class Reader {
+public:
+    explicit Reader(const std::vector<u8>& data) : data(data) {}
+
+    template <typename T>
+    bool Read(T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (data.size() - offset < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool ReadLocation(LocationDescriptor& location) {
+        u64 value;
+        if (!Read(value)) {
+            return false;
+        }
+        location = LocationDescriptor{value};
+        return true;
+    }
+
+    bool ReadTerminal(Terminal& terminal, size_t depth = 0) {
+        TerminalTag tag;
+        if (depth > max_terminal_depth || !Read(tag)) {
+            return false;
+        }
+
+        LocationDescriptor next{0};
+        switch (tag) {
+        case TerminalTag::Invalid:
+            terminal = Term::Invalid{};
+            return true;
+        case TerminalTag::Interpret: {
+            u64 num_instructions;
+            if (!ReadLocation(next) || !Read(num_instructions)) {
+                return false;
+            }
+            Term::Interpret interpret{next};
+            interpret.num_instructions = num_instructions;
+            terminal = interpret;
+            return true;
+        }
+        case TerminalTag::ReturnToDispatch:
+            terminal = Term::ReturnToDispatch{};
+            return true;
+        case TerminalTag::LinkBlock:
+            if (!ReadLocation(next)) {
+                return false;
+            }
+            terminal = Term::LinkBlock{next};
+            return true;
+        case TerminalTag::LinkBlockFast:
+            if (!ReadLocation(next)) {
+                return false;
+            }
+            terminal = Term::LinkBlockFast{next};
+            return true;
+        case TerminalTag::PopRSBHint:
+            terminal = Term::PopRSBHint{};
+            return true;
+        case TerminalTag::FastDispatchHint:
+            terminal = Term::FastDispatchHint{};
+            return true;
+        case TerminalTag::If: {
+            Cond cond;
+            Terminal then_, else_;
+            if (!Read(cond) || !ReadTerminal(then_, depth + 1) || !ReadTerminal(else_, depth + 1)) {
+                return false;
+            }
+            terminal = Term::If{cond, then_, else_};
+            return true;
+        }
+        case TerminalTag::CheckBit: {
+            Terminal then_, else_;
+            if (!ReadTerminal(then_, depth + 1) || !ReadTerminal(else_, depth + 1)) {
+                return false;
+            }
+            terminal = Term::CheckBit{then_, else_};
+            return true;
+        }
+        case TerminalTag::CheckHalt: {
+            Terminal else_;
+            if (!ReadTerminal(else_, depth + 1)) {
+                return false;
+            }
+            terminal = Term::CheckHalt{else_};
+            return true;
+        }
+        }
+        return false;
+    }
+
+    bool AtEnd() const {
+        return offset == data.size();
+    }
+
+private:
+    const std::vector<u8>& data;
+    size_t offset = 0;
+};
+
+void WriteValue(Writer& writer, const Value& value, const std::vector<const Inst*>& instructions) {
+    if (value.IsEmpty()) {
+        writer.Write(Type::Void);
+        return;
+    }
+
+    if (!value.IsImmediate()) {
+        const auto iter = std::find(instructions.begin(), instructions.end(), value.GetInst());
+        ASSERT(iter != instructions.end());
+        writer.Write(Type::Opaque);
+        writer.Write<u32>(static_cast<u32>(iter - instructions.begin()));
+        return;
+    }
+
+    const Type type = value.GetType();
+    writer.Write(type);
+    switch (type) {
+    case Type::A32Reg:
+        writer.Write(value.GetA32RegRef());
+        break;
+    case Type::A32ExtReg:
+        writer.Write(value.GetA32ExtRegRef());
+        break;
+    case Type::A64Reg:
+        writer.Write(value.GetA64RegRef());
+        break;
+    case Type::A64Vec:
+        writer.Write(value.GetA64VecRef());
+        break;
+    case Type::U1:
+        writer.Write<u8>(value.GetU1());
+        break;
+    case Type::U8:
+        writer.Write(value.GetU8());
+        break;
+    case Type::U16:
+        writer.Write(value.GetU16());
+        break;
+    case Type::U32:
+        writer.Write(value.GetU32());
+        break;
+    case Type::U64:
+        writer.Write(value.GetU64());
+        break;
+    case Type::CoprocInfo:
+        writer.Write(value.GetCoprocInfo());
+        break;
+    case Type::Cond:
+        writer.Write(value.GetCond());
+        break;
+    default:
+        ASSERT_MSG(false, "Unserializable immediate of type {}", GetNameOf(type));
+        break;
+    }
+}
+
+bool ReadValue(Reader& reader, Value& value, const std::vector<Inst*>& instructions) {
+    Type type;
+    if (!reader.Read(type)) {
+        return false;
+    }
+
+    const auto read_as = [&reader, &value](auto immediate) {
+        if (!reader.Read(immediate)) {
+            return false;
+        }
+        value = Value(immediate);
+        return true;
+    };
+
+    switch (type) {
+    case Type::Void:
+        value = Value{};
+        return true;
+    case Type::Opaque: {
+        u32 index;
+        if (!reader.Read(index) || index >= instructions.size()) {
+            return false;
+        }
+        value = Value(instructions[index]);
+        return true;
+    }
+    case Type::A32Reg:
+        return read_as(A32::Reg{});
+    case Type::A32ExtReg:
+        return read_as(A32::ExtReg{});
+    case Type::A64Reg:
+        return read_as(A64::Reg{});
+    case Type::A64Vec:
+        return read_as(A64::Vec{});
+    case Type::U1: {
+        u8 imm;
+        if (!reader.Read(imm)) {
+            return false;
+        }
+        value = Value(imm != 0);
+        return true;
+    }
+    case Type::U8:
+        return read_as(u8{});
+    case Type::U16:
+        return read_as(u16{});
+    case Type::U32:
+        return read_as(u32{});
+    case Type::U64:
+        return read_as(u64{});
+    case Type::CoprocInfo:
+        return read_as(std::array<u8, 8>{});
+    case Type::Cond:
+        return read_as(Cond{});
+    default:
+        return false;
+    }
+}
+
+} // anonymous namespace
+
+u64 SerializationFormatVersion() {
+    static const u64 version = [] {
+        // A hash of everything the format depends on.
+        Common::FNV1a hash;
+        hash.Mix(format_revision);
+        for (size_t i = 0; i < OpcodeCount; i++) {
+            const Opcode op = static_cast<Opcode>(i);
+            const std::string name = GetNameOf(op);
+            hash.Mix(name.data(), name.size());
+            for (size_t arg = 0; arg < GetNumArgsOf(op); arg++) {
+                hash.Mix(GetArgTypeOf(op, arg));
+            }
+        }
+        return hash.Value();
+    }();
+    return version;
+}
+
+std::vector<u8> SerializeBlock(const Block& block) {
+    Writer writer;
+
+    writer.WriteLocation(block.Location());
+
+    const auto ranges = block.TranslatedRanges();
+    writer.Write<u32>(static_cast<u32>(ranges.size()));
+    for (const auto& [begin, end] : ranges) {
+        writer.WriteLocation(begin);
+        writer.WriteLocation(end);
+    }
+
+    writer.Write<u32>(static_cast<u32>(block.SideExits().size()));
+    for (const auto& side_exit : block.SideExits()) {
+        writer.WriteLocation(side_exit.target);
+        writer.Write<u64>(side_exit.cycle_count);
+    }
+
+    writer.Write(block.GetCondition());
+    writer.Write<u8>(block.HasConditionFailedLocation());
+    if (block.HasConditionFailedLocation()) {
+        writer.WriteLocation(block.ConditionFailedLocation());
+    }
+    writer.Write<u64>(block.ConditionFailedCycleCount());
+    writer.Write<u64>(block.CycleCount());
+
+    std::vector<const Inst*> instructions;
+    writer.Write<u32>(static_cast<u32>(block.size()));
+    for (const auto& inst : block) {
+        writer.Write<u32>(static_cast<u32>(inst.GetOpcode()));
+        for (size_t i = 0; i < inst.NumArgs(); i++) {
+            WriteValue(writer, inst.GetArg(i), instructions);
+        }
+        instructions.push_back(&inst);
+    }
+
+    writer.WriteTerminal(block.GetTerminal());
+
+    return std::move(writer.data);
+}
+
+bool DeserializeBlock(const std::vector<u8>& data, Block& block) {
+    Reader reader{data};
+
+    LocationDescriptor location{0};
+    if (!reader.ReadLocation(location) || location != block.Location()) {
+        return false;
+    }
+
+    u32 range_count;
+    if (!reader.Read(range_count) || range_count == 0) {
+        return false;
+    }
+    for (u32 i = 0; i < range_count; i++) {
+        LocationDescriptor begin{0}, end{0};
+        if (!reader.ReadLocation(begin) || !reader.ReadLocation(end)) {
+            return false;
+        }
+        if (i == 0 && begin != block.Location()) {
+            return false;
+        }
+        if (i != 0) {
+            block.SplitTranslatedRange(block.EndLocation(), begin);
+        }
+        block.SetEndLocation(end);
+    }
+
+    u32 side_exit_count;
+    if (!reader.Read(side_exit_count)) {
+        return false;
+    }
+    for (u32 i = 0; i < side_exit_count; i++) {
+        LocationDescriptor target{0};
+        u64 cycle_count;
+        if (!reader.ReadLocation(target) || !reader.Read(cycle_count)) {
+            return false;
+        }
+        block.CycleCount() = cycle_count;
+        block.AddSideExit(target);
+    }
+
+    Cond cond;
+    u8 has_cond_failed;
+    u64 cond_failed_cycle_count, cycle_count;
+    if (!reader.Read(cond) || !reader.Read(has_cond_failed)) {
+        return false;
+    }
+    block.SetCondition(cond);
+    if (has_cond_failed) {
+        LocationDescriptor cond_failed{0};
+        if (!reader.ReadLocation(cond_failed)) {
+            return false;
+        }
+        block.SetConditionFailedLocation(cond_failed);
+    }
+    if (!reader.Read(cond_failed_cycle_count) || !reader.Read(cycle_count)) {
+        return false;
+    }
+    block.ConditionFailedCycleCount() = cond_failed_cycle_count;
+    block.CycleCount() = cycle_count;
+
+    u32 inst_count;
+    if (!reader.Read(inst_count)) {
+        return false;
+    }
+    std::vector<Inst*> instructions;
+    for (u32 i = 0; i < inst_count; i++) {
+        u32 opcode_value;
+        if (!reader.Read(opcode_value) || opcode_value >= OpcodeCount) {
+            return false;
+        }
+        const Opcode op = static_cast<Opcode>(opcode_value);
+
+        std::vector<Value> args(GetNumArgsOf(op));
+        for (size_t arg = 0; arg < args.size(); arg++) {
+            if (!ReadValue(reader, args[arg], instructions)) {
+                return false;
+            }
+            if (!AreTypesCompatible(args[arg].GetType(), GetArgTypeOf(op, arg))) {
+                return false;
+            }
+        }
+
+        block.AppendNewInst(op, args);
+        instructions.push_back(&block.back());
+    }
+
+    Terminal terminal;
+    if (!reader.ReadTerminal(terminal)) {
+        return false;
+    }
+    block.SetTerminal(terminal);
+
+    return reader.AtEnd();
+}
+
+} // namespace Dynarmic::IR
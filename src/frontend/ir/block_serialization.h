@@ -0,0 +1,31 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "common/common_types.h"
+
+namespace Dynarmic::IR {
+
+class Block;
+
+/// Version of the format produced by SerializeBlock. Changes whenever the format or the set of opcodes changes.
+u64 SerializationFormatVersion();
+
+/// Serializes a block into a self-contained sequence of bytes.
+std::vector<u8> SerializeBlock(const Block& block);
+
+/**
+ * Reconstructs a block serialized by SerializeBlock.
+ * @param data  Serialized block.
+ * @param block A newly constructed block at the location of the serialized block.
+ * @returns false if data is malformed, in which case the contents of block are unspecified.
+ */
+bool DeserializeBlock(const std::vector<u8>& data, Block& block);
+
+} // namespace Dynarmic::IR
@@ -34,6 +34,16 @@ void IREmitter::PushRSB(const LocationDescriptor& return_location) {
     Inst(Opcode::PushRSB, IR::Value(return_location.Value()));
 }
 
+void IREmitter::SideExitIf(Cond cond, const LocationDescriptor& target) {
+    const size_t index = block.AddSideExit(target);
+    Inst(Opcode::SideExitIf, Value{cond}, Imm64(index));
+}
+
+void IREmitter::SideExitIfBit(const U1& bit, bool taken_if, const LocationDescriptor& target) {
+    const size_t index = block.AddSideExit(target);
+    Inst(Opcode::SideExitIfBit, bit, Imm1(taken_if), Imm64(index));
+}
+
 U64 IREmitter::Pack2x32To1x64(const U32& lo, const U32& hi) {
     return Inst<U64>(Opcode::Pack2x32To1x64, lo, hi);
 }
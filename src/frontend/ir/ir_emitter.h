@@ -70,6 +70,8 @@ public:
     U64 Imm64(u64 value) const;
 
     void PushRSB(const LocationDescriptor& return_location);
+    void SideExitIf(Cond cond, const LocationDescriptor& target);
+    void SideExitIfBit(const U1& bit, bool taken_if, const LocationDescriptor& target);
 
     U64 Pack2x32To1x64(const U32& lo, const U32& hi);
     U128 Pack2x64To1x128(const U64& lo, const U64& hi);
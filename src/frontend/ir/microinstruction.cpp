@@ -5,6 +5,7 @@
  */
 
 #include <algorithm>
+#include <string_view>
 
 #include <fmt/ostream.h>
 
@@ -103,12 +104,30 @@ bool Inst::IsExclusiveMemoryWrite() const {
     }
 }
 
+bool Inst::IsAtomicMemoryOperation() const {
+    switch (op) {
+    case Opcode::A64AtomicMemoryOp8:
+    case Opcode::A64AtomicMemoryOp16:
+    case Opcode::A64AtomicMemoryOp32:
+    case Opcode::A64AtomicMemoryOp64:
+    case Opcode::A64CompareAndSwapMemory8:
+    case Opcode::A64CompareAndSwapMemory16:
+    case Opcode::A64CompareAndSwapMemory32:
+    case Opcode::A64CompareAndSwapMemory64:
+    case Opcode::A64CompareAndSwapMemory128:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
 bool Inst::IsMemoryRead() const {
-    return IsSharedMemoryRead();
+    return IsSharedMemoryRead() || IsAtomicMemoryOperation();
 }
 
 bool Inst::IsMemoryWrite() const {
-    return IsSharedMemoryWrite() || IsExclusiveMemoryWrite();
+    return IsSharedMemoryWrite() || IsExclusiveMemoryWrite() || IsAtomicMemoryOperation();
 }
 
 bool Inst::IsMemoryReadOrWrite() const {
@@ -201,6 +220,21 @@ bool Inst::WritesToCoreRegister() const {
     }
 }
 
+bool Inst::IsFloatingPointOperation() const {
+    switch (op) {
+#define OPCODE(name, type, ...) case Opcode::name: return std::string_view{#name}.substr(0, 2) == "FP";
+#define A32OPC(name, type, ...) case Opcode::A32##name: return false;
+#define A64OPC(name, type, ...) case Opcode::A64##name: return false;
+#include "opcodes.inc"
+#undef OPCODE
+#undef A32OPC
+#undef A64OPC
+
+    default:
+        return false;
+    }
+}
+
 bool Inst::ReadsFromFPCR() const {
     switch (op) {
     case Opcode::A32GetFpscr:
@@ -370,6 +404,11 @@ bool Inst::CausesCPUException() const {
            op == Opcode::A64ExceptionRaised;
 }
 
+bool Inst::IsSideExit() const {
+    return op == Opcode::SideExitIf ||
+           op == Opcode::SideExitIfBit;
+}
+
 bool Inst::AltersExclusiveState() const {
     return op == Opcode::A32ClearExclusive ||
            op == Opcode::A32SetExclusive   ||
@@ -396,6 +435,7 @@ bool Inst::IsCoprocessorInstruction() const {
 
 bool Inst::MayHaveSideEffects() const {
     return op == Opcode::PushRSB                        ||
+           IsSideExit()                                 ||
            op == Opcode::A64SetCheckBit                 ||
            op == Opcode::A64DataCacheOperationRaised    ||
            op == Opcode::A64DataSynchronizationBarrier  ||
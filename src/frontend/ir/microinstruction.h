@@ -42,6 +42,8 @@ public:
     bool IsSharedMemoryReadOrWrite() const;
     /// Determines whether or not this instruction performs an atomic memory write.
     bool IsExclusiveMemoryWrite() const;
+    /// Determines whether or not this instruction performs an atomic read-modify-write of memory.
+    bool IsAtomicMemoryOperation() const;
 
     /// Determines whether or not this instruction performs any kind of memory read.
     bool IsMemoryRead() const;
@@ -63,6 +65,9 @@ public:
     /// Determines whether or not this instruction writes to a core register.
     bool WritesToCoreRegister() const;
 
+    /// Determines whether or not this instruction is a floating-point operation (one of the FP* opcodes).
+    bool IsFloatingPointOperation() const;
+
     /// Determines whether or not this instruction reads from the FPCR.
     bool ReadsFromFPCR() const;
     /// Determines whether or not this instruction writes to the FPCR.
@@ -94,6 +99,9 @@ public:
     /// Determines whether or not this instruction causes a CPU exception.
     bool CausesCPUException() const;
 
+    /// Determines whether or not this instruction may exit the block before its end.
+    bool IsSideExit() const;
+
     /// Determines whether or not this instruction may have side-effects.
     bool MayHaveSideEffects() const;
 
@@ -0,0 +1,124 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#pragma once
+
+#include <boost/optional.hpp>
+#include <boost/variant/get.hpp>
+
+#include "common/common_types.h"
+#include "frontend/ir/basic_block.h"
+#include "frontend/ir/cond.h"
+#include "frontend/ir/ir_emitter.h"
+#include "frontend/ir/terminal.h"
+
+/**
+ * Helpers shared by the frontends for forming superblocks, i.e.: continuing translation past the end of a basic block.
+ * These are templated on the frontend's LocationDescriptor type, which must provide PC() and SetPC(pc).
+ */
+namespace Dynarmic::IR {
+
+/**
+ * Determines whether a pair of terminals is a forward direct branch to `taken` which otherwise continues at `fallthrough`.
+ * @return The target of the branch if so.
+ */
+template <typename LocationDescriptorType>
+boost::optional<LocationDescriptorType> ForwardBranchTarget(const Terminal& taken, const Terminal& not_taken, const LocationDescriptorType& fallthrough) {
+    const auto* taken_link = boost::get<Term::LinkBlock>(&taken);
+    const auto* not_taken_link = boost::get<Term::LinkBlock>(&not_taken);
+    if (!taken_link || !not_taken_link || LocationDescriptorType{not_taken_link->next} != fallthrough) {
+        return boost::none;
+    }
+    const LocationDescriptorType target{taken_link->next};
+    if (target.PC() < fallthrough.PC() || target != fallthrough.SetPC(target.PC())) {
+        return boost::none;
+    }
+    return target;
+}
+
+/**
+ * Used by the translators when a block has ended. If the block ended with a forward conditional direct branch,
+ * replaces the branch with a side exit so that translation can continue along the fall-through path.
+ * @param block The block being translated.
+ * @param ir The emitter for the block being translated.
+ * @param fallthrough The location after the last translated instruction.
+ * @param max_instructions The number of instructions after which translation should stop.
+ * @return true if translation should continue.
+ */
+template <typename LocationDescriptorType>
+bool ConvertToSideExit(Block& block, IREmitter& ir, const LocationDescriptorType& fallthrough, size_t max_instructions) {
+    if (block.CycleCount() >= max_instructions) {
+        return false;
+    }
+
+    if (block.GetCondition() != Cond::AL) {
+        return false;
+    }
+
+    const auto terminal = block.GetTerminal();
+    const auto* if_ = boost::get<Term::If>(&terminal);
+    if (!if_ || if_->if_ == Cond::AL || if_->if_ == Cond::NV) {
+        return false;
+    }
+
+    if (const auto target = ForwardBranchTarget(if_->then_, if_->else_, fallthrough)) {
+        block.ReplaceTerminal(Term::Invalid{});
+        ir.SideExitIf(if_->if_, *target);
+        return true;
+    }
+    if (const auto target = ForwardBranchTarget(if_->else_, if_->then_, fallthrough)) {
+        block.ReplaceTerminal(Term::Invalid{});
+        ir.SideExitIf(invert(if_->if_), *target);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Used by the translators when a block has ended. If the block ended with an unconditional direct branch
+ * to code with the same processor state, prepares the block for translation to continue at the branch target.
+ * @param block The block being translated.
+ * @param current_location The location after the last translated instruction. Set to the branch target on success.
+ * @param max_instructions The number of instructions after which translation should stop.
+ * @return true if translation should continue.
+ */
+template <typename LocationDescriptorType>
+bool FollowUnconditionalBranch(Block& block, LocationDescriptorType& current_location, size_t max_instructions) {
+    if (block.CycleCount() >= max_instructions) {
+        return false;
+    }
+
+    if (block.GetCondition() != Cond::AL) {
+        return false;
+    }
+
+    const auto terminal = block.GetTerminal();
+    const auto* link = boost::get<Term::LinkBlock>(&terminal);
+    if (!link) {
+        return false;
+    }
+
+    const LocationDescriptorType next{link->next};
+    if (next != current_location.SetPC(next.PC())) {
+        return false;
+    }
+
+    // Do not translate the same guest code twice; loops are left to the block linker.
+    block.SetEndLocation(current_location);
+    for (const auto& [begin, end] : block.TranslatedRanges()) {
+        if (next.PC() >= LocationDescriptorType{begin}.PC() && next.PC() < LocationDescriptorType{end}.PC()) {
+            return false;
+        }
+    }
+
+    block.SplitTranslatedRange(current_location, next);
+    // The branch itself has no further effect on guest state; the terminal will be set by a later instruction.
+    block.ReplaceTerminal(Term::Invalid{});
+    current_location = next;
+    return true;
+}
+
+} // namespace Dynarmic::IR
@@ -65,6 +65,14 @@ struct LinkBlockFast {
  */
 struct PopRSBHint {};
 
+/**
+ * This terminal instruction looks up the current location in an emitted fast dispatch table.
+ * If the lookup fails, the block is looked up and the table entry is updated before jumping to it.
+ * This is an optimization for faster indirect branches. A backend that doesn't support
+ * this optimization may choose to implement this exactly as ReturnToDispatch.
+ */
+struct FastDispatchHint {};
+
 struct If;
 struct CheckBit;
 struct CheckHalt;
@@ -76,6 +84,7 @@ using Terminal = boost::variant<
         LinkBlock,
         LinkBlockFast,
         PopRSBHint,
+        FastDispatchHint,
         boost::recursive_wrapper<If>,
         boost::recursive_wrapper<CheckBit>,
         boost::recursive_wrapper<CheckHalt>
@@ -5,6 +5,7 @@
  */
 
 #include <array>
+#include <initializer_list>
 
 #include "common/assert.h"
 #include "common/common_types.h"
@@ -155,6 +156,24 @@ void A32GetSetElimination(IR::Block& block) {
             do_get(cpsr_info.ge, inst);
             break;
         }
+        case IR::Opcode::SideExitIf:
+        case IR::Opcode::SideExitIfBit: {
+            // Guest state must be up to date if the exit is taken, so earlier sets must be kept.
+            // Known register values remain valid on the path past the exit.
+            for (auto& info : reg_info) {
+                info.set_instruction_present = false;
+            }
+            for (auto& info : ext_reg_singles_info) {
+                info.set_instruction_present = false;
+            }
+            for (auto& info : ext_reg_doubles_info) {
+                info.set_instruction_present = false;
+            }
+            for (auto* info : {&cpsr_info.n, &cpsr_info.z, &cpsr_info.c, &cpsr_info.v, &cpsr_info.ge}) {
+                info->set_instruction_present = false;
+            }
+            break;
+        }
         default: {
             if (inst->ReadsFromCPSR() || inst->WritesToCPSR()) {
                 cpsr_info = {};
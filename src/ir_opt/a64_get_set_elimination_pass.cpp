@@ -132,6 +132,20 @@ void A64GetSetElimination(IR::Block& block) {
             do_set(nzcv_info, inst->GetArg(0), inst, TrackingType::NZCV);
             break;
         }
+        case IR::Opcode::SideExitIf:
+        case IR::Opcode::SideExitIfBit: {
+            // Guest state must be up to date if the exit is taken, so earlier sets must be kept.
+            // Known register values remain valid on the path past the exit.
+            for (auto& info : reg_info) {
+                info.set_instruction_present = false;
+            }
+            for (auto& info : vec_info) {
+                info.set_instruction_present = false;
+            }
+            sp_info.set_instruction_present = false;
+            nzcv_info.set_instruction_present = false;
+            break;
+        }
         default: {
             if (inst->ReadsFromCPSR() || inst->WritesToCPSR()) {
                 nzcv_info = {};
@@ -0,0 +1,140 @@
+/* This file is part of the dynarmic project.
+ * Copyright (c) 2018 MerryMage
+ * This software may be used and distributed according to the terms of the GNU
+ * General Public License version 2 or any later version.
+ */
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "frontend/ir/basic_block.h"
+#include "frontend/ir/microinstruction.h"
+#include "frontend/ir/opcodes.h"
+#include "frontend/ir/value.h"
+#include "ir_opt/passes.h"
+
+namespace Dynarmic::Optimization {
+
+namespace {
+
+/// Instructions whose result depends only on their arguments.
+bool IsPure(IR::Opcode op) {
+    switch (op) {
+    case IR::Opcode::Pack2x32To1x64:
+    case IR::Opcode::LeastSignificantWord:
+    case IR::Opcode::LeastSignificantHalf:
+    case IR::Opcode::LeastSignificantByte:
+    case IR::Opcode::MostSignificantBit:
+    case IR::Opcode::IsZero32:
+    case IR::Opcode::IsZero64:
+    case IR::Opcode::TestBit:
+    case IR::Opcode::LogicalShiftLeft32:
+    case IR::Opcode::LogicalShiftLeft64:
+    case IR::Opcode::LogicalShiftRight32:
+    case IR::Opcode::LogicalShiftRight64:
+    case IR::Opcode::ArithmeticShiftRight32:
+    case IR::Opcode::ArithmeticShiftRight64:
+    case IR::Opcode::RotateRight32:
+    case IR::Opcode::RotateRight64:
+    case IR::Opcode::Add32:
+    case IR::Opcode::Add64:
+    case IR::Opcode::Sub32:
+    case IR::Opcode::Sub64:
+    case IR::Opcode::Mul32:
+    case IR::Opcode::Mul64:
+    case IR::Opcode::And32:
+    case IR::Opcode::And64:
+    case IR::Opcode::Eor32:
+    case IR::Opcode::Eor64:
+    case IR::Opcode::Or32:
+    case IR::Opcode::Or64:
+    case IR::Opcode::Not32:
+    case IR::Opcode::Not64:
+    case IR::Opcode::SignExtendByteToWord:
+    case IR::Opcode::SignExtendHalfToWord:
+    case IR::Opcode::SignExtendByteToLong:
+    case IR::Opcode::SignExtendHalfToLong:
+    case IR::Opcode::SignExtendWordToLong:
+    case IR::Opcode::ZeroExtendByteToWord:
+    case IR::Opcode::ZeroExtendHalfToWord:
+    case IR::Opcode::ZeroExtendByteToLong:
+    case IR::Opcode::ZeroExtendHalfToLong:
+    case IR::Opcode::ZeroExtendWordToLong:
+        return true;
+    default:
+        return false;
+    }
+}
+
+IR::Value Resolve(IR::Value value) {
+    while (!value.IsImmediate() && value.GetInst()->GetOpcode() == IR::Opcode::Identity) {
+        value = value.GetInst()->GetArg(0);
+    }
+    return value;
+}
+
+bool IsSameValue(const IR::Value& a_, const IR::Value& b_) {
+    const IR::Value a = Resolve(a_);
+    const IR::Value b = Resolve(b_);
+
+    if (a.IsImmediate() != b.IsImmediate()) {
+        return false;
+    }
+    if (!a.IsImmediate()) {
+        return a.GetInst() == b.GetInst();
+    }
+    if (a.GetType() != b.GetType()) {
+        return false;
+    }
+
+    switch (a.GetType()) {
+    case IR::Type::U1:
+        return a.GetU1() == b.GetU1();
+    case IR::Type::U8:
+        return a.GetU8() == b.GetU8();
+    case IR::Type::U16:
+        return a.GetU16() == b.GetU16();
+    case IR::Type::U32:
+        return a.GetU32() == b.GetU32();
+    case IR::Type::U64:
+        return a.GetU64() == b.GetU64();
+    default:
+        return false;
+    }
+}
+
+bool IsSameComputation(const IR::Inst& a, const IR::Inst& b) {
+    for (size_t i = 0; i < a.NumArgs(); i++) {
+        if (!IsSameValue(a.GetArg(i), b.GetArg(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+void CommonSubexpressionElimination(IR::Block& block) {
+    std::map<IR::Opcode, std::vector<IR::Inst*>> available;
+
+    for (auto& inst : block) {
+        // Instructions with pseudo-operations attached produce more than one result; leave them alone.
+        if (!IsPure(inst.GetOpcode()) || inst.HasAssociatedPseudoOperation()) {
+            continue;
+        }
+
+        auto& candidates = available[inst.GetOpcode()];
+        const auto iter = std::find_if(candidates.begin(), candidates.end(), [&inst](IR::Inst* candidate) {
+            return IsSameComputation(*candidate, inst);
+        });
+
+        if (iter != candidates.end()) {
+            inst.ReplaceUsesWith(IR::Value{*iter});
+        } else {
+            candidates.push_back(&inst);
+        }
+    }
+}
+
+} // namespace Dynarmic::Optimization
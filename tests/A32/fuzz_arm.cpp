@@ -6,16 +6,20 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cinttypes>
 #include <cstdio>
 #include <cstring>
 #include <functional>
+#include <memory>
+#include <thread>
 #include <tuple>
 #include <vector>
 
 #include <catch.hpp>
 
 #include <dynarmic/A32/a32.h>
+#include <dynarmic/exclusive_monitor.h>
 
 #include "common/bit_util.h"
 #include "common/common_types.h"
@@ -37,6 +41,10 @@
 #include <signal.h>
 #endif
 
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/mman.h>
+#endif
+
 using Dynarmic::Common::Bits;
 
 static Dynarmic::A32::UserConfig GetUserConfig(ArmTestEnv* testenv) {
@@ -1190,3 +1198,368 @@ TEST_CASE("arm: Test InvalidateCacheRange", "[arm][A32]") {
     REQUIRE(jit.Regs()[15] == 0x0000000c);
     REQUIRE(jit.Cpsr() == 0x000001d0);
 }
+
+TEST_CASE("arm: Inline caches for BX and BLX", "[arm][A32]") {
+    ArmTestEnv test_env;
+    Dynarmic::A32::Jit jit{GetUserConfig(&test_env)};
+    test_env.code_mem.fill({});
+
+    jit.Regs() = {};
+    jit.SetCpsr(0x000001d0); // User-mode
+
+    SECTION("Monomorphic") {
+        test_env.code_mem[0] = 0xe2800001; // add r0, r0, #1
+        test_env.code_mem[1] = 0xe12fff31; // blx r1
+        test_env.code_mem[2] = 0xe3500014; // cmp r0, #20
+        test_env.code_mem[3] = 0x1afffffb; // bne 0
+        test_env.code_mem[4] = 0xeafffffe; // b +#0 (infinite loop)
+        test_env.code_mem[0x100 / 4 + 0] = 0xe2822001; // add r2, r2, #1
+        test_env.code_mem[0x100 / 4 + 1] = 0xe12fff1e; // bx lr
+
+        jit.Regs()[1] = 0x100;
+        test_env.ticks_left = 1000;
+        jit.Run();
+
+        REQUIRE(jit.Regs()[0] == 20);
+        REQUIRE(jit.Regs()[2] == 20);
+        REQUIRE(jit.Regs()[15] == 0x10);
+
+        // The cached target must not be used once it has been invalidated.
+        test_env.code_mem[0x100 / 4 + 0] = 0xe2822002; // add r2, r2, #2
+        jit.InvalidateCacheRange(0x100, 4);
+
+        jit.Regs()[0] = 0;
+        jit.Regs()[2] = 0;
+        jit.Regs()[15] = 0;
+        test_env.ticks_left = 1000;
+        jit.Run();
+
+        REQUIRE(jit.Regs()[0] == 20);
+        REQUIRE(jit.Regs()[2] == 40);
+        REQUIRE(jit.Regs()[15] == 0x10);
+    }
+
+    SECTION("Interworking") {
+        test_env.code_mem[0] = 0xe2800001; // add r0, r0, #1
+        test_env.code_mem[1] = 0xe2211021; // eor r1, r1, #0x21
+        test_env.code_mem[2] = 0xe12fff31; // blx r1
+        test_env.code_mem[3] = 0xe3500014; // cmp r0, #20
+        test_env.code_mem[4] = 0x1afffffa; // bne 0
+        test_env.code_mem[5] = 0xeafffffe; // b +#0 (infinite loop)
+        test_env.code_mem[0x100 / 4] = 0xe2822001; // add r2, r2, #1
+        test_env.code_mem[0x104 / 4] = 0xe12fff1e; // bx lr
+        test_env.code_mem[0x120 / 4] = 0x47703202; // adds r2, #2; bx lr (Thumb)
+
+        // Alternates between an ARM target and a Thumb target, which must be cached separately.
+        jit.Regs()[1] = 0x100;
+        test_env.ticks_left = 1000;
+        jit.Run();
+
+        REQUIRE(jit.Regs()[0] == 20);
+        REQUIRE(jit.Regs()[2] == 30);
+        REQUIRE(jit.Regs()[15] == 0x14);
+        REQUIRE((jit.Cpsr() & 0x20) == 0); // Back in ARM state
+    }
+
+    SECTION("Polymorphic") {
+        test_env.code_mem[0] = 0xe2800001; // add r0, r0, #1
+        test_env.code_mem[1] = 0xe2001003; // and r1, r0, #3
+        test_env.code_mem[2] = 0xe0831181; // add r1, r3, r1, lsl #3
+        test_env.code_mem[3] = 0xe12fff31; // blx r1
+        test_env.code_mem[4] = 0xe3500064; // cmp r0, #100
+        test_env.code_mem[5] = 0x1afffff9; // bne 0
+        test_env.code_mem[6] = 0xeafffffe; // b +#0 (infinite loop)
+        for (size_t i = 0; i < 4; i++) {
+            test_env.code_mem[0x100 / 4 + i * 2 + 0] = 0xe2822001; // add r2, r2, #1
+            test_env.code_mem[0x100 / 4 + i * 2 + 1] = 0xe12fff1e; // bx lr
+        }
+
+        // More targets than an inline cache holds, so this site degrades to normal dispatch.
+        jit.Regs()[3] = 0x100;
+        test_env.ticks_left = 2000;
+        jit.Run();
+
+        REQUIRE(jit.Regs()[0] == 100);
+        REQUIRE(jit.Regs()[2] == 100);
+        REQUIRE(jit.Regs()[15] == 0x18);
+    }
+}
+
+TEST_CASE("arm: MXCSR is only switched for floating-point code", "[arm][A32]") {
+    ArmTestEnv test_env;
+    Dynarmic::A32::UserConfig config = GetUserConfig(&test_env);
+    config.enable_statistics = true;
+    Dynarmic::A32::Jit jit{config};
+    test_env.code_mem.fill({});
+    test_env.code_mem[0] = 0xe2800001; // add r0, r0, #1
+    test_env.code_mem[1] = 0xeafffffe; // b +#0 (infinite loop)
+    test_env.code_mem[2] = 0xee300a81; // vadd.f32 s0, s1, s2
+    test_env.code_mem[3] = 0xeafffffe; // b +#0 (infinite loop)
+
+    jit.Regs() = {};
+    jit.SetCpsr(0x000001d0); // User-mode
+
+    test_env.ticks_left = 2;
+    jit.Run();
+
+    REQUIRE(jit.Regs()[0] == 1);
+    REQUIRE(jit.GetMXCSRAccessCount() == 0);
+
+    jit.ExtRegs()[1] = 0x3f800000; // 1.0
+    jit.ExtRegs()[2] = 0x3f800000; // 1.0
+    jit.Regs()[15] = 8;
+
+    test_env.ticks_left = 2;
+    jit.Run();
+
+    REQUIRE(jit.ExtRegs()[0] == 0x40000000); // 2.0
+    REQUIRE(jit.GetMXCSRAccessCount() == 4);
+}
+
+namespace {
+
+// Copies a word from a mapped page to an unmapped one and back again.
+void RunMemoryCopyTest(ArmTestEnv& test_env, Dynarmic::A32::Jit& jit, u8* mapped_page) {
+    test_env.code_mem.fill({});
+    test_env.code_mem[0] = 0xe5901000; // ldr r1, [r0]
+    test_env.code_mem[1] = 0xe5821000; // str r1, [r2]
+    test_env.code_mem[2] = 0xe5923000; // ldr r3, [r2]
+    test_env.code_mem[3] = 0xe5803004; // str r3, [r0, #4]
+    test_env.code_mem[4] = 0xeafffffe; // b +#0 (infinite loop)
+
+    // The second run executes code emitted during the first.
+    for (u32 value : {0x01234567u, 0x89abcdefu}) {
+        std::memcpy(mapped_page, &value, sizeof(value));
+        test_env.modified_memory.clear();
+
+        jit.Regs() = {};
+        jit.Regs()[0] = 0x10000; // Mapped
+        jit.Regs()[2] = 0x20000; // Not mapped
+        jit.SetCpsr(0x000001d0); // User-mode
+
+        test_env.ticks_left = 5;
+        jit.Run();
+
+        u32 copied;
+        std::memcpy(&copied, mapped_page + 4, sizeof(copied));
+        REQUIRE(jit.Regs()[1] == value);
+        REQUIRE(jit.Regs()[3] == value);
+        REQUIRE(copied == value);
+        REQUIRE(test_env.MemoryRead32(0x20000) == value);
+        REQUIRE(test_env.modified_memory.size() == 4);
+    }
+}
+
+// Accesses a word straddling the end of a mapped page and the start of the unmapped page after it.
+void RunPageCrossingTest(ArmTestEnv& test_env, Dynarmic::A32::Jit& jit, u8* mapped_page) {
+    test_env.code_mem.fill({});
+    test_env.code_mem[0] = 0xe5901000; // ldr r1, [r0]
+    test_env.code_mem[1] = 0xe5802000; // str r2, [r0]
+    test_env.code_mem[2] = 0xeafffffe; // b +#0 (infinite loop)
+
+    mapped_page[0xffe] = 0xab;
+    mapped_page[0xfff] = 0xcd;
+
+    // The second run executes code emitted during the first.
+    for (size_t i = 0; i < 2; i++) {
+        test_env.modified_memory.clear();
+
+        jit.Regs() = {};
+        jit.Regs()[0] = 0x10ffe;
+        jit.Regs()[2] = 0x11223344;
+        jit.SetCpsr(0x000001d0); // User-mode
+
+        test_env.ticks_left = 3;
+        jit.Run();
+
+        // The whole access is made through the callbacks, to which each byte reads as the low byte of its address.
+        REQUIRE(jit.Regs()[1] == 0x0100fffe);
+        REQUIRE(test_env.modified_memory.size() == 4);
+        REQUIRE(test_env.MemoryRead32(0x10ffe) == 0x11223344);
+        REQUIRE(mapped_page[0xffe] == 0xab);
+        REQUIRE(mapped_page[0xfff] == 0xcd);
+    }
+}
+
+} // anonymous namespace
+
+TEST_CASE("arm: Page table", "[arm][A32]") {
+    auto page_table = std::make_unique<std::array<u8*, Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES>>();
+    page_table->fill(nullptr);
+    std::array<u8, 4096> page{};
+    (*page_table)[0x10000 >> Dynarmic::A32::UserConfig::PAGE_BITS] = page.data();
+
+    ArmTestEnv test_env;
+    Dynarmic::A32::UserConfig config = GetUserConfig(&test_env);
+    config.page_table = page_table.get();
+    Dynarmic::A32::Jit jit{config};
+
+    SECTION("Memory copy") {
+        RunMemoryCopyTest(test_env, jit, page.data());
+    }
+    SECTION("Page crossing") {
+        RunPageCrossingTest(test_env, jit, page.data());
+    }
+}
+
+namespace {
+
+// Memory shared between processors: code at address 0 and two counters, 32 and 64 bits wide.
+class SharedCountersEnv final : public Dynarmic::A32::UserCallbacks {
+public:
+    static constexpr u32 counter32_vaddr = 0x10000;
+    static constexpr u32 counter64_vaddr = 0x10008;
+
+    u64 ticks_left = 0;
+    std::vector<u32> code_mem;
+    std::atomic<u32>* counter32 = nullptr;
+    std::atomic<u64>* counter64 = nullptr;
+
+    std::uint32_t MemoryReadCode(u32 vaddr) override {
+        return vaddr / 4 < code_mem.size() ? code_mem[vaddr / 4] : 0xeafffffe; // b +#0
+    }
+
+    std::uint8_t MemoryRead8(u32 vaddr) override { return static_cast<u8>(MemoryRead32(vaddr)); }
+    std::uint16_t MemoryRead16(u32 vaddr) override { return static_cast<u16>(MemoryRead32(vaddr)); }
+    std::uint32_t MemoryRead32(u32 vaddr) override {
+        switch (vaddr) {
+        case counter32_vaddr:
+            return counter32->load();
+        case counter64_vaddr:
+            return static_cast<u32>(counter64->load());
+        case counter64_vaddr + 4:
+            return static_cast<u32>(counter64->load() >> 32);
+        }
+        ASSERT_MSG(false, "MemoryRead32({:08x})", vaddr);
+        return 0;
+    }
+    std::uint64_t MemoryRead64(u32 vaddr) override {
+        return u64(MemoryRead32(vaddr)) | u64(MemoryRead32(vaddr + 4)) << 32;
+    }
+
+    void MemoryWrite8(u32 vaddr, std::uint8_t) override { ASSERT_MSG(false, "MemoryWrite8({:08x})", vaddr); }
+    void MemoryWrite16(u32 vaddr, std::uint16_t) override { ASSERT_MSG(false, "MemoryWrite16({:08x})", vaddr); }
+    void MemoryWrite32(u32 vaddr, std::uint32_t value) override {
+        ASSERT(vaddr == counter32_vaddr);
+        counter32->store(value);
+    }
+    void MemoryWrite64(u32 vaddr, std::uint64_t value) override {
+        ASSERT(vaddr == counter64_vaddr);
+        counter64->store(value);
+    }
+
+    void InterpreterFallback(u32 pc, size_t num_instructions) override { ASSERT_MSG(false, "InterpreterFallback({:08x}, {})", pc, num_instructions); }
+    void CallSVC(std::uint32_t swi) override { ASSERT_MSG(false, "CallSVC({})", swi); }
+    void ExceptionRaised(u32 pc, Dynarmic::A32::Exception) override { ASSERT_MSG(false, "ExceptionRaised({:08x})", pc); }
+
+    void AddTicks(std::uint64_t ticks) override { ticks_left -= std::min(ticks, ticks_left); }
+    std::uint64_t GetTicksRemaining() override { return ticks_left; }
+};
+
+} // anonymous namespace
+
+TEST_CASE("arm: Global monitor with concurrent processors", "[arm][A32]") {
+    constexpr size_t processor_count = 2;
+    constexpr u32 iterations = 50000;
+
+    auto page_table = std::make_unique<std::array<u8*, Dynarmic::A32::UserConfig::NUM_PAGE_TABLE_ENTRIES>>();
+    page_table->fill(nullptr);
+    alignas(8) std::array<u8, 4096> page{};
+    std::atomic<u32> counter32{0};
+    std::atomic<u64> counter64{0xffff'fff0};
+
+    bool use_page_table = false;
+    SECTION("Memory callbacks") {
+        use_page_table = false;
+    }
+    SECTION("Page table") {
+        use_page_table = true;
+        (*page_table)[SharedCountersEnv::counter32_vaddr >> Dynarmic::A32::UserConfig::PAGE_BITS] = page.data();
+        const u64 initial64 = counter64.load();
+        std::memcpy(page.data() + (SharedCountersEnv::counter64_vaddr & 0xfff), &initial64, sizeof(initial64));
+    }
+
+    Dynarmic::ExclusiveMonitor monitor{processor_count};
+    std::array<SharedCountersEnv, processor_count> envs;
+    std::vector<std::unique_ptr<Dynarmic::A32::Jit>> jits;
+
+    for (size_t i = 0; i < processor_count; i++) {
+        envs[i].counter32 = &counter32;
+        envs[i].counter64 = &counter64;
+        envs[i].code_mem = {
+            0xe1901f9f, // ldrex r1, [r0]
+            0xe2811001, // add r1, r1, #1
+            0xe1802f91, // strex r2, r1, [r0]
+            0xe3520000, // cmp r2, #0
+            0x1afffffa, // bne #-24
+            0xe1b64f9f, // ldrexd r4, r5, [r6]
+            0xe2944001, // adds r4, r4, #1
+            0xe2a55000, // adc r5, r5, #0
+            0xe1a62f94, // strexd r2, r4, r5, [r6]
+            0xe3520000, // cmp r2, #0
+            0x1afffff9, // bne #-28
+            0xe2533001, // subs r3, r3, #1
+            0x1afffff2, // bne #-56
+            0xeafffffe, // b +#0 (infinite loop)
+        };
+
+        Dynarmic::A32::UserConfig config{};
+        config.callbacks = &envs[i];
+        config.processor_id = i;
+        config.global_monitor = &monitor;
+        config.page_table = page_table.get();
+        jits.emplace_back(std::make_unique<Dynarmic::A32::Jit>(config));
+
+        jits[i]->Regs()[0] = SharedCountersEnv::counter32_vaddr;
+        jits[i]->Regs()[3] = iterations;
+        jits[i]->Regs()[6] = SharedCountersEnv::counter64_vaddr;
+        jits[i]->SetCpsr(0x000001d0); // User-mode
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < processor_count; i++) {
+        threads.emplace_back([&, i] {
+            while (jits[i]->Regs()[15] != 0x34) {
+                envs[i].ticks_left = 100000;
+                jits[i]->Run();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    u32 result32 = counter32.load();
+    u64 result64 = counter64.load();
+    if (use_page_table) {
+        std::memcpy(&result32, page.data() + (SharedCountersEnv::counter32_vaddr & 0xfff), sizeof(result32));
+        std::memcpy(&result64, page.data() + (SharedCountersEnv::counter64_vaddr & 0xfff), sizeof(result64));
+    }
+    REQUIRE(result32 == processor_count * iterations);
+    REQUIRE(result64 == 0xffff'fff0 + processor_count * iterations);
+}
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+TEST_CASE("arm: Fastmem", "[arm][A32]") {
+    constexpr size_t page_size = 4096;
+    constexpr size_t reservation_size = (size_t(1) << 32) + page_size;
+    void* const reservation = mmap(nullptr, reservation_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    REQUIRE(reservation != MAP_FAILED);
+    u8* const fastmem = static_cast<u8*>(reservation);
+    REQUIRE(mprotect(fastmem + 0x10000, page_size, PROT_READ | PROT_WRITE) == 0);
+
+    ArmTestEnv test_env;
+    Dynarmic::A32::UserConfig config = GetUserConfig(&test_env);
+    config.fastmem_pointer = fastmem;
+    Dynarmic::A32::Jit jit{config};
+
+    SECTION("Memory copy") {
+        RunMemoryCopyTest(test_env, jit, fastmem + 0x10000);
+    }
+    SECTION("Page crossing") {
+        RunPageCrossingTest(test_env, jit, fastmem + 0x10000);
+    }
+
+    munmap(reservation, reservation_size);
+}
+#endif
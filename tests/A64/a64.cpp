@@ -4,6 +4,25 @@
  * General Public License version 2 or any later version.
  */
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <xmmintrin.h>
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+#include <sys/mman.h>
+#endif
+
 #include <catch.hpp>
 
 #include <dynarmic/A64/exclusive_monitor.h>
@@ -314,6 +333,185 @@ TEST_CASE("A64: 128-bit exclusive read/write", "[a64]") {
     REQUIRE(env.MemoryRead64(0x1234567812345680) == 0xd0d0cacad0d0caca);
 }
 
+TEST_CASE("A64: Global monitor with concurrent processors", "[a64]") {
+    constexpr size_t processor_count = 2;
+    constexpr u64 increments = 100000;
+    constexpr u64 counter_vaddr = 0x10000;
+
+    std::array<u64, 512> page{};
+    std::vector<void*> page_table(256);
+    std::atomic<u64> counter{0};
+
+    Dynarmic::A64::ExclusiveMonitor monitor{processor_count};
+    std::array<A64TestEnv, processor_count> envs;
+    std::vector<HookedA64TestEnv> hooked_envs;
+    hooked_envs.reserve(processor_count);
+    std::vector<std::unique_ptr<Dynarmic::A64::Jit>> jits;
+
+    bool use_page_table = false;
+    SECTION("Memory callbacks") {
+        use_page_table = false;
+    }
+    SECTION("Page table") {
+        use_page_table = true;
+        page_table[counter_vaddr >> 12] = page.data();
+    }
+
+    for (size_t i = 0; i < processor_count; i++) {
+        auto& hooked_env = hooked_envs.emplace_back(envs[i]);
+        hooked_env.memory_read_64 = [&, i](u64 vaddr) {
+            return vaddr == counter_vaddr ? counter.load() : envs[i].MemoryRead64(vaddr);
+        };
+        hooked_env.memory_write_64 = [&, i](u64 vaddr, u64 value) {
+            if (vaddr == counter_vaddr) {
+                counter.store(value);
+                return;
+            }
+            envs[i].MemoryWrite64(vaddr, value);
+        };
+        envs[i].code_mem = {
+            0xc85f7c01, // LDXR X1, [X0]
+            0x91000421, // ADD X1, X1, #1
+            0xc8027c01, // STXR W2, X1, [X0]
+            0x35ffffa2, // CBNZ W2, -12
+            0xf1000463, // SUBS X3, X3, #1
+            0x54ffff61, // B.NE -20
+            0x14000000, // B .
+        };
+
+        Dynarmic::A64::UserConfig conf{&hooked_env};
+        conf.processor_id = i;
+        conf.global_monitor = &monitor;
+        conf.page_table = page_table.data();
+        conf.page_table_address_space_bits = 20;
+        jits.emplace_back(std::make_unique<Dynarmic::A64::Jit>(conf));
+
+        jits[i]->SetRegister(0, counter_vaddr);
+        jits[i]->SetRegister(3, increments);
+        jits[i]->SetPC(0);
+    }
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < processor_count; i++) {
+        threads.emplace_back([&, i] {
+            while (jits[i]->GetPC() != 24) {
+                envs[i].ticks_left = 100000;
+                jits[i]->Run();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    REQUIRE((use_page_table ? page[0] : counter.load()) == processor_count * increments);
+}
+
+TEST_CASE("A64: Atomic memory operations", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+
+    constexpr u64 base = 0x20000;
+    std::array<u64, 512> page{};
+    std::vector<void*> page_table(256);
+
+    bool mapped = false;
+    SECTION("Memory callbacks") {
+        mapped = false;
+    }
+    SECTION("Page table") {
+        mapped = true;
+        page_table[base >> 12] = page.data();
+        conf.page_table = page_table.data();
+        conf.page_table_address_space_bits = 20;
+    }
+    SECTION("Page table fallback") {
+        mapped = false;
+        conf.page_table = page_table.data();
+        conf.page_table_address_space_bits = 20;
+    }
+
+    Dynarmic::A64::Jit jit{conf};
+
+    const auto write64 = [&](u64 vaddr, u64 value) {
+        if (mapped) {
+            page[(vaddr - base) / 8] = value;
+        } else {
+            env.MemoryWrite64(vaddr, value);
+        }
+    };
+    const auto read64 = [&](u64 vaddr) {
+        return mapped ? page[(vaddr - base) / 8] : env.MemoryRead64(vaddr);
+    };
+
+    env.code_mem.emplace_back(0xf8210282); // LDADD X1, X2, [X20]
+    env.code_mem.emplace_back(0xb82312a4); // LDCLR W3, W4, [X21]
+    env.code_mem.emplace_back(0x782542c6); // LDSMAXH W5, W6, [X22]
+    env.code_mem.emplace_back(0x382772e8); // LDUMINB W7, W8, [X23]
+    env.code_mem.emplace_back(0xf829830b); // SWP X9, X11, [X24]
+    env.code_mem.emplace_back(0xc8ac7f2d); // CAS X12, X13, [X25]
+    env.code_mem.emplace_back(0xc8ae7f2d); // CAS X14, X13, [X25]
+    env.code_mem.emplace_back(0x48307f52); // CASP X16, X17, X18, X19, [X26]
+    env.code_mem.emplace_back(0xf8bfc36f); // LDAPR X15, [X27]
+    env.code_mem.emplace_back(0xf83d539f); // STSMIN X29, [X28]
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    write64(base + 0x00, 0x10);
+    write64(base + 0x08, 0xffffffff'f0f0f0f0);
+    write64(base + 0x10, 0x8000);
+    write64(base + 0x18, 0x80);
+    write64(base + 0x20, 0x1111);
+    write64(base + 0x28, 0x3333);
+    write64(base + 0x30, 0x5555);
+    write64(base + 0x38, 0x6666);
+    write64(base + 0x40, 0xdead);
+    write64(base + 0x48, 5);
+
+    for (size_t i = 0; i < 10; i++) {
+        jit.SetRegister(20 + i, base + i * 8);
+    }
+    jit.SetRegister(26, base + 0x30);
+    jit.SetRegister(27, base + 0x40);
+    jit.SetRegister(28, base + 0x48);
+    jit.SetRegister(1, 5);
+    jit.SetRegister(3, 0xff00ff00);
+    jit.SetRegister(5, 0x0001);
+    jit.SetRegister(7, 0x7f);
+    jit.SetRegister(9, 0x2222);
+    jit.SetRegister(12, 0x3333);
+    jit.SetRegister(13, 0x4444);
+    jit.SetRegister(14, 0x3333);
+    jit.SetRegister(16, 0x5555);
+    jit.SetRegister(17, 0x6666);
+    jit.SetRegister(18, 0x7777);
+    jit.SetRegister(19, 0x8888);
+    jit.SetRegister(29, u64(-3));
+    jit.SetPC(0);
+
+    env.ticks_left = 11;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(2) == 0x10);
+    REQUIRE(read64(base + 0x00) == 0x15);
+    REQUIRE(jit.GetRegister(4) == 0xf0f0f0f0);
+    REQUIRE(read64(base + 0x08) == 0xffffffff'00f000f0);
+    REQUIRE(jit.GetRegister(6) == 0x8000);
+    REQUIRE(read64(base + 0x10) == 0x0001);
+    REQUIRE(jit.GetRegister(8) == 0x80);
+    REQUIRE(read64(base + 0x18) == 0x7f);
+    REQUIRE(jit.GetRegister(11) == 0x1111);
+    REQUIRE(read64(base + 0x20) == 0x2222);
+    REQUIRE(jit.GetRegister(12) == 0x3333);
+    REQUIRE(jit.GetRegister(14) == 0x4444);
+    REQUIRE(read64(base + 0x28) == 0x4444);
+    REQUIRE(jit.GetRegister(16) == 0x5555);
+    REQUIRE(jit.GetRegister(17) == 0x6666);
+    REQUIRE(read64(base + 0x30) == 0x7777);
+    REQUIRE(read64(base + 0x38) == 0x8888);
+    REQUIRE(jit.GetRegister(15) == 0xdead);
+    REQUIRE(read64(base + 0x48) == u64(-3));
+}
+
 TEST_CASE("A64: CNTPCT_EL0", "[a64]") {
     A64TestEnv env;
     Dynarmic::A64::Jit jit{Dynarmic::A64::UserConfig{&env}};
@@ -428,3 +626,974 @@ TEST_CASE("A64: FMLA.4S (0x80800000)", "[a64]") {
 
     REQUIRE(jit.GetVector(11) == Vector{0xc79b271e7fc00000, 0x7fc0000080000000});
 }
+
+TEST_CASE("A64: Fast dispatch of BR", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::Jit jit{Dynarmic::A64::UserConfig{&env}};
+
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0xd61f0020); // BR X1
+
+    jit.SetRegister(0, 0);
+    jit.SetRegister(1, 0);
+    jit.SetPC(0);
+
+    env.ticks_left = 10;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 5);
+    REQUIRE(jit.GetPC() == 0);
+
+    // The fast dispatch table must not retain entries for invalidated blocks.
+    env.code_mem[0] = 0x91000800; // ADD X0, X0, #2
+    jit.InvalidateCacheRange(0, 4);
+
+    env.ticks_left = 10;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 15);
+    REQUIRE(jit.GetPC() == 0);
+}
+
+TEST_CASE("A64: Polymorphic BR", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.enable_statistics = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.resize(0x120 / 4, 0xd503201f); // NOP
+    env.code_mem[0] = 0x91000400; // ADD X0, X0, #1
+    env.code_mem[1] = 0x92400401; // AND X1, X0, #3
+    env.code_mem[2] = 0x8b010c61; // ADD X1, X3, X1, LSL #3
+    env.code_mem[3] = 0xd61f0020; // BR X1
+    const std::array<u32, 4> branches_back{0x17ffffbf, 0x17ffffbd, 0x17ffffbb, 0x17ffffb9};
+    for (size_t i = 0; i < branches_back.size(); i++) {
+        env.code_mem[0x100 / 4 + i * 2 + 0] = 0x91000442; // ADD X2, X2, #1
+        env.code_mem[0x100 / 4 + i * 2 + 1] = branches_back[i]; // B 0
+    }
+
+    jit.SetRegister(0, 0);
+    jit.SetRegister(2, 0);
+    jit.SetRegister(3, 0x100);
+    jit.SetPC(0);
+
+    // More targets than an inline cache holds, so this site degrades to normal dispatch.
+    env.ticks_left = 600;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 100);
+    REQUIRE(jit.GetRegister(2) == 100);
+    REQUIRE(jit.GetPC() == 0);
+
+    // Once degraded, the site is served by the fast dispatch table, which misses once for each target.
+    REQUIRE(jit.GetFastDispatchMissCount() <= branches_back.size());
+    REQUIRE(jit.GetFastDispatchHitCount() >= 80);
+}
+
+TEST_CASE("A64: Inline caches across invalidation and eviction", "[a64]") {
+    A64TestEnv env;
+
+    SECTION("Invalidation") {
+        Dynarmic::A64::Jit jit{Dynarmic::A64::UserConfig{&env}};
+
+        env.code_mem.resize(0x108 / 4, 0xd503201f); // NOP
+        env.code_mem[0] = 0x91000400; // ADD X0, X0, #1
+        env.code_mem[1] = 0xf100281f; // CMP X0, #10
+        env.code_mem[2] = 0x54000060; // B.EQ .+12
+        env.code_mem[3] = 0xd61f0020; // BR X1
+        env.code_mem[5] = 0x14000000; // B .
+        env.code_mem[0x104 / 4] = 0x17ffffbf; // B 0
+
+        // Both the block with the inline cache and its target are recompiled repeatedly.
+        for (u32 round = 0; round < 20; round++) {
+            const u32 increment = (round / 2) % 3 + 1;
+            env.code_mem[0x100 / 4] = 0x91000042 | (increment << 10); // ADD X2, X2, #increment
+            jit.InvalidateCacheRange(0, 0x10);
+            if (round % 2 == 0) {
+                jit.InvalidateCacheRange(0x100, 4);
+            }
+
+            jit.SetRegister(0, 0);
+            jit.SetRegister(1, 0x100);
+            jit.SetRegister(2, 0);
+            jit.SetPC(0);
+            env.ticks_left = 100;
+            jit.Run();
+
+            REQUIRE(jit.GetRegister(0) == 10);
+            REQUIRE(jit.GetRegister(2) == 9 * increment);
+            REQUIRE(jit.GetPC() == 0x14);
+        }
+    }
+
+    SECTION("Eviction") {
+        Dynarmic::A64::UserConfig conf{&env};
+        conf.code_cache_near_size = 5 * 1024 * 1024;
+        conf.code_cache_far_size = 4 * 1024 * 1024;
+        conf.code_cache_constant_pool_size = 64 * 1024;
+        Dynarmic::A64::Jit jit{conf};
+
+        // Each block ends in its own inline cache. There are enough blocks that older parts of the cache must be reused.
+        constexpr u32 block_count = 20000;
+        for (u32 i = 0; i < block_count; i++) {
+            env.code_mem.emplace_back(0x91002042); // ADD X2, X2, #8
+            env.code_mem.emplace_back(0xd61f0040); // BR X2
+        }
+        env.code_mem.emplace_back(0xd1000421); // SUB X1, X1, #1
+        env.code_mem.emplace_back(0xd2800002); // MOV X2, #0
+        env.code_mem.emplace_back(0xb5000001 | (((-(block_count * 2 + 2)) & 0x7FFFF) << 5)); // CBNZ X1, 0
+        env.code_mem.emplace_back(0x14000000); // B .
+
+        jit.SetRegister(1, 3);
+        jit.SetRegister(2, 0);
+        jit.SetPC(0);
+
+        env.ticks_left = 1000000;
+        jit.Run();
+
+        REQUIRE(jit.GetRegister(1) == 0);
+        REQUIRE(jit.GetPC() == block_count * 8 + 12);
+    }
+}
+
+TEST_CASE("A64: RSB size", "[a64]") {
+    const auto run = [](size_t rsb_size, bool enable_statistics = true) {
+        A64TestEnv env;
+        Dynarmic::A64::UserConfig conf{&env};
+        conf.rsb_size = rsb_size;
+        conf.enable_statistics = enable_statistics;
+        Dynarmic::A64::Jit jit{conf};
+
+        env.code_mem.resize(0x118 / 4, 0xd503201f); // NOP
+        env.code_mem[0] = 0x94000040; // BL 0x100
+        env.code_mem[1] = 0x14000000; // B .
+        env.code_mem[0x100 / 4] = 0xf81f0ffe; // STR X30, [SP, #-16]!
+        env.code_mem[0x104 / 4] = 0xd1000400; // SUB X0, X0, #1
+        env.code_mem[0x108 / 4] = 0xb4000040; // CBZ X0, 0x110
+        env.code_mem[0x10c / 4] = 0x97fffffd; // BL 0x100
+        env.code_mem[0x110 / 4] = 0xf84107fe; // LDR X30, [SP], #16
+        env.code_mem[0x114 / 4] = 0xd65f03c0; // RET
+
+        jit.SetRegister(0, 16);
+        jit.SetSP(0x10000);
+        jit.SetPC(0);
+
+        env.ticks_left = 200;
+        jit.Run();
+
+        REQUIRE(jit.GetPC() == 4);
+        REQUIRE(jit.GetSP() == 0x10000);
+        REQUIRE(jit.GetRSBHitCount() + jit.GetRSBMissCount() == (enable_statistics ? 16 : 0));
+        return jit.GetRSBMissCount();
+    };
+
+    // The outermost return is lost when the call depth exceeds the size of the RSB.
+    REQUIRE(run(8) == 1);
+    REQUIRE(run(32) == 0);
+
+    // Without statistics the counters are not maintained.
+    REQUIRE(run(8, false) == 0);
+}
+
+TEST_CASE("A64: Superblocks", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.enable_superblocks = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.resize(0x84 / 4, 0xd503201f); // NOP
+    env.code_mem[0] = 0x91000400; // ADD X0, X0, #1
+    env.code_mem[1] = 0x1400000f; // B 0x40
+    env.code_mem[0x40 / 4] = 0x91000800; // ADD X0, X0, #2
+    env.code_mem[0x44 / 4] = 0x1400000f; // B 0x80
+    env.code_mem[0x80 / 4] = 0x14000000; // B .
+
+    jit.SetPC(0);
+
+    // The whole chain is a single block, so it runs to completion even though only one tick is available.
+    env.ticks_left = 1;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 3);
+    REQUIRE(jit.GetPC() == 0x80);
+
+    // Modifying code in the middle of the chain must invalidate the block that starts at its head.
+    env.code_mem[0x40 / 4] = 0x91001000; // ADD X0, X0, #4
+    jit.InvalidateCacheRange(0x40, 4);
+    jit.SetPC(0);
+
+    env.ticks_left = 1;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 8);
+    REQUIRE(jit.GetPC() == 0x80);
+}
+
+TEST_CASE("A64: Superblock side exits", "[a64]") {
+    const auto run = [](u64 x2) {
+        A64TestEnv env;
+        Dynarmic::A64::UserConfig conf{&env};
+        conf.enable_superblocks = true;
+        Dynarmic::A64::Jit jit{conf};
+
+        env.code_mem.resize(0x2c / 4, 0xd503201f); // NOP
+        env.code_mem[0x00 / 4] = 0x91000400; // ADD X0, X0, #1
+        env.code_mem[0x04 / 4] = 0xf100241f; // CMP X0, #9
+        env.code_mem[0x08 / 4] = 0x540000c0; // B.EQ 0x20
+        env.code_mem[0x0c / 4] = 0x91000400; // ADD X0, X0, #1
+        env.code_mem[0x10 / 4] = 0xb40000c2; // CBZ X2, 0x28
+        env.code_mem[0x14 / 4] = 0x17fffffb; // B 0
+        env.code_mem[0x20 / 4] = 0x14000000; // B .
+        env.code_mem[0x28 / 4] = 0x14000000; // B .
+
+        jit.SetRegister(2, x2);
+        jit.SetPC(0);
+
+        env.ticks_left = 100;
+        jit.Run();
+
+        return std::make_pair(jit.GetRegister(0), jit.GetPC());
+    };
+
+    REQUIRE(run(1) == std::make_pair(u64(9), u64(0x20)));
+    REQUIRE(run(0) == std::make_pair(u64(2), u64(0x28)));
+}
+
+TEST_CASE("A64: Self-looping block", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::Jit jit{Dynarmic::A64::UserConfig{&env}};
+
+    env.code_mem.emplace_back(0x8b010000); // ADD X0, X0, X1
+    env.code_mem.emplace_back(0xd1000421); // SUB X1, X1, #1
+    env.code_mem.emplace_back(0xb5ffffc1); // CBNZ X1, 0
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    jit.SetRegister(1, 100);
+    jit.SetPC(0);
+
+    // Guest registers must be written back when the loop is exited due to running out of cycles.
+    env.ticks_left = 30;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 955);
+    REQUIRE(jit.GetRegister(1) == 90);
+    REQUIRE(jit.GetPC() == 0);
+
+    env.ticks_left = 1000;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 5050);
+    REQUIRE(jit.GetRegister(1) == 0);
+    REQUIRE(jit.GetPC() == 12);
+}
+
+static std::string TemporaryFilePath(const char* name) {
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+/// Loads a loop of two blocks that sums X1..1 into X0, with the running sums accumulated in X4.
+/// The loop ends with X1 == 0 at the self-loop at PC 28.
+static void LoadSumLoop(A64TestEnv& env) {
+    env.code_mem.emplace_back(0x8b010002); // ADD X2, X0, X1
+    env.code_mem.emplace_back(0x8b010003); // ADD X3, X0, X1
+    env.code_mem.emplace_back(0x8b030084); // ADD X4, X4, X3
+    env.code_mem.emplace_back(0xaa0203e0); // MOV X0, X2
+    env.code_mem.emplace_back(0x14000001); // B .+4
+    env.code_mem.emplace_back(0xd1000421); // SUB X1, X1, #1
+    env.code_mem.emplace_back(0xb5ffff41); // CBNZ X1, 0
+    env.code_mem.emplace_back(0x14000000); // B .
+}
+
+/// Value of X4 after running the loop from LoadSumLoop with X0 = X4 = 0 and X1 = iterations.
+static u64 SumLoopX4(u64 iterations) {
+    u64 x4 = 0;
+    for (u64 i = iterations, sum = 0; i > 0; i--) {
+        sum += i;
+        x4 += sum;
+    }
+    return x4;
+}
+
+TEST_CASE("A64: Tiered compilation", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.enable_tiered_compilation = true;
+    conf.tier_up_threshold = 4;
+    conf.enable_statistics = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    LoadSumLoop(env);
+
+    const auto run = [&](u64 iterations) {
+        jit.SetRegister(0, 0);
+        jit.SetRegister(1, iterations);
+        jit.SetRegister(4, 0);
+        jit.SetPC(0);
+        env.ticks_left = 1000;
+        jit.Run();
+
+        REQUIRE(jit.GetRegister(0) == iterations * (iterations + 1) / 2);
+        REQUIRE(jit.GetRegister(1) == 0);
+        REQUIRE(jit.GetRegister(4) == SumLoopX4(iterations));
+        REQUIRE(jit.GetPC() == 28);
+    };
+
+    // Entering the block at 0 fewer than tier_up_threshold times only runs its tier 0 code.
+    run(3);
+    REQUIRE(jit.GetTierUpCount() == 0);
+
+    // The fourth entry recompiles it, and the remaining iterations run the recompiled code.
+    // That code includes the block at 20 as a superblock, so the block at 20 is not entered often enough to tier up itself.
+    run(100);
+    REQUIRE(jit.GetTierUpCount() == 1);
+
+    // The recompiled block is used from then on.
+    run(100);
+    REQUIRE(jit.GetTierUpCount() == 1);
+}
+
+TEST_CASE("A64: Invalidating a block that spans a page boundary", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::Jit jit{Dynarmic::A64::UserConfig{&env}};
+
+    env.code_mem_start_address = 0xFF8;
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    const auto run = [&] {
+        jit.SetRegister(0, 0);
+        jit.SetPC(0xFF8);
+        env.ticks_left = 4;
+        jit.Run();
+        return jit.GetRegister(0);
+    };
+
+    REQUIRE(run() == 3);
+
+    // The block starts on the first page; invalidating only the second page must still catch it.
+    env.code_mem[2] = 0x91000800; // ADD X0, X0, #2
+    jit.InvalidateCacheRange(0x1000, 4);
+    REQUIRE(run() == 4);
+
+    // Invalidating again must find the newly compiled block and not stale entries.
+    env.code_mem[0] = 0x91000800; // ADD X0, X0, #2
+    jit.InvalidateCacheRange(0xFF8, 4);
+    REQUIRE(run() == 5);
+
+    env.code_mem[1] = 0x91000800; // ADD X0, X0, #2
+    jit.InvalidateCacheRange(0, 0x2000);
+    REQUIRE(run() == 6);
+}
+
+TEST_CASE("A64: Small lazily committed code cache", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    // About as small as a cache can be while still being split into two segments, to keep the block count down.
+    conf.code_cache_near_size = 5 * 1024 * 1024;
+    conf.code_cache_far_size = 4 * 1024 * 1024;
+    conf.code_cache_constant_pool_size = 64 * 1024;
+    conf.code_cache_lazy_commit = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    // Enough distinct blocks that older parts of the cache must be reused.
+    constexpr u32 block_count = 30000;
+    for (u32 i = 0; i < block_count; i++) {
+        env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+        env.code_mem.emplace_back(0x14000001); // B .+4
+    }
+    env.code_mem.emplace_back(0xd1000421); // SUB X1, X1, #1
+    env.code_mem.emplace_back(0xb5000001 | (((-(block_count * 2 + 1)) & 0x7FFFF) << 5)); // CBNZ X1, 0
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    jit.SetRegister(1, 3);
+    jit.SetPC(0);
+
+    env.ticks_left = 1000000;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 3 * block_count);
+    REQUIRE(jit.GetRegister(1) == 0);
+    REQUIRE(jit.GetPC() == block_count * 8 + 8);
+}
+
+TEST_CASE("A64: Persistent translation cache", "[a64]") {
+    const std::string path = TemporaryFilePath("dynarmic_a64_translation_cache_test.bin");
+    std::remove(path.c_str());
+
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.enable_superblocks = true;
+    conf.enable_tiered_compilation = true;
+    conf.tier_up_threshold = 2;
+    conf.translation_cache_path = path.c_str();
+
+    LoadSumLoop(env);
+
+    const auto run = [&] {
+        Dynarmic::A64::Jit jit{conf};
+        jit.SetRegister(1, 100);
+        jit.SetPC(0);
+        env.ticks_left = 1000;
+        jit.Run();
+
+        REQUIRE(jit.GetRegister(0) == 5050);
+        REQUIRE(jit.GetRegister(1) == 0);
+        REQUIRE(jit.GetPC() == 28);
+        return jit.GetRegister(4);
+    };
+
+    const auto file_size = [&] {
+        std::ifstream file{path, std::ios::binary | std::ios::ate};
+        return static_cast<u64>(file.tellg());
+    };
+
+    REQUIRE(run() == SumLoopX4(100));
+    const u64 populated_size = file_size();
+
+    // Everything is found in the cache, so nothing new is stored.
+    REQUIRE(run() == SumLoopX4(100));
+    REQUIRE(file_size() == populated_size);
+
+    // Stale blocks must not be used once the guest code changes.
+    env.code_mem[2] = 0x91000484; // ADD X4, X4, #1
+    REQUIRE(run() == 100);
+    REQUIRE(file_size() > populated_size);
+
+    std::remove(path.c_str());
+}
+
+TEST_CASE("A64: Background compilation", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.compilation_mode = Dynarmic::A64::UserConfig::CompilationMode::BackgroundWait;
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.emplace_back(0x8b010002); // ADD X2, X0, X1
+    env.code_mem.emplace_back(0x8b010003); // ADD X3, X0, X1
+    env.code_mem.emplace_back(0x8b030084); // ADD X4, X4, X3
+    env.code_mem.emplace_back(0xaa0203e0); // MOV X0, X2
+    env.code_mem.emplace_back(0x14000001); // B .+4
+    env.code_mem.emplace_back(0xd1000421); // SUB X1, X1, #1
+    env.code_mem.emplace_back(0xb5ffff41); // CBNZ X1, 0
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    jit.SetRegister(1, 100);
+    jit.SetPC(0);
+
+    env.ticks_left = 1000;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 5050);
+    REQUIRE(jit.GetRegister(1) == 0);
+    REQUIRE(jit.GetPC() == 28);
+
+    // Invalidation discards translations made by the worker from the old code.
+    // The worker may still be reading successors of the executed blocks, so it must finish before the code changes.
+    jit.WaitForBackgroundTranslation();
+    env.code_mem[2] = 0x91000484; // ADD X4, X4, #1
+    jit.InvalidateCacheRange(0, 32);
+    jit.SetRegister(0, 0);
+    jit.SetRegister(1, 100);
+    jit.SetRegister(4, 0);
+    jit.SetPC(0);
+
+    env.ticks_left = 1000;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 5050);
+    REQUIRE(jit.GetRegister(4) == 100);
+    REQUIRE(jit.GetPC() == 28);
+}
+
+TEST_CASE("A64: Interpreting while compiling in the background", "[a64]") {
+    A64TestEnv env;
+    HookedA64TestEnv hooked_env{env};
+    Dynarmic::A64::UserConfig conf{&hooked_env};
+    conf.compilation_mode = Dynarmic::A64::UserConfig::CompilationMode::BackgroundInterpret;
+    Dynarmic::A64::Jit jit{conf};
+
+    size_t instructions_interpreted = 0;
+    hooked_env.interpreter_fallback = [&](u64 pc, size_t num_instructions) {
+        for (size_t i = 0; i < num_instructions; i++, pc += 4) {
+            const u32 instruction = env.MemoryReadCode(pc);
+            if (instruction == 0x91000400) { // ADD X0, X0, #1
+                jit.SetRegister(0, jit.GetRegister(0) + 1);
+            } else {
+                ASSERT_MSG(instruction == 0x14000000, "Unexpected instruction {:08x}", instruction);
+                pc -= 4;
+            }
+            instructions_interpreted++;
+        }
+        jit.SetPC(pc);
+    };
+
+    for (size_t i = 0; i < 100; i++) {
+        env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    }
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    jit.SetPC(0);
+
+    env.ticks_left = 1000;
+    jit.Run();
+
+    // However far the guest got through the interpreter, the result must be the same.
+    REQUIRE(instructions_interpreted > 0);
+    REQUIRE(jit.GetRegister(0) == 100);
+    REQUIRE(jit.GetPC() == 400);
+}
+
+TEST_CASE("A64: Prefetching successors", "[a64]") {
+    A64TestEnv env;
+    HookedA64TestEnv hooked_env{env};
+    Dynarmic::A64::UserConfig conf{&hooked_env};
+    conf.prefetch_depth = 2;
+    Dynarmic::A64::Jit jit{conf};
+
+    std::set<u64> code_reads;
+    hooked_env.memory_read_code = [&](u64 vaddr) {
+        code_reads.insert(vaddr);
+        return env.MemoryReadCode(vaddr);
+    };
+
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0x14000003); // B .+12
+    env.code_mem.emplace_back(0x14000000); // B .
+    env.code_mem.emplace_back(0x14000000); // B .
+    env.code_mem.emplace_back(0x91000800); // ADD X0, X0, #2
+    env.code_mem.emplace_back(0x14000003); // B .+12
+    env.code_mem.emplace_back(0x14000000); // B .
+    env.code_mem.emplace_back(0x14000000); // B .
+    env.code_mem.emplace_back(0x91000c00); // ADD X0, X0, #3
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    jit.SetPC(0);
+
+    // Only the first block is executed, but the two blocks after it are translated.
+    env.ticks_left = 1;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 1);
+    REQUIRE(jit.GetPC() == 16);
+    REQUIRE(code_reads.count(16) == 1);
+    REQUIRE(code_reads.count(32) == 1);
+
+    env.ticks_left = 100;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 6);
+    REQUIRE(jit.GetPC() == 36);
+}
+
+#if defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__)
+TEST_CASE("A64: Fastmem", "[a64]") {
+    constexpr size_t address_space_bits = 32;
+    constexpr size_t page_size = 4096;
+    constexpr size_t reservation_size = (size_t(1) << address_space_bits) + page_size;
+    void* const reservation = mmap(nullptr, reservation_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    REQUIRE(reservation != MAP_FAILED);
+    u8* const fastmem = static_cast<u8*>(reservation);
+    REQUIRE(mprotect(fastmem + 0x10000, page_size, PROT_READ | PROT_WRITE) == 0);
+
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.fastmem_pointer = fastmem;
+    conf.fastmem_address_space_bits = address_space_bits;
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.emplace_back(0xf9400001); // LDR X1, [X0]
+    env.code_mem.emplace_back(0xf9000041); // STR X1, [X2]
+    env.code_mem.emplace_back(0xf9400043); // LDR X3, [X2]
+    env.code_mem.emplace_back(0xf9000403); // STR X3, [X0, #8]
+    env.code_mem.emplace_back(0xf94000a4); // LDR X4, [X5]
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    // The second run executes accesses that have been rewritten after faulting during the first.
+    for (u64 value : {0x0123456789abcdefull, 0xfedcba9876543210ull}) {
+        std::memcpy(fastmem + 0x10000, &value, sizeof(value));
+        env.modified_memory.clear();
+
+        jit.SetRegister(0, 0x10000);      // Mapped
+        jit.SetRegister(2, 0x20000);      // Not mapped
+        jit.SetRegister(5, 0x1'0000'0100); // Outside the address space
+        jit.SetPC(0);
+
+        env.ticks_left = 6;
+        jit.Run();
+
+        u64 copied;
+        std::memcpy(&copied, fastmem + 0x10008, sizeof(copied));
+        REQUIRE(jit.GetRegister(1) == value);
+        REQUIRE(jit.GetRegister(3) == value);
+        REQUIRE(copied == value);
+        REQUIRE(env.MemoryRead64(0x20000) == value);
+        REQUIRE(env.modified_memory.size() == 8);
+        REQUIRE(jit.GetRegister(4) == env.MemoryRead64(0x1'0000'0100));
+    }
+
+    munmap(reservation, reservation_size);
+}
+
+TEST_CASE("A64: Fastmem without range check", "[a64]") {
+    constexpr size_t address_space_bits = 32;
+    constexpr size_t page_size = 4096;
+    constexpr size_t reservation_size = (size_t(1) << address_space_bits) + page_size;
+    void* const reservation = mmap(nullptr, reservation_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    REQUIRE(reservation != MAP_FAILED);
+    u8* const fastmem = static_cast<u8*>(reservation);
+    REQUIRE(mprotect(fastmem + 0x10000, page_size, PROT_READ | PROT_WRITE) == 0);
+
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.fastmem_pointer = fastmem;
+    conf.fastmem_address_space_bits = address_space_bits;
+    conf.fastmem_omit_range_check = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    // The loop uses enough guest registers that every register available for pinning is used.
+    env.code_mem.emplace_back(0xf9400001); // LDR X1, [X0]
+    env.code_mem.emplace_back(0x8b010042); // ADD X2, X2, X1
+    env.code_mem.emplace_back(0xf9000402); // STR X2, [X0, #8]
+    env.code_mem.emplace_back(0x91000463); // ADD X3, X3, #1
+    env.code_mem.emplace_back(0xf1000484); // SUBS X4, X4, #1
+    env.code_mem.emplace_back(0x54ffff61); // B.NE 0
+    env.code_mem.emplace_back(0xf94000c5); // LDR X5, [X6]
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    const u64 value = 0x0123456789abcdef;
+    std::memcpy(fastmem + 0x10000, &value, sizeof(value));
+
+    jit.SetRegister(0, 0x10000); // Mapped
+    jit.SetRegister(4, 100);
+    jit.SetRegister(6, 0x20000); // Not mapped
+    jit.SetPC(0);
+
+    env.ticks_left = 1000;
+    jit.Run();
+
+    u64 stored;
+    std::memcpy(&stored, fastmem + 0x10008, sizeof(stored));
+    REQUIRE(jit.GetRegister(2) == value * 100);
+    REQUIRE(jit.GetRegister(3) == 100);
+    REQUIRE(stored == value * 100);
+    REQUIRE(jit.GetRegister(5) == env.MemoryRead64(0x20000));
+    REQUIRE(jit.GetPC() == 28);
+
+    munmap(reservation, reservation_size);
+}
+
+TEST_CASE("A64: Code page protection", "[a64]") {
+    constexpr size_t page_size = 4096;
+    void* const mapping = mmap(nullptr, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(mapping != MAP_FAILED);
+
+    constexpr u64 code_page_vaddr = 0x10000;
+    u8* const code_page = static_cast<u8*>(mapping);
+
+    A64TestEnv env;
+    HookedA64TestEnv hooked_env{env};
+    const auto read_code = [&](u64 vaddr) -> u32 {
+        if (vaddr < code_page_vaddr || vaddr >= code_page_vaddr + page_size) {
+            return 0x14000000; // B .
+        }
+        u32 instruction;
+        std::memcpy(&instruction, code_page + (vaddr - code_page_vaddr), sizeof(instruction));
+        return instruction;
+    };
+    hooked_env.memory_read_code = read_code;
+
+    std::vector<void*> page_table(256);
+    page_table[code_page_vaddr >> 12] = mapping;
+
+    {
+        Dynarmic::A64::UserConfig conf{&hooked_env};
+        conf.page_table = page_table.data();
+        conf.page_table_address_space_bits = 20;
+        conf.protect_code_pages = true;
+        Dynarmic::A64::Jit jit{conf};
+
+        const std::array<u32, 3> code{
+            0x91000400, // ADD X0, X0, #1
+            0xb9000041, // STR W1, [X2]
+            0x14000000, // B .
+        };
+        std::memcpy(code_page, code.data(), sizeof(code));
+
+        const auto run = [&](u32 stored_instruction) {
+            jit.SetRegister(0, 0);
+            jit.SetRegister(1, stored_instruction);
+            jit.SetRegister(2, code_page_vaddr);
+            jit.SetPC(code_page_vaddr);
+            env.ticks_left = 3;
+            jit.Run();
+            return jit.GetRegister(0);
+        };
+
+        // The guest overwrites its first instruction, which takes effect on the next run.
+        REQUIRE(run(0x91000800) == 1); // ADD X0, X0, #2
+        REQUIRE(run(0x91000800) == 2);
+
+        // Writes by the host are detected too.
+        const u32 add_3 = 0x91000c00; // ADD X0, X0, #3
+        std::memcpy(code_page, &add_3, sizeof(add_3));
+        REQUIRE(run(add_3) == 3);
+    }
+
+    {
+        Dynarmic::A64::UserConfig conf{&hooked_env};
+        conf.page_table = page_table.data();
+        conf.page_table_address_space_bits = 20;
+        conf.protect_code_pages = true;
+        Dynarmic::A64::Jit jit{conf};
+
+        const std::array<u32, 2> code{
+            0x91000400, // ADD X0, X0, #1
+            0x14000000, // B .
+        };
+        std::memcpy(code_page, code.data(), sizeof(code));
+
+        // A write made after the code has been read for translation, as if by another thread, is detected
+        // before the translated block is entered.
+        bool written = false;
+        hooked_env.memory_read_code = [&](u64 vaddr) -> u32 {
+            const u32 instruction = read_code(vaddr);
+            if (!written) {
+                written = true;
+                const u32 add_2 = 0x91000800; // ADD X0, X0, #2
+                std::memcpy(code_page, &add_2, sizeof(add_2));
+            }
+            return instruction;
+        };
+
+        jit.SetRegister(0, 0);
+        jit.SetPC(code_page_vaddr);
+        env.ticks_left = 2;
+        jit.Run();
+        REQUIRE(jit.GetRegister(0) == 2);
+    }
+
+    munmap(mapping, page_size);
+}
+#endif
+
+TEST_CASE("A64: Software TLB", "[a64]") {
+    A64TestEnv env;
+    HookedA64TestEnv hooked_env{env};
+    Dynarmic::A64::UserConfig conf{&hooked_env};
+    conf.enable_tlb = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    std::map<u64, u8*> pages;
+    size_t translations = 0;
+    hooked_env.translate_page = [&](u64 vaddr) -> u8* {
+        translations++;
+        const auto iter = pages.find(vaddr);
+        return iter != pages.end() ? iter->second : nullptr;
+    };
+
+    env.code_mem.emplace_back(0xf9400001); // LDR X1, [X0]
+    env.code_mem.emplace_back(0xf9000041); // STR X1, [X2]
+    env.code_mem.emplace_back(0xf9400043); // LDR X3, [X2]
+    env.code_mem.emplace_back(0xf9000403); // STR X3, [X0, #8]
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    std::array<u64, 512> page_a{}, page_b{}, page_c{};
+    page_a[0] = 0x0123456789abcdef;
+    page_b[0] = 0xfedcba9876543210;
+    constexpr u64 mapped_vaddr = 0x7f12'3456'7000;
+    pages[mapped_vaddr] = reinterpret_cast<u8*>(page_a.data());
+
+    const auto run = [&](u64 x0) {
+        env.modified_memory.clear();
+        jit.SetRegister(0, x0);
+        jit.SetRegister(2, 0x20000); // Not mapped
+        jit.SetPC(0);
+        env.ticks_left = 5;
+        jit.Run();
+    };
+
+    run(mapped_vaddr);
+    REQUIRE(jit.GetRegister(3) == page_a[0]);
+    REQUIRE(page_a[1] == page_a[0]);
+    REQUIRE(env.MemoryRead64(0x20000) == page_a[0]);
+    REQUIRE(translations == 2);
+
+    // Both the mapped page and the page without host memory stay in the TLB.
+    run(mapped_vaddr);
+    REQUIRE(translations == 2);
+
+    pages[mapped_vaddr] = reinterpret_cast<u8*>(page_b.data());
+    jit.InvalidateTLB();
+    run(mapped_vaddr);
+    REQUIRE(jit.GetRegister(3) == page_b[0]);
+    REQUIRE(page_b[1] == page_b[0]);
+    REQUIRE(env.MemoryRead64(0x20000) == page_b[0]);
+    REQUIRE(translations == 4);
+
+    // An access crossing into the next page uses the callbacks, even though both pages have host memory.
+    pages[mapped_vaddr + 0x1000] = reinterpret_cast<u8*>(page_c.data());
+    run(mapped_vaddr + 0xffc);
+    REQUIRE(jit.GetRegister(1) == env.MemoryRead64(mapped_vaddr + 0xffc));
+    REQUIRE(jit.GetRegister(3) == jit.GetRegister(1));
+    REQUIRE(page_b[511] == 0);
+    u64 stored;
+    std::memcpy(&stored, reinterpret_cast<u8*>(page_c.data()) + 4, sizeof(stored));
+    REQUIRE(stored == jit.GetRegister(1));
+}
+
+TEST_CASE("A64: Multi-level page table", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+
+    // 48-bit address space: three levels of 4096 entries each.
+    std::vector<void*> level0(4096), level1(4096), level2(4096);
+    std::array<u64, 512> page{};
+    constexpr u64 mapped_vaddr = 0x7f12'3456'7000;
+    level0[(mapped_vaddr >> 36) & 0xfff] = level1.data();
+    level1[(mapped_vaddr >> 24) & 0xfff] = level2.data();
+    level2[(mapped_vaddr >> 12) & 0xfff] = page.data();
+
+    conf.page_table = level0.data();
+    conf.page_table_address_space_bits = 48;
+    conf.page_table_levels = 3;
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.emplace_back(0xf9400001); // LDR X1, [X0]
+    env.code_mem.emplace_back(0xf9000041); // STR X1, [X2]
+    env.code_mem.emplace_back(0xf9400043); // LDR X3, [X2]
+    env.code_mem.emplace_back(0xf9000403); // STR X3, [X0, #8]
+    env.code_mem.emplace_back(0xf94000a4); // LDR X4, [X5]
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    page[0] = 0x0123456789abcdef;
+    jit.SetRegister(0, mapped_vaddr);
+    jit.SetRegister(2, mapped_vaddr + 0x1000); // Null entry in the last level
+    jit.SetRegister(5, 0x20000);               // Null entry in the first level
+    jit.SetPC(0);
+
+    env.ticks_left = 6;
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(1) == page[0]);
+    REQUIRE(jit.GetRegister(3) == page[0]);
+    REQUIRE(page[1] == page[0]);
+    REQUIRE(env.MemoryRead64(mapped_vaddr + 0x1000) == page[0]);
+    REQUIRE(env.modified_memory.size() == 8);
+    REQUIRE(jit.GetRegister(4) == env.MemoryRead64(0x20000));
+}
+
+TEST_CASE("A64: Running without ticks", "[a64]") {
+    A64TestEnv env;
+    HookedA64TestEnv hooked_env{env};
+    Dynarmic::A64::UserConfig conf{&hooked_env};
+    conf.enable_ticks = false;
+    Dynarmic::A64::Jit jit{conf};
+
+    hooked_env.add_ticks = [](u64) { ASSERT_MSG(false, "AddTicks called"); };
+    hooked_env.get_ticks_remaining = []() -> u64 { ASSERT_MSG(false, "GetTicksRemaining called"); return 0; };
+    hooked_env.call_svc = [&](u32) { jit.HaltExecution(); };
+
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0xeb01001f); // CMP X0, X1
+    env.code_mem.emplace_back(0x54ffffc1); // B.NE -8
+    env.code_mem.emplace_back(0xd4000001); // SVC #0
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    jit.SetRegister(0, 0);
+    jit.SetRegister(1, 100000);
+    jit.SetPC(0);
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 100000);
+    REQUIRE(jit.GetPC() == 16);
+
+    // A halted Jit runs again on the next call to Run.
+    jit.SetRegister(1, 200000);
+    jit.SetPC(0);
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 200000);
+    REQUIRE(jit.GetPC() == 16);
+}
+
+TEST_CASE("A64: HaltExecution from another thread", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    SECTION("Ticks") {
+        conf.enable_ticks = true;
+    }
+    SECTION("No ticks") {
+        conf.enable_ticks = false;
+    }
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.emplace_back(0x14000000); // B .
+    env.code_mem.emplace_back(0x14000001); // B +4
+    env.code_mem.emplace_back(0x17ffffff); // B -4
+
+    constexpr u64 ticks = 0x1000'0000'0000;
+    for (u64 pc : {0, 4}) {
+        env.ticks_left = ticks;
+        jit.SetPC(pc);
+
+        std::thread preempter{[&jit] {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            jit.HaltExecution();
+        }};
+        jit.Run();
+        preempter.join();
+
+        if (pc == 0) {
+            REQUIRE(jit.GetPC() == 0);
+        } else {
+            REQUIRE((jit.GetPC() == 4 || jit.GetPC() == 8));
+        }
+        if (conf.enable_ticks) {
+            REQUIRE(env.ticks_left > 0);
+            REQUIRE(env.ticks_left < ticks);
+        }
+    }
+
+    // A halt requested while not executing applies to the next Run.
+    env.ticks_left = ticks;
+    jit.SetPC(0);
+    jit.HaltExecution();
+    jit.Run();
+    REQUIRE(jit.GetPC() == 0);
+}
+
+TEST_CASE("A64: MXCSR is only switched for floating-point code", "[a64]") {
+    A64TestEnv env;
+    Dynarmic::A64::UserConfig conf{&env};
+    conf.enable_statistics = true;
+    Dynarmic::A64::Jit jit{conf};
+
+    env.code_mem.emplace_back(0x91000400); // ADD X0, X0, #1
+    env.code_mem.emplace_back(0x14000000); // B .
+    env.code_mem.emplace_back(0x1e222820); // FADD S0, S1, S2
+    env.code_mem.emplace_back(0x14000000); // B .
+
+    const u32 host_mxcsr = _mm_getcsr();
+
+    env.ticks_left = 100;
+    jit.SetPC(0);
+    jit.Run();
+
+    REQUIRE(jit.GetRegister(0) == 1);
+    REQUIRE(jit.GetMXCSRAccessCount() == 0);
+
+    jit.SetFpcr(0x00400000); // Round towards plus infinity
+    jit.SetVector(1, {0x3f800000, 0}); // 1.0
+    jit.SetVector(2, {0x30800000, 0}); // 2^-30
+    env.ticks_left = 100;
+    jit.SetPC(8);
+    jit.Run();
+
+    // The guest rounding mode was used, and the host MXCSR was restored on return.
+    REQUIRE(jit.GetVector(0)[0] == 0x3f800001);
+    REQUIRE((jit.GetFpsr() & 0x10) != 0); // IXC
+    REQUIRE(_mm_getcsr() == host_mxcsr);
+    REQUIRE(jit.GetMXCSRAccessCount() == 4);
+}
@@ -76,6 +76,11 @@ static u32 GenRandomInst(u64 pc, bool is_last_inst) {
             "LDLAR",
             // Dynarmic and QEMU currently differ on how the exclusive monitor's address range works.
             "STXR", "STLXR", "STXP", "STLXP", "LDXR", "LDAXR", "LDXP", "LDAXP",
+            // Unimplemented in QEMU (ARMv8.1 atomics and ARMv8.3 LDAPR)
+            "CASP", "CASB", "CASH", "CAS",
+            "LDADDB", "LDCLRB", "LDEORB", "LDSETB", "LDSMAXB", "LDSMINB", "LDUMAXB", "LDUMINB", "SWPB", "LDAPRB",
+            "LDADDH", "LDCLRH", "LDEORH", "LDSETH", "LDSMAXH", "LDSMINH", "LDUMAXH", "LDUMINH", "SWPH", "LDAPRH",
+            "LDADD", "LDCLR", "LDEOR", "LDSET", "LDSMAX", "LDSMIN", "LDUMAX", "LDUMIN", "SWP", "LDAPR",
             // QEMU's implementation of FDIV is incorrect
             "FDIV_1", "FDIV_2",
         };
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <array>
+#include <functional>
 #include <map>
 
 #include <dynarmic/A64/a64.h>
@@ -105,3 +106,82 @@ public:
         return 0x10000000000 - ticks_left;
     }
 };
+
+/**
+ * Forwards every callback to an A64TestEnv, except for those replaced by a hook.
+ * Lets a test observe or override individual callbacks while keeping the rest of A64TestEnv's behaviour.
+ */
+class HookedA64TestEnv final : public Dynarmic::A64::UserCallbacks {
+public:
+    explicit HookedA64TestEnv(A64TestEnv& env) : env(env) {}
+
+    std::function<std::uint32_t(u64 vaddr)> memory_read_code;
+    std::function<std::uint64_t(u64 vaddr)> memory_read_64;
+    std::function<void(u64 vaddr, std::uint64_t value)> memory_write_64;
+    std::function<std::uint8_t*(u64 vaddr)> translate_page;
+    std::function<void(u64 pc, size_t num_instructions)> interpreter_fallback;
+    std::function<void(std::uint32_t swi)> call_svc;
+    std::function<void(std::uint64_t ticks)> add_ticks;
+    std::function<std::uint64_t()> get_ticks_remaining;
+
+    std::uint32_t MemoryReadCode(u64 vaddr) override {
+        return memory_read_code ? memory_read_code(vaddr) : env.MemoryReadCode(vaddr);
+    }
+
+    std::uint8_t MemoryRead8(u64 vaddr) override { return env.MemoryRead8(vaddr); }
+    std::uint16_t MemoryRead16(u64 vaddr) override { return env.MemoryRead16(vaddr); }
+    std::uint32_t MemoryRead32(u64 vaddr) override { return env.MemoryRead32(vaddr); }
+    std::uint64_t MemoryRead64(u64 vaddr) override {
+        return memory_read_64 ? memory_read_64(vaddr) : env.MemoryRead64(vaddr);
+    }
+    Vector MemoryRead128(u64 vaddr) override { return env.MemoryRead128(vaddr); }
+
+    void MemoryWrite8(u64 vaddr, std::uint8_t value) override { env.MemoryWrite8(vaddr, value); }
+    void MemoryWrite16(u64 vaddr, std::uint16_t value) override { env.MemoryWrite16(vaddr, value); }
+    void MemoryWrite32(u64 vaddr, std::uint32_t value) override { env.MemoryWrite32(vaddr, value); }
+    void MemoryWrite64(u64 vaddr, std::uint64_t value) override {
+        if (memory_write_64) {
+            memory_write_64(vaddr, value);
+            return;
+        }
+        env.MemoryWrite64(vaddr, value);
+    }
+    void MemoryWrite128(u64 vaddr, Vector value) override { env.MemoryWrite128(vaddr, value); }
+
+    std::uint8_t* TranslatePage(u64 vaddr) override {
+        return translate_page ? translate_page(vaddr) : env.TranslatePage(vaddr);
+    }
+
+    void InterpreterFallback(u64 pc, size_t num_instructions) override {
+        if (interpreter_fallback) {
+            interpreter_fallback(pc, num_instructions);
+            return;
+        }
+        env.InterpreterFallback(pc, num_instructions);
+    }
+
+    void CallSVC(std::uint32_t swi) override {
+        if (call_svc) {
+            call_svc(swi);
+            return;
+        }
+        env.CallSVC(swi);
+    }
+
+    void ExceptionRaised(u64 pc, Dynarmic::A64::Exception exception) override { env.ExceptionRaised(pc, exception); }
+
+    void AddTicks(std::uint64_t ticks) override {
+        if (add_ticks) {
+            add_ticks(ticks);
+            return;
+        }
+        env.AddTicks(ticks);
+    }
+    std::uint64_t GetTicksRemaining() override {
+        return get_ticks_remaining ? get_ticks_remaining() : env.GetTicksRemaining();
+    }
+    std::uint64_t GetCNTPCT() override { return env.GetCNTPCT(); }
+
+private:
+    A64TestEnv& env;
+};